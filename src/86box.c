@@ -104,6 +104,7 @@
 #include <86box/ui.h>
 #include <86box/path.h>
 #include <86box/plat.h>
+#include <86box/profile.h>
 #include <86box/version.h>
 #include <86box/gdbstub.h>
 #include <86box/machine_status.h>
@@ -154,6 +155,8 @@ char       vm_name[1024]    = { '\0' };     /* (O) display name of the VM */
 int      do_nothing                             = 0;
 int      dump_missing                           = 0;
 int      clear_cmos                             = 0;
+int      benchmark_seconds                      = 0;              /* (O) Emulated seconds to benchmark for */
+int      benchmark_profile                      = 0;              /* (O) Profile handlers during the benchmark */
 #ifdef USE_INSTRUMENT
 uint8_t  instru_enabled                         = 0;
 uint64_t instru_run_ms                          = 0;
@@ -201,10 +204,20 @@ uint32_t mem_size                               = 0;              /* (C) memory
                                                                          system board)*/
 uint32_t isa_mem_size                           = 0;              /* (C) memory size (ISA Memory Cards) */
 int      cpu_use_dynarec                        = 0;              /* (C) cpu uses/needs Dyna */
+int      cpu_dynarec_chaining                   = 1;              /* (C) jump directly between
+                                                                         recompiled blocks */
+int      cpu_idle_skip                          = 1;              /* (C) skip to the next timer
+                                                                         when the CPU is halted */
 int      cpu                                    = 0;              /* (C) cpu type */
 int      fpu_type                               = 0;              /* (C) fpu type */
 int      fpu_softfloat                          = 0;              /* (C) fpu uses softfloat */
 int      time_sync                              = 0;              /* (C) enable time sync */
+int      hdd_image_async                        = 0;              /* (C) hard disk image I/O on a worker
+                                                                         thread */
+int      hdd_image_write_back                   = 0;              /* (C) defer hard disk image writes
+                                                                         until sync */
+int      hdd_image_mmap                         = 0;              /* (C) map hard disk images into
+                                                                         memory */
 int      confirm_reset                          = 1;              /* (G) enable reset confirmation */
 int      confirm_exit                           = 1;              /* (G) enable exit confirmation */
 int      confirm_save                           = 1;              /* (G) enable save confirmation */
@@ -225,6 +238,7 @@ int      sound_muted                            = 0;              /* (C) Is soun
 int      jumpered_internal_ecp_dma              = 0;              /* (C) Jumpered internal EPC DMA */
 int      inhibit_multimedia_keys;                                 /* (G) Inhibit multimedia keys on Windows. */
 int      force_10ms;                                              /* (C) Force 10ms CPU frame intervals. */
+int      timer_scheduler                        = TIMER_SCHED_LIST; /* (C) Timer queue implementation. */
 int      vmm_disabled                           = 0;              /* (G) disable built-in manager */
 char     vmm_path_cfg[1024]                     = { '\0' };       /* (G) VMs path (unless -E is used)*/
 
@@ -692,6 +706,10 @@ pc_show_usage(void)
             "Valid options are:\n\n"
             "-? or --help\t\t\t- show this information\n"
             "-A or --assetpath path\t\t- set 'path' to be asset path\n"
+            "-B or --benchmark secs\t\t- run for 'secs' emulated seconds at full\n"
+            "\t\t\t\t   speed, print statistics and exit\n"
+            "--benchmark-profile\t\t- add a per-handler time breakdown to the\n"
+            "\t\t\t\t   benchmark, at the cost of slower emulation\n"
 #ifdef SHOW_EXTRA_PARAMS
             "-C or --config path\t\t- set 'path' to be config file\n"
 #endif
@@ -887,6 +905,15 @@ usage:
 
             apath = argv[++c];
             asset_add_path(apath);
+        } else if (!strcasecmp(argv[c], "--benchmark") || !strcasecmp(argv[c], "-B")) {
+            if ((c + 1) == argc)
+                goto usage;
+
+            benchmark_seconds = atoi(argv[++c]);
+            if (benchmark_seconds <= 0)
+                goto usage;
+        } else if (!strcasecmp(argv[c], "--benchmark-profile")) {
+            benchmark_profile = 1;
         } else if (!strcasecmp(argv[c], "--config") || !strcasecmp(argv[c], "-C")) {
             if ((c + 1) == argc || plat_dir_check(argv[c + 1]))
                 goto usage;
@@ -1647,6 +1674,9 @@ pc_reset_hard_close(void)
 
     device_close_all();
 
+    /* The devices' private data may be reused by the new ones. */
+    profile_reset();
+
     scsi_device_close_all();
 
     midi_out_close();
@@ -2033,6 +2063,8 @@ pc_run(void)
     if (++framecountx >= (force_10ms ? 100 : 1000)) {
         framecountx = 0;
         frames      = 0;
+
+        profile_tick();
     }
 
     if (title_update) {
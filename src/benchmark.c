@@ -0,0 +1,406 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Headless benchmark mode.
+ *
+ *          When started with --benchmark, the frontend runs the machine
+ *          unpaced and with no sound output for the given number of
+ *          emulated seconds, then prints the results to stdout as a
+ *          single JSON object and exits.
+ *
+ *          The profiler is kept off during the run, as timing every
+ *          handler call slows the emulation down noticeably. With
+ *          --benchmark-profile, it is turned on and the report also
+ *          has the time spent per subsystem and handler, but the
+ *          headline figures then include the profiler's overhead.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/machine.h>
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/timer.h>
+#include <86box/thread.h>
+#include <86box/video.h>
+#include <86box/vid_svga.h>
+#include <86box/vid_voodoo_common.h>
+#include <86box/vid_voodoo_regs.h>
+#include <86box/vid_voodoo_jit.h>
+#include <86box/io.h>
+#include <86box/network.h>
+#include <86box/plat_unused.h>
+#include <86box/profile.h>
+#include <86box/benchmark.h>
+#ifdef USE_NEW_DYNAREC
+#    include "codegen_public.h"
+#endif
+
+#define BENCHMARK_HANDLERS 16      /* Handlers listed in the report. */
+#define BENCHMARK_IO_ITERS 1000000 /* Accesses per port I/O function timed. */
+
+static uint64_t benchmark_host_start;
+static uint64_t benchmark_tsc_start;
+static uint64_t benchmark_idle_start;
+static uint64_t benchmark_blits_start;
+static uint64_t benchmark_ins_start;
+static int      benchmark_profile_on;
+static int      benchmark_profile_interval;
+static voodoo_jit_stats_t benchmark_voodoo_jit_start;
+static uint32_t           benchmark_net_drops_start[NET_CARD_MAX][NET_QUEUE_COUNT];
+#ifdef USE_NEW_DYNAREC
+static codegen_stats_t benchmark_codegen_start;
+#endif
+
+static uint64_t
+benchmark_blits(void)
+{
+    uint64_t blits = 0;
+
+    for (int i = 0; i < MONITORS_NUM; i++)
+        blits += monitors[i].mon_blits;
+
+    return blits;
+}
+
+/* Print a string as a JSON string literal. */
+static void
+benchmark_print_string(const char *s)
+{
+    putchar('"');
+    for (; *s; s++) {
+        if ((*s == '"') || (*s == '\\'))
+            printf("\\%c", *s);
+        else if ((uint8_t) *s < 0x20)
+            printf("\\u%04x", (uint8_t) *s);
+        else
+            putchar(*s);
+    }
+    putchar('"');
+}
+
+static volatile uint32_t benchmark_io_sink;
+
+static uint8_t
+benchmark_io_inb(uint16_t addr, UNUSED(void *priv))
+{
+    return addr;
+}
+
+static uint16_t
+benchmark_io_inw(uint16_t addr, UNUSED(void *priv))
+{
+    return addr;
+}
+
+static uint32_t
+benchmark_io_inl(uint16_t addr, UNUSED(void *priv))
+{
+    return addr;
+}
+
+static void
+benchmark_io_outb(UNUSED(uint16_t addr), uint8_t val, UNUSED(void *priv))
+{
+    benchmark_io_sink += val;
+}
+
+static void
+benchmark_io_outw(UNUSED(uint16_t addr), uint16_t val, UNUSED(void *priv))
+{
+    benchmark_io_sink += val;
+}
+
+static void
+benchmark_io_outl(UNUSED(uint16_t addr), uint32_t val, UNUSED(void *priv))
+{
+    benchmark_io_sink += val;
+}
+
+/* Time the port I/O functions on one handler installed on free ports, once
+   through the direct dispatch entries and once through the handler list walk
+   they bypass, and print the average nanoseconds per access of each. */
+static void
+benchmark_io(void)
+{
+    static const char *names[6] = { "inb", "inw", "inl", "outb", "outw", "outl" };
+    uint16_t           base     = 0;
+    uint32_t           sum      = 0;
+    uint64_t           start;
+    double             ns[2][6];
+
+    /* Stay clear of the PCI configuration ports, which bypass the handlers. */
+    for (uint32_t c = 0x1000; (c < 0xc000) && !base; c += 8) {
+        if (io_port_free(c) && io_port_free(c + 1) && io_port_free(c + 2) && io_port_free(c + 3))
+            base = c;
+    }
+    if (!base)
+        return;
+
+    io_sethandler(base, 4,
+                  benchmark_io_inb, benchmark_io_inw, benchmark_io_inl,
+                  benchmark_io_outb, benchmark_io_outw, benchmark_io_outl, NULL);
+
+    for (int walk = 0; walk < 2; walk++) {
+        io_set_direct(!walk);
+        for (int f = 0; f < 6; f++) {
+            start = profile_now();
+            for (uint32_t i = 0; i < BENCHMARK_IO_ITERS; i++) {
+                switch (f) {
+                    case 0:
+                        sum += inb(base);
+                        break;
+                    case 1:
+                        sum += inw(base);
+                        break;
+                    case 2:
+                        sum += inl(base);
+                        break;
+                    case 3:
+                        outb(base, i);
+                        break;
+                    case 4:
+                        outw(base, i);
+                        break;
+                    default:
+                        outl(base, i);
+                        break;
+                }
+            }
+            ns[walk][f] = (double) (profile_now() - start) / (double) BENCHMARK_IO_ITERS;
+        }
+    }
+    io_set_direct(1);
+    benchmark_io_sink += sum;
+
+    io_removehandler(base, 4,
+                     benchmark_io_inb, benchmark_io_inw, benchmark_io_inl,
+                     benchmark_io_outb, benchmark_io_outw, benchmark_io_outl, NULL);
+
+    printf(",\"io_dispatch\":{\"port\":%u,\"accesses\":%u", base, BENCHMARK_IO_ITERS);
+    for (int walk = 0; walk < 2; walk++) {
+        printf(",\"%s_ns\":{", walk ? "walk" : "direct");
+        for (int f = 0; f < 6; f++)
+            printf("%s\"%s\":%.3f", f ? "," : "", names[f], ns[walk][f]);
+        printf("}");
+    }
+    printf("}");
+}
+
+#ifdef USE_NEW_DYNAREC
+/* Print the recompiler counters, which are always kept. */
+static void
+benchmark_dynarec(void)
+{
+    codegen_stats_t d;
+
+    d.hash_hits   = codegen_stats.hash_hits - benchmark_codegen_start.hash_hits;
+    d.tree_hits   = codegen_stats.tree_hits - benchmark_codegen_start.tree_hits;
+    d.misses      = codegen_stats.misses - benchmark_codegen_start.misses;
+    d.probes      = codegen_stats.probes - benchmark_codegen_start.probes;
+    d.chain_hits  = codegen_stats.chain_hits - benchmark_codegen_start.chain_hits;
+    d.chain_links = codegen_stats.chain_links - benchmark_codegen_start.chain_links;
+    d.blocks_run  = codegen_stats.blocks_run - benchmark_codegen_start.blocks_run;
+    d.compiles    = codegen_stats.compiles - benchmark_codegen_start.compiles;
+    d.interpreted = codegen_stats.interpreted - benchmark_codegen_start.interpreted;
+
+    printf(",\"dynarec_compiles\":%" PRIu64 ",\"dynarec_blocks_run\":%" PRIu64 ",\"dynarec_interpreted\":%" PRIu64,
+           d.compiles, d.blocks_run + d.chain_hits, d.interpreted);
+    printf(",\"dynarec_hash_hits\":%" PRIu64 ",\"dynarec_tree_hits\":%" PRIu64 ",\"dynarec_misses\":%" PRIu64
+           ",\"dynarec_probes\":%" PRIu64,
+           d.hash_hits, d.tree_hits, d.misses, d.probes);
+
+    /* Share of block entries that bypassed the dispatcher lookup. */
+    printf(",\"dynarec_chaining\":%s,\"chain_hits\":%" PRIu64 ",\"chain_links\":%" PRIu64 ",\"chain_ratio\":%.6f",
+           cpu_dynarec_chaining ? "true" : "false", d.chain_hits, d.chain_links,
+           (d.chain_hits + d.hash_hits + d.tree_hits + d.misses) ?
+               ((double) d.chain_hits / (double) (d.chain_hits + d.hash_hits + d.tree_hits + d.misses)) : 0.0);
+}
+#endif
+
+/* Print the pipeline cache counters of any Voodoo cards. */
+static void
+benchmark_voodoo_jit(void)
+{
+    voodoo_jit_stats_t stats;
+
+    voodoo_jit_get_total_stats(&stats);
+    if (!stats.blocks)
+        return;
+
+    printf(",\"voodoo_jit\":{\"hits\":%" PRIu64 ",\"misses\":%" PRIu64 ",\"recompiles\":%" PRIu64
+           ",\"evictions\":%" PRIu64 ",\"rejects\":%" PRIu64 ",\"blocks\":%i,\"used\":%i}",
+           stats.hits - benchmark_voodoo_jit_start.hits, stats.misses - benchmark_voodoo_jit_start.misses,
+           stats.recompiles - benchmark_voodoo_jit_start.recompiles,
+           stats.evictions - benchmark_voodoo_jit_start.evictions,
+           stats.rejects - benchmark_voodoo_jit_start.rejects, stats.blocks, stats.used);
+}
+
+static void
+benchmark_net_start(void)
+{
+    netcard_t       *card;
+    netqueue_stats_t stats;
+
+    for (int c = 0; c < NET_CARD_MAX; c++) {
+        if ((card = network_get_card(c)) == NULL)
+            continue;
+
+        for (int q = 0; q < NET_QUEUE_COUNT; q++) {
+            network_queue_get_stats(card, q, &stats);
+            benchmark_net_drops_start[c][q] = stats.drops;
+        }
+    }
+}
+
+/* Print the packet queue occupancy of the attached network cards, with the
+   peak since the card was attached, and the packets dropped during the run. */
+static void
+benchmark_net(void)
+{
+    static const char *names[NET_QUEUE_COUNT] = { "rx", "tx_vm", "tx_host", "rx_on_tx" };
+    netcard_t         *card;
+    netqueue_stats_t   stats;
+    int                first = 1;
+
+    printf(",\"network\":[");
+    for (int c = 0; c < NET_CARD_MAX; c++) {
+        if ((card = network_get_card(c)) == NULL)
+            continue;
+
+        printf("%s{\"card\":%i", first ? "" : ",", c + 1);
+        for (int q = 0; q < NET_QUEUE_COUNT; q++) {
+            network_queue_get_stats(card, q, &stats);
+            printf(",\"%s\":{\"depth\":%u,\"used\":%u,\"peak\":%u,\"drops\":%u}", names[q],
+                   stats.depth, stats.used, stats.peak, stats.drops - benchmark_net_drops_start[c][q]);
+        }
+        printf("}");
+        first = 0;
+    }
+    printf("]");
+}
+
+/* Start measuring, called by the frontend before running the first slice. */
+void
+benchmark_start(void)
+{
+    benchmark_profile_on       = profile_on;
+    benchmark_profile_interval = profile_interval;
+    profile_interval           = 0;
+    profile_reset();
+    profile_set(benchmark_profile);
+
+    benchmark_host_start  = profile_now();
+    benchmark_tsc_start   = tsc;
+    benchmark_idle_start  = cpu_idle_cycles;
+    benchmark_blits_start = benchmark_blits();
+    benchmark_ins_start   = cpu_instructions;
+    voodoo_jit_get_total_stats(&benchmark_voodoo_jit_start);
+    benchmark_net_start();
+#ifdef USE_NEW_DYNAREC
+    benchmark_codegen_start = codegen_stats;
+#endif
+}
+
+/* Returns 1 once the requested number of emulated seconds has been run. */
+int
+benchmark_done(void)
+{
+    return (tsc - benchmark_tsc_start) >= ((uint64_t) benchmark_seconds * (uint64_t) cpu_s->rspeed);
+}
+
+void
+benchmark_report(void)
+{
+    profile_entry_t *entries;
+    int              nr_entries;
+    uint64_t         kind_ns[PROFILE_KINDS]    = { 0 };
+    uint64_t         kind_calls[PROFILE_KINDS] = { 0 };
+    uint64_t         host_ns = profile_now() - benchmark_host_start;
+    uint64_t         guest   = tsc - benchmark_tsc_start;
+    uint64_t         idle    = cpu_idle_cycles - benchmark_idle_start;
+    uint64_t         blits   = benchmark_blits() - benchmark_blits_start;
+    uint64_t         ins     = cpu_instructions - benchmark_ins_start;
+    double           host_s  = (double) host_ns / 1000000000.0;
+    double           guest_s = (double) guest / (double) cpu_s->rspeed;
+
+    printf("{\"machine\":");
+    benchmark_print_string(machine_get_internal_name());
+    printf(",\"cpu\":");
+    benchmark_print_string(cpu_s->name);
+    printf(",\"cpu_hz\":%u", (uint32_t) cpu_s->rspeed);
+    printf(",\"guest_seconds\":%.6f,\"host_seconds\":%.6f,\"host_guest_ratio\":%.6f",
+           guest_s, host_s, (guest_s > 0.0) ? (host_s / guest_s) : 0.0);
+    printf(",\"guest_cycles\":%" PRIu64 ",\"idle_cycles\":%" PRIu64, guest, idle);
+    printf(",\"emulated_mhz\":%.3f,\"emulated_busy_mhz\":%.3f",
+           (host_s > 0.0) ? ((double) guest / host_s / 1000000.0) : 0.0,
+           (host_s > 0.0) ? ((double) (guest - idle) / host_s / 1000000.0) : 0.0);
+    /* Only the 286 and later cores count their instructions. */
+    printf(",\"instructions\":%" PRIu64 ",\"emulated_mips\":%.3f",
+           ins, (host_s > 0.0) ? ((double) ins / host_s / 1000000.0) : 0.0);
+    printf(",\"blits\":%" PRIu64 ",\"blits_per_second\":%.3f",
+           blits, (host_s > 0.0) ? ((double) blits / host_s) : 0.0);
+#ifdef USE_NEW_DYNAREC
+    benchmark_dynarec();
+#endif
+    benchmark_voodoo_jit();
+    benchmark_net();
+    printf(",\"profiled\":%s", benchmark_profile ? "true" : "false");
+
+    if (benchmark_profile) {
+        entries    = malloc(PROFILE_MAX_ENTRIES * sizeof(profile_entry_t));
+        nr_entries = profile_get_entries(entries, PROFILE_MAX_ENTRIES);
+        for (int c = 0; c < nr_entries; c++) {
+            kind_ns[entries[c].kind] += entries[c].ns;
+            kind_calls[entries[c].kind] += entries[c].calls;
+        }
+
+#ifndef USE_NEW_DYNAREC
+        printf(",\"dynarec_compiles\":%" PRIu64 ",\"dynarec_blocks_run\":%" PRIu64 ",\"dynarec_interpreted\":%" PRIu64,
+               kind_calls[PROFILE_CODEGEN_COMPILE], kind_calls[PROFILE_CODEGEN_EXEC], kind_calls[PROFILE_CODEGEN_INTERP]);
+#endif
+
+        printf(",\"subsystems\":{");
+        for (int k = 0; k < PROFILE_KINDS; k++) {
+            printf("%s\"%s\":{\"seconds\":%.6f,\"calls\":%" PRIu64 "}", k ? "," : "",
+                   profile_kind_names[k], (double) kind_ns[k] / 1000000000.0, kind_calls[k]);
+        }
+
+        printf("},\"handlers\":[");
+        for (int c = 0; (c < nr_entries) && (c < BENCHMARK_HANDLERS); c++) {
+            printf("%s{\"name\":", c ? "," : "");
+            benchmark_print_string(entries[c].name);
+            printf(",\"kind\":\"%s\",\"seconds\":%.6f,\"calls\":%" PRIu64 ",\"max_us\":%.3f}",
+                   profile_kind_names[entries[c].kind], (double) entries[c].ns / 1000000000.0,
+                   entries[c].calls, (double) entries[c].max_ns / 1000.0);
+        }
+        printf("]");
+
+        free(entries);
+    }
+
+    profile_set(0);
+    benchmark_io();
+
+    printf("}\n");
+    fflush(stdout);
+
+    profile_interval = benchmark_profile_interval;
+    profile_set(benchmark_profile_on);
+}
@@ -40,6 +40,8 @@
 #include <86box/cdrom.h>
 #include <86box/cdrom_image.h>
 #include <86box/cdrom_image_viso.h>
+#include <86box/cdrom_image_cache.h>
+#include <86box/thread.h>
 
 #include <sndfile.h>
 
@@ -509,6 +511,369 @@ bin_init(const uint8_t id, const char *filename, int *error)
     return tf;
 }
 
+/* Compressed (CSO) file functions.
+
+   A CSO file is an image split into blocks of block_size bytes, each of
+   them deflated on its own, preceded by an index of the file offsets of
+   the blocks, so any block can be found and decompressed by itself. The
+   decompressed blocks are kept in an LRU cache shared by all the drives.
+   The cache mutex only covers looking blocks up and storing them; reading
+   and decompressing happen under the file's own mutex, so a slow read on
+   one drive does not hold up the others. */
+#define CSO_HEADER_SIZE 24
+#define CSO_MAX_BLOCK   65536
+#define CSO_CACHE_HUNKS 256 /* Decompressed blocks kept in the cache. */
+#define CSO_PLAIN       0x80000000
+
+typedef struct cso_file_t {
+    uint64_t  total_bytes;
+    uint32_t  block_size;
+    uint32_t  blocks;
+    uint8_t   align;
+    uint8_t   version;
+    uint32_t *index; /* blocks + 1 entries. */
+    uint8_t  *comp_buf;
+    uint32_t  comp_buf_size;
+    uint8_t  *block_buf; /* One decompressed block. */
+    z_stream  zs;
+    mutex_t  *mutex; /* Guards the file, comp_buf, block_buf and zs. */
+} cso_file_t;
+
+typedef struct cso_hunk_t {
+    const track_file_t *tf;
+    uint32_t            block;
+    uint64_t            last_use;
+    uint32_t            size; /* Allocated size of data. */
+    uint8_t            *data;
+} cso_hunk_t;
+
+static cso_hunk_t *cso_cache;
+static mutex_t    *cso_cache_mutex;
+static uint64_t    cso_cache_clock;
+static int         cso_files;
+
+static uint32_t
+cso_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* Decompress a block into the given buffer, returns 0 on failure. */
+static int
+cso_decompress(track_file_t *tf, const uint32_t block, uint8_t *buffer)
+{
+    cso_file_t    *cso    = (cso_file_t *) tf->priv;
+    const uint32_t entry  = cso->index[block];
+    const uint64_t start  = ((uint64_t) (entry & ~CSO_PLAIN)) << cso->align;
+    const uint64_t end    = ((uint64_t) (cso->index[block + 1] & ~CSO_PLAIN)) << cso->align;
+    const uint32_t size   = (end > start) ? (uint32_t) (end - start) : 0;
+    uint32_t       out    = cso->block_size;
+    int            plain  = (entry & CSO_PLAIN) || (size >= cso->block_size);
+
+    /* The last block may be short. */
+    if ((((uint64_t) block + 1) * cso->block_size) > cso->total_bytes)
+        out = (uint32_t) (cso->total_bytes - ((uint64_t) block * cso->block_size));
+
+    /* In version 2, the flag marks LZ4 blocks, which are not supported. */
+    if ((cso->version >= 2) && (entry & CSO_PLAIN)) {
+        image_log(tf->log, "CSO block %u is LZ4 compressed\n", block);
+        return 0;
+    }
+
+    if ((size == 0) || (fseeko64(tf->fp, start, SEEK_SET) == -1))
+        return 0;
+
+    if (plain)
+        return fread(buffer, MIN(size, out), 1, tf->fp) == 1;
+
+    if (size > cso->comp_buf_size) {
+        uint8_t *buf = (uint8_t *) realloc(cso->comp_buf, size);
+
+        if (buf == NULL)
+            return 0;
+
+        cso->comp_buf      = buf;
+        cso->comp_buf_size = size;
+    }
+
+    if (fread(cso->comp_buf, size, 1, tf->fp) != 1)
+        return 0;
+
+    inflateReset(&cso->zs);
+    cso->zs.next_in   = cso->comp_buf;
+    cso->zs.avail_in  = size;
+    cso->zs.next_out  = buffer;
+    cso->zs.avail_out = out;
+
+    const int ret = inflate(&cso->zs, Z_FINISH);
+
+    return ((ret == Z_STREAM_END) || (ret == Z_OK) || (ret == Z_BUF_ERROR)) && (cso->zs.avail_out == 0);
+}
+
+/* Copies part of a block from the cache, returns 0 if it is not cached.
+   Must be called with the cache mutex held. */
+static int
+cso_cache_copy(const track_file_t *tf, const uint32_t block, uint8_t *buffer, const uint32_t offset, const size_t len)
+{
+    for (int i = 0; i < CSO_CACHE_HUNKS; i++) {
+        if ((cso_cache[i].tf == tf) && (cso_cache[i].block == block)) {
+            cso_cache[i].last_use = ++cso_cache_clock;
+            memcpy(buffer, cso_cache[i].data + offset, len);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Stores a decompressed block in the cache, evicting the least recently
+   used hunk. Must be called with the cache mutex held. */
+static void
+cso_cache_insert(const track_file_t *tf, const uint32_t block, const uint8_t *data)
+{
+    const cso_file_t *cso  = (cso_file_t *) tf->priv;
+    cso_hunk_t       *hunk = &(cso_cache[0]);
+
+    for (int i = 0; i < CSO_CACHE_HUNKS; i++) {
+        /* Another thread may have cached it in the meantime. */
+        if ((cso_cache[i].tf == tf) && (cso_cache[i].block == block)) {
+            cso_cache[i].last_use = ++cso_cache_clock;
+            return;
+        }
+
+        if (cso_cache[i].last_use < hunk->last_use)
+            hunk = &(cso_cache[i]);
+    }
+
+    hunk->tf       = NULL;
+    hunk->last_use = 0;
+
+    if (hunk->size < cso->block_size) {
+        uint8_t *hunk_data = (uint8_t *) realloc(hunk->data, cso->block_size);
+
+        if (hunk_data == NULL)
+            return;
+
+        hunk->data = hunk_data;
+        hunk->size = cso->block_size;
+    }
+
+    memcpy(hunk->data, data, cso->block_size);
+
+    hunk->tf       = tf;
+    hunk->block    = block;
+    hunk->last_use = ++cso_cache_clock;
+}
+
+static int
+cso_read(void *priv, uint8_t *buffer, const uint64_t seek, const size_t count)
+{
+    track_file_t *tf     = (track_file_t *) priv;
+    cso_file_t   *cso    = (cso_file_t *) tf->priv;
+    uint64_t      pos    = seek;
+    size_t        remain = count;
+    int           ret    = 1;
+
+    image_log(tf->log, "cso_read(pos=%" PRIu64 " count=%lu)\n", seek, count);
+
+    if ((seek + count) > cso->total_bytes)
+        return -1;
+
+    while (remain > 0) {
+        const uint32_t block  = (uint32_t) (pos / cso->block_size);
+        const uint32_t offset = (uint32_t) (pos % cso->block_size);
+        const size_t   len    = MIN(remain, (size_t) (cso->block_size - offset));
+        int            found;
+
+        thread_wait_mutex(cso_cache_mutex);
+        found = cso_cache_copy(tf, block, buffer, offset, len);
+        thread_release_mutex(cso_cache_mutex);
+
+        if (!found) {
+            thread_wait_mutex(cso->mutex);
+
+            found = cso_decompress(tf, block, cso->block_buf);
+            if (found) {
+                memcpy(buffer, cso->block_buf + offset, len);
+
+                thread_wait_mutex(cso_cache_mutex);
+                cso_cache_insert(tf, block, cso->block_buf);
+                thread_release_mutex(cso_cache_mutex);
+            }
+
+            thread_release_mutex(cso->mutex);
+        }
+
+        if (!found) {
+            image_log(tf->log, "cso_read failed on block %u!\n", block);
+            ret = -1;
+            break;
+        }
+
+        buffer += len;
+        pos += len;
+        remain -= len;
+    }
+
+    return ret;
+}
+
+static uint64_t
+cso_get_length(void *priv)
+{
+    const track_file_t *tf  = (track_file_t *) priv;
+    const cso_file_t   *cso = (cso_file_t *) tf->priv;
+
+    return cso->total_bytes;
+}
+
+static void
+cso_close(void *priv)
+{
+    track_file_t *tf  = (track_file_t *) priv;
+    cso_file_t   *cso = (cso_file_t *) tf->priv;
+
+    if (tf->fp != NULL) {
+        fclose(tf->fp);
+        tf->fp = NULL;
+    }
+
+    if (cso != NULL) {
+        thread_wait_mutex(cso_cache_mutex);
+        for (int i = 0; i < CSO_CACHE_HUNKS; i++) {
+            if (cso_cache[i].tf == tf) {
+                cso_cache[i].tf       = NULL;
+                cso_cache[i].last_use = 0;
+            }
+        }
+        thread_release_mutex(cso_cache_mutex);
+
+        inflateEnd(&cso->zs);
+        thread_close_mutex(cso->mutex);
+        free(cso->index);
+        free(cso->comp_buf);
+        free(cso->block_buf);
+        free(cso);
+
+        if (--cso_files == 0) {
+            for (int i = 0; i < CSO_CACHE_HUNKS; i++)
+                free(cso_cache[i].data);
+            free(cso_cache);
+            cso_cache = NULL;
+            thread_close_mutex(cso_cache_mutex);
+            cso_cache_mutex = NULL;
+        }
+    }
+
+    memset(tf->fn, 0x00, sizeof(tf->fn));
+
+    log_close(tf->log);
+    tf->log = NULL;
+
+    free(tf);
+}
+
+/* Returns NULL without an error if the file is not a CSO file. */
+static track_file_t *
+cso_init(const uint8_t id, const char *filename, int *error)
+{
+    track_file_t *tf = NULL;
+    cso_file_t   *cso;
+    FILE         *fp;
+    uint8_t       header[CSO_HEADER_SIZE];
+    uint8_t      *index;
+    char          n[1024] = { 0 };
+
+    *error = 0;
+
+    fp = plat_fopen64(filename, "rb");
+    if (fp == NULL)
+        return NULL;
+
+    if ((fread(header, CSO_HEADER_SIZE, 1, fp) != 1) || memcmp(header, "CISO", 4)) {
+        fclose(fp);
+        return NULL;
+    }
+
+    *error = 1;
+
+    tf  = (track_file_t *) calloc(1, sizeof(track_file_t));
+    cso = (cso_file_t *) calloc(1, sizeof(cso_file_t));
+    if ((tf == NULL) || (cso == NULL)) {
+        free(tf);
+        free(cso);
+        fclose(fp);
+        return NULL;
+    }
+
+    sprintf(n, "CD-ROM %i CSO  ", id + 1);
+    tf->log = log_open(n);
+
+    memset(tf->fn, 0x00, sizeof(tf->fn));
+    strncpy(tf->fn, filename, sizeof(tf->fn) - 1);
+    tf->fp   = fp;
+    tf->priv = cso;
+
+    cso->total_bytes = ((uint64_t) cso_le32(&(header[12])) << 32) | cso_le32(&(header[8]));
+    cso->block_size  = cso_le32(&(header[16]));
+    cso->version     = header[20];
+    cso->align       = header[21];
+
+    if ((cso->block_size == 0) || (cso->block_size > CSO_MAX_BLOCK) || (cso->align > 31) ||
+        (cso->total_bytes == 0) || (((cso->total_bytes + cso->block_size - 1) / cso->block_size) >= 0x40000000ULL)) {
+        image_log(tf->log, "Invalid CSO header\n");
+        goto cleanup_error;
+    }
+
+    cso->blocks = (uint32_t) ((cso->total_bytes + cso->block_size - 1) / cso->block_size);
+
+    /* The index always follows the 24-byte header, whatever the header
+       size field says. */
+    index      = (uint8_t *) malloc(((size_t) cso->blocks + 1) * 4);
+    cso->index = (uint32_t *) malloc(((size_t) cso->blocks + 1) * sizeof(uint32_t));
+    if ((index == NULL) || (cso->index == NULL) ||
+        (fread(index, ((size_t) cso->blocks + 1) * 4, 1, fp) != 1)) {
+        image_log(tf->log, "Unable to read the CSO index\n");
+        free(index);
+        goto cleanup_error;
+    }
+
+    for (uint32_t i = 0; i <= cso->blocks; i++)
+        cso->index[i] = cso_le32(&(index[i << 2]));
+    free(index);
+
+    cso->block_buf = (uint8_t *) malloc(cso->block_size);
+    if ((cso->block_buf == NULL) || (inflateInit2(&cso->zs, -15) != Z_OK))
+        goto cleanup_error;
+
+    cso->mutex = thread_create_mutex();
+
+    if (cso_files++ == 0) {
+        cso_cache       = (cso_hunk_t *) calloc(CSO_CACHE_HUNKS, sizeof(cso_hunk_t));
+        cso_cache_mutex = thread_create_mutex();
+    }
+
+    image_log(tf->log, "cso_open(%s): %" PRIu64 " bytes, %u-byte blocks, version %i\n",
+              tf->fn, cso->total_bytes, cso->block_size, cso->version);
+
+    *error = 0;
+
+    tf->read       = cso_read;
+    tf->get_length = cso_get_length;
+    tf->close      = cso_close;
+
+    return tf;
+
+cleanup_error:
+    free(cso->index);
+    free(cso->block_buf);
+    free(cso);
+    fclose(fp);
+    log_close(tf->log);
+    free(tf);
+    return NULL;
+}
+
 static track_file_t *
 index_file_init(const uint8_t id, const char *filename, int *error, int *is_viso)
 {
@@ -516,9 +881,12 @@ index_file_init(const uint8_t id, const char *filename, int *error, int *is_viso
 
     *is_viso = 0;
 
-    /* Current we only support .BIN files, either combined or one per
-       track. In the future, more is planned. */
-    tf = bin_init(id, filename, error);
+    /* Try a compressed file first, then a plain .BIN file, either
+       combined or one per track. */
+    tf = cso_init(id, filename, error);
+
+    if ((tf == NULL) && !*error)
+        tf = bin_init(id, filename, error);
 
     if (*error) {
         if ((tf != NULL) && (tf->close != NULL)) {
@@ -532,6 +900,9 @@ index_file_init(const uint8_t id, const char *filename, int *error, int *is_viso
             *is_viso = 1;
     }
 
+    if (!*error)
+        image_cache_init(tf);
+
     return tf;
 }
 
@@ -0,0 +1,359 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          CD-ROM image read-ahead cache.
+ *
+ *          Sits on top of a track file and serves its reads from memory.
+ *          Each file has two windows of IMAGE_CACHE_WINDOW bytes: the one
+ *          being read from, and one that is filled in the background by
+ *          a prefetch thread shared by all the files, with the data that
+ *          follows it. Prefetching is only done while the reads are
+ *          sequential, random reads go straight to the file.
+ *
+ *          The file itself is only ever accessed with the file's I/O
+ *          mutex held, so the back-ends do not have to be thread safe.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#ifndef _LARGEFILE_SOURCE
+#    define _LARGEFILE_SOURCE
+#endif
+#ifndef _LARGEFILE64_SOURCE
+#    define _LARGEFILE64_SOURCE
+#endif
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/cdrom.h>
+#include <86box/cdrom_image.h>
+#include <86box/cdrom_image_cache.h>
+#include <86box/log.h>
+#include <86box/thread.h>
+#include <86box/plat_unused.h>
+
+#define IMAGE_CACHE_WINDOW (128 * 2352) /* Bytes per window, 128 raw sectors. */
+
+typedef struct image_cache_t {
+    int      (*read)(void *priv, uint8_t *buffer, uint64_t seek, size_t count);
+    uint64_t (*get_length)(void *priv);
+    void     (*close)(void *priv);
+
+    track_file_t *tf;
+    uint64_t      length;
+    uint64_t      last_end; /* End of the last read, to detect sequential access. */
+
+    uint8_t *buf[2];
+    uint64_t start[2];
+    uint64_t len[2]; /* 0 = empty. */
+    int      cur;    /* Window reads are served from, the other is prefetched. */
+
+    int      pending; /* A prefetch into the other window is queued or running. */
+    uint64_t prefetch_pos;
+
+    mutex_t *mutex;    /* Window state. */
+    mutex_t *io_mutex; /* The track file. */
+    event_t *done_event;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t prefetches;
+
+    struct image_cache_t *next; /* Prefetch queue. */
+} image_cache_t;
+
+/* The prefetch thread, shared by all the files. */
+static thread_t      *cache_thread;
+static event_t       *cache_wake_event;
+static mutex_t       *cache_queue_mutex;
+static image_cache_t *cache_queue;
+static volatile int   cache_thread_running;
+static int            cache_files;
+
+#ifdef ENABLE_IMAGE_CACHE_LOG
+int image_cache_do_log = ENABLE_IMAGE_CACHE_LOG;
+
+static void
+image_cache_log(void *priv, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (image_cache_do_log) {
+        va_start(ap, fmt);
+        /* The log of the file is closed before the file itself. */
+        if (priv == NULL)
+            pclog_ex(fmt, ap);
+        else
+            log_out(priv, fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define image_cache_log(priv, fmt, ...)
+#endif
+
+static int
+image_cache_file_read(image_cache_t *cache, uint8_t *buffer, uint64_t seek, size_t count)
+{
+    int ret;
+
+    thread_wait_mutex(cache->io_mutex);
+    ret = cache->read(cache->tf, buffer, seek, count);
+    thread_release_mutex(cache->io_mutex);
+
+    return ret;
+}
+
+/* Fill a window starting at pos, returns 0 on failure. */
+static int
+image_cache_fill(image_cache_t *cache, int window, uint64_t pos)
+{
+    uint64_t len = cache->length - pos;
+
+    if (len > IMAGE_CACHE_WINDOW)
+        len = IMAGE_CACHE_WINDOW;
+
+    cache->len[window] = 0;
+
+    if ((pos >= cache->length) || (image_cache_file_read(cache, cache->buf[window], pos, (size_t) len) <= 0))
+        return 0;
+
+    cache->start[window] = pos;
+    cache->len[window]   = len;
+
+    return 1;
+}
+
+static int
+image_cache_contains(const image_cache_t *cache, int window, uint64_t seek, size_t count)
+{
+    return cache->len[window] && (seek >= cache->start[window]) &&
+           ((seek + count) <= (cache->start[window] + cache->len[window]));
+}
+
+static void
+image_cache_thread(UNUSED(void *param))
+{
+    image_cache_t *cache;
+    uint64_t       pos;
+    int            window;
+    int            ret;
+
+    while (1) {
+        thread_wait_event(cache_wake_event, -1);
+        thread_reset_event(cache_wake_event);
+
+        if (!cache_thread_running)
+            break;
+
+        while (1) {
+            thread_wait_mutex(cache_queue_mutex);
+            cache = cache_queue;
+            if (cache != NULL)
+                cache_queue = cache->next;
+            thread_release_mutex(cache_queue_mutex);
+
+            if (cache == NULL)
+                break;
+
+            /* The reader leaves the other window alone while the prefetch
+               is pending, so it can be filled without holding the mutex. */
+            thread_wait_mutex(cache->mutex);
+            window = cache->cur ^ 1;
+            pos    = cache->prefetch_pos;
+            thread_release_mutex(cache->mutex);
+
+            ret = image_cache_fill(cache, window, pos);
+
+            thread_wait_mutex(cache->mutex);
+            if (ret)
+                cache->prefetches++;
+            cache->pending = 0;
+            thread_set_event(cache->done_event);
+            thread_release_mutex(cache->mutex);
+        }
+    }
+}
+
+/* Queue a prefetch of the data following the current window, called with
+   the mutex held. */
+static void
+image_cache_prefetch(image_cache_t *cache)
+{
+    const int      other = cache->cur ^ 1;
+    const uint64_t pos   = cache->start[cache->cur] + cache->len[cache->cur];
+
+    if (cache->pending || (pos >= cache->length) ||
+        (cache->len[other] && (cache->start[other] == pos)))
+        return;
+
+    cache->pending      = 1;
+    cache->prefetch_pos = pos;
+    thread_reset_event(cache->done_event);
+
+    thread_wait_mutex(cache_queue_mutex);
+    cache->next = cache_queue;
+    cache_queue = cache;
+    thread_release_mutex(cache_queue_mutex);
+
+    thread_set_event(cache_wake_event);
+}
+
+/* Wait for a pending prefetch to finish, called with the mutex held. */
+static void
+image_cache_wait(image_cache_t *cache)
+{
+    while (cache->pending) {
+        thread_release_mutex(cache->mutex);
+        thread_wait_event(cache->done_event, -1);
+        thread_wait_mutex(cache->mutex);
+    }
+}
+
+static int
+image_cache_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
+{
+    const track_file_t *tf    = (track_file_t *) priv;
+    image_cache_t      *cache = (image_cache_t *) tf->cache;
+    int                 sequential;
+
+    thread_wait_mutex(cache->mutex);
+
+    sequential      = (seek == cache->last_end);
+    cache->last_end = seek + count;
+
+    /* If the pending prefetch is what is being read, wait for it. */
+    if (cache->pending && (seek >= cache->prefetch_pos) &&
+        ((seek + count) <= (cache->prefetch_pos + IMAGE_CACHE_WINDOW)))
+        image_cache_wait(cache);
+
+    if (!cache->pending && !image_cache_contains(cache, cache->cur, seek, count) &&
+        image_cache_contains(cache, cache->cur ^ 1, seek, count))
+        cache->cur ^= 1;
+
+    if (image_cache_contains(cache, cache->cur, seek, count))
+        cache->hits++;
+    else {
+        cache->misses++;
+
+        if (!sequential || (count > IMAGE_CACHE_WINDOW) || !image_cache_fill(cache, cache->cur, seek)) {
+            thread_release_mutex(cache->mutex);
+            return image_cache_file_read(cache, buffer, seek, count);
+        }
+    }
+
+    memcpy(buffer, cache->buf[cache->cur] + (seek - cache->start[cache->cur]), count);
+
+    if (sequential)
+        image_cache_prefetch(cache);
+
+    thread_release_mutex(cache->mutex);
+
+    return 1;
+}
+
+static uint64_t
+image_cache_get_length(void *priv)
+{
+    const track_file_t  *tf    = (track_file_t *) priv;
+    const image_cache_t *cache = (image_cache_t *) tf->cache;
+
+    return cache->length;
+}
+
+static void
+image_cache_close(void *priv)
+{
+    track_file_t  *tf    = (track_file_t *) priv;
+    image_cache_t *cache = (image_cache_t *) tf->cache;
+    void         (*close_func)(void *priv) = cache->close;
+
+    thread_wait_mutex(cache->mutex);
+    image_cache_wait(cache);
+    thread_release_mutex(cache->mutex);
+
+    image_cache_log(tf->log, "Read-ahead cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " prefetches\n",
+                    cache->hits, cache->misses, cache->prefetches);
+
+    thread_destroy_event(cache->done_event);
+    thread_close_mutex(cache->io_mutex);
+    thread_close_mutex(cache->mutex);
+    free(cache->buf[0]);
+    free(cache->buf[1]);
+    free(cache);
+
+    tf->cache      = NULL;
+    tf->read       = NULL;
+    tf->get_length = NULL;
+    tf->close      = NULL;
+
+    if (--cache_files == 0) {
+        cache_thread_running = 0;
+        thread_set_event(cache_wake_event);
+        thread_wait(cache_thread);
+        cache_thread = NULL;
+
+        thread_destroy_event(cache_wake_event);
+        cache_wake_event = NULL;
+        thread_close_mutex(cache_queue_mutex);
+        cache_queue_mutex = NULL;
+    }
+
+    close_func(tf);
+}
+
+/* Put a read-ahead cache in front of an opened track file. */
+void
+image_cache_init(track_file_t *tf)
+{
+    image_cache_t *cache = (image_cache_t *) calloc(1, sizeof(image_cache_t));
+
+    if (cache == NULL)
+        return;
+
+    cache->buf[0] = (uint8_t *) malloc(IMAGE_CACHE_WINDOW);
+    cache->buf[1] = (uint8_t *) malloc(IMAGE_CACHE_WINDOW);
+    if ((cache->buf[0] == NULL) || (cache->buf[1] == NULL)) {
+        free(cache->buf[0]);
+        free(cache->buf[1]);
+        free(cache);
+        return;
+    }
+
+    cache->read       = tf->read;
+    cache->get_length = tf->get_length;
+    cache->close      = tf->close;
+    cache->tf         = tf;
+    cache->length     = tf->get_length(tf);
+    cache->last_end   = UINT64_MAX;
+
+    cache->mutex      = thread_create_mutex();
+    cache->io_mutex   = thread_create_mutex();
+    cache->done_event = thread_create_event();
+
+    if (cache_files++ == 0) {
+        cache_queue          = NULL;
+        cache_queue_mutex    = thread_create_mutex();
+        cache_wake_event     = thread_create_event();
+        cache_thread_running = 1;
+        cache_thread         = thread_create(image_cache_thread, NULL);
+    }
+
+    tf->cache      = cache;
+    tf->read       = image_cache_read;
+    tf->get_length = image_cache_get_length;
+    tf->close      = image_cache_close;
+}
@@ -79,7 +79,7 @@ typedef struct stat stat_t;
     }
 
 #define VISO_SECTOR_SIZE COOKED_SECTOR_SIZE
-#define VISO_OPEN_FILES  32
+#define VISO_OPEN_FILES  128
 
 enum {
     VISO_CHARSET_D = 0,
@@ -113,6 +113,7 @@ typedef struct _viso_entry_ {
         uint64_t data_offset;
     };
     uint16_t pt_idx;
+    uint64_t file_pos; /* Position of file, so sequential reads need no seek. */
 
     stat_t stats;
 
@@ -121,6 +122,17 @@ typedef struct _viso_entry_ {
     char *basename, path[];
 } viso_entry_t;
 
+typedef struct {
+    int64_t mtime;
+    int64_t mtime_ns; /* 0 where the host has no sub-second times */
+    int64_t ctime;
+} viso_cache_stamp_t;
+
+typedef struct {
+    char              *path;
+    viso_cache_stamp_t stamp;
+} viso_cache_dir_t;
+
 typedef struct {
     uint64_t vol_size_offsets[2];
     uint64_t pt_meta_offsets[2];
@@ -133,6 +145,10 @@ typedef struct {
     viso_entry_t  *root_dir;
     viso_entry_t **entry_map;
     viso_entry_t  *file_fifo[VISO_OPEN_FILES];
+
+    viso_cache_dir_t *cache_dirs; /* Directories scanned, for the metadata cache. */
+    size_t            cache_dirs_num, cache_dirs_size;
+    time_t            cache_time; /* When the scan started. */
 } viso_t;
 
 static const char rr_eid[]   = "RRIP_1991A"; /* identifiers used in ER field for Rock Ridge */
@@ -718,6 +734,7 @@ viso_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
                     image_viso_log(viso->tf.log, "Opening [%s]...\n", entry->path);
                     if ((entry->file = fopen(entry->path, "rb"))) {
                         image_viso_log(viso->tf.log, "Done\n");
+                        entry->file_pos = 0;
 
                         /* Add this entry to the FIFO. */
                         viso->file_fifo[viso->file_fifo_pos++] = entry;
@@ -730,10 +747,13 @@ viso_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
                     }
                 }
 
-                /* Read data. */
-                if (!entry->file || (fseeko64(entry->file, seek - entry->data_offset, SEEK_SET) == -1))
+                /* Read data, seeking only if the last read did not end here. */
+                const uint64_t file_offset = seek - entry->data_offset;
+                if (!entry->file || ((entry->file_pos != file_offset) &&
+                                     (fseeko64(entry->file, file_offset, SEEK_SET) == -1)))
                     return -1;
-                read = fread(buffer, 1, sector_remain, entry->file);
+                read            = fread(buffer, 1, sector_remain, entry->file);
+                entry->file_pos = file_offset + read;
                 if (sector_remain && !read)
                     return -1;
             }
@@ -761,6 +781,331 @@ viso_get_length(void *priv)
     return ((uint64_t) viso->all_sectors) * viso->sector_size;
 }
 
+/* Metadata cache.
+
+   Building the metadata means listing and stat'ing the whole directory
+   tree, which can take a long time on large or network-hosted trees. The
+   result is saved next to the machine's NVR files, along with the
+   modification and status change times of all the directories and the
+   sizes and times of all the files, and reused on the next mount if none
+   of those changed. The status change time covers chmod and chown, which
+   Rock Ridge records but which leave the modification time alone. */
+#define VISO_CACHE_MAGIC   "86Box VISO cache"
+#define VISO_CACHE_VERSION 2
+
+typedef struct {
+    char     magic[16];
+    uint32_t version;
+    uint32_t sector_size;
+    uint64_t metadata_sectors;
+    uint64_t all_sectors;
+    uint64_t entry_map_size;
+    uint64_t dirs;
+    uint64_t files;
+} viso_cache_header_t;
+
+static void
+viso_cache_path(char *dest, const char *dirname)
+{
+    uint32_t hash = 0x811c9dc5; /* FNV-1a */
+    char     fn[32];
+
+    for (const char *p = dirname; *p; p++)
+        hash = (hash ^ (uint8_t) *p) * 0x01000193;
+
+    sprintf(fn, "viso-%08X.cache", hash);
+    strcpy(dest, nvr_path(fn));
+}
+
+static void
+viso_cache_get_stamp(viso_cache_stamp_t *stamp, const stat_t *stats)
+{
+    stamp->mtime    = (int64_t) stats->st_mtime;
+    stamp->mtime_ns = 0;
+    stamp->ctime    = (int64_t) stats->st_ctime;
+#if defined(__APPLE__)
+    stamp->mtime_ns = (int64_t) stats->st_mtimespec.tv_nsec;
+#elif !defined(_WIN32)
+    stamp->mtime_ns = (int64_t) stats->st_mtim.tv_nsec;
+#endif
+}
+
+static int
+viso_cache_stamp_equal(const viso_cache_stamp_t *a, const viso_cache_stamp_t *b)
+{
+    return (a->mtime == b->mtime) && (a->mtime_ns == b->mtime_ns) && (a->ctime == b->ctime);
+}
+
+/* A change made later in the same second as a timestamp cannot be told
+   apart on hosts or file systems with one-second times, so anything
+   touched since the scan started is not trusted to validate the cache. */
+static int
+viso_cache_stamp_settled(const viso_t *viso, const viso_cache_stamp_t *stamp)
+{
+    return (stamp->mtime < (int64_t) viso->cache_time) && (stamp->ctime < (int64_t) viso->cache_time);
+}
+
+/* Remember a directory whose times validate the cache. */
+static void
+viso_cache_add_dir(viso_t *viso, const viso_entry_t *dir)
+{
+    if (viso->cache_dirs_num == viso->cache_dirs_size) {
+        size_t            size = viso->cache_dirs_size ? (viso->cache_dirs_size * 2) : 64;
+        viso_cache_dir_t *dirs = (viso_cache_dir_t *) realloc(viso->cache_dirs, size * sizeof(viso_cache_dir_t));
+
+        if (dirs == NULL)
+            return;
+
+        viso->cache_dirs      = dirs;
+        viso->cache_dirs_size = size;
+    }
+
+    viso->cache_dirs[viso->cache_dirs_num].path  = strdup(dir->path);
+    viso_cache_get_stamp(&viso->cache_dirs[viso->cache_dirs_num].stamp, &dir->stats);
+    if (viso->cache_dirs[viso->cache_dirs_num].path != NULL)
+        viso->cache_dirs_num++;
+}
+
+static void
+viso_cache_free_dirs(viso_t *viso)
+{
+    for (size_t i = 0; i < viso->cache_dirs_num; i++)
+        free(viso->cache_dirs[i].path);
+    free(viso->cache_dirs);
+
+    viso->cache_dirs      = NULL;
+    viso->cache_dirs_num  = 0;
+    viso->cache_dirs_size = 0;
+}
+
+static int
+viso_cache_write_string(FILE *fp, const char *s)
+{
+    const uint32_t len = (uint32_t) strlen(s);
+
+    return (fwrite(&len, sizeof(len), 1, fp) == 1) && (!len || (fwrite(s, len, 1, fp) == 1));
+}
+
+/* Returns a newly allocated string, or NULL on failure. */
+static char *
+viso_cache_read_string(FILE *fp)
+{
+    uint32_t len;
+    char    *s;
+
+    if ((fread(&len, sizeof(len), 1, fp) != 1) || (len > 65535))
+        return NULL;
+
+    s = (char *) malloc(len + 1);
+    if ((s != NULL) && len && (fread(s, len, 1, fp) != 1)) {
+        free(s);
+        return NULL;
+    }
+    if (s != NULL)
+        s[len] = '\0';
+
+    return s;
+}
+
+static void
+viso_cache_save(viso_t *viso, const char *dirname)
+{
+    viso_cache_header_t header = { 0 };
+    viso_cache_stamp_t  stamp;
+    const viso_entry_t *entry;
+    char                path[1024];
+    FILE               *fp;
+    int                 ok;
+
+    for (size_t i = 0; i < viso->cache_dirs_num; i++) {
+        if (!viso_cache_stamp_settled(viso, &viso->cache_dirs[i].stamp)) {
+            image_viso_log(viso->tf.log, "Metadata cache not saved, %s changed during the scan\n", viso->cache_dirs[i].path);
+            return;
+        }
+    }
+    for (entry = viso->root_dir->next; entry; entry = entry->next) {
+        viso_cache_get_stamp(&stamp, &entry->stats);
+        if (!viso_cache_stamp_settled(viso, &stamp)) {
+            image_viso_log(viso->tf.log, "Metadata cache not saved, %s changed during the scan\n", entry->path);
+            return;
+        }
+    }
+
+    memcpy(header.magic, VISO_CACHE_MAGIC, sizeof(header.magic));
+    header.version          = VISO_CACHE_VERSION;
+    header.sector_size      = (uint32_t) viso->sector_size;
+    header.metadata_sectors = viso->metadata_sectors;
+    header.all_sectors      = viso->all_sectors;
+    header.entry_map_size   = viso->entry_map_size;
+    header.dirs             = viso->cache_dirs_num;
+    for (entry = viso->root_dir->next; entry; entry = entry->next)
+        header.files++;
+
+    viso_cache_path(path, dirname);
+    fp = plat_fopen64(path, "wb");
+    if (fp == NULL)
+        return;
+
+    ok = (fwrite(&header, sizeof(header), 1, fp) == 1) && viso_cache_write_string(fp, dirname);
+
+    for (size_t i = 0; ok && (i < viso->cache_dirs_num); i++) {
+        ok = (fwrite(&viso->cache_dirs[i].stamp, sizeof(viso_cache_stamp_t), 1, fp) == 1) &&
+             viso_cache_write_string(fp, viso->cache_dirs[i].path);
+    }
+
+    /* At this point, only the files are left after the root. */
+    for (entry = viso->root_dir->next; ok && entry; entry = entry->next) {
+        const uint64_t size = entry->stats.st_size;
+
+        viso_cache_get_stamp(&stamp, &entry->stats);
+
+        ok = (fwrite(&size, sizeof(size), 1, fp) == 1) &&
+             (fwrite(&stamp, sizeof(stamp), 1, fp) == 1) &&
+             (fwrite(&entry->data_offset, sizeof(entry->data_offset), 1, fp) == 1) &&
+             viso_cache_write_string(fp, entry->path);
+    }
+
+    if (ok)
+        ok = (fwrite(viso->metadata, viso->sector_size, viso->metadata_sectors, fp) == viso->metadata_sectors);
+
+    fclose(fp);
+
+    if (!ok)
+        remove(path);
+
+    image_viso_log(viso->tf.log, "Metadata cache %s %s\n", path, ok ? "saved" : "could not be saved");
+}
+
+/* Set the VISO up from the cache, returns 0 if the cache is missing or out
+   of date, in which case it has to be built again. */
+static int
+viso_cache_load(viso_t *viso, const char *dirname)
+{
+    viso_cache_header_t header;
+    viso_cache_stamp_t  stamp;
+    viso_cache_stamp_t  cur;
+    viso_entry_t       *last_entry = viso->root_dir;
+    viso_entry_t       *entry;
+    stat_t              stats;
+    char                path[1024];
+    char               *s;
+    FILE               *fp;
+    int                 ok;
+
+    viso_cache_path(path, dirname);
+    fp = plat_fopen64(path, "rb");
+    if (fp == NULL)
+        return 0;
+
+    ok = (fread(&header, sizeof(header), 1, fp) == 1) &&
+         !memcmp(header.magic, VISO_CACHE_MAGIC, sizeof(header.magic)) &&
+         (header.version == VISO_CACHE_VERSION) && (header.sector_size >= VISO_SECTOR_SIZE) &&
+         (header.metadata_sectors <= header.all_sectors) &&
+         ((header.all_sectors - header.metadata_sectors) <= header.entry_map_size);
+
+    if (ok) {
+        s  = viso_cache_read_string(fp);
+        ok = (s != NULL) && !strcmp(s, dirname);
+        free(s);
+    }
+
+    /* Any change to a directory's contents changes its modification time,
+       and any change to its attributes changes its status change time. */
+    for (uint64_t i = 0; ok && (i < header.dirs); i++) {
+        ok = (fread(&stamp, sizeof(stamp), 1, fp) == 1) && ((s = viso_cache_read_string(fp)) != NULL);
+        if (ok) {
+            ok = (stat(s, &stats) == 0) && S_ISDIR(stats.st_mode);
+            if (ok) {
+                viso_cache_get_stamp(&cur, &stats);
+                ok = viso_cache_stamp_equal(&cur, &stamp);
+            }
+            free(s);
+        }
+    }
+
+    if (ok) {
+        viso->sector_size      = header.sector_size;
+        viso->metadata_sectors = header.metadata_sectors;
+        viso->all_sectors      = header.all_sectors;
+        viso->entry_map_size   = header.entry_map_size;
+        viso->entry_map        = (viso_entry_t **) calloc(viso->entry_map_size ? viso->entry_map_size : 1, sizeof(viso_entry_t *));
+        ok                     = (viso->entry_map != NULL);
+    }
+
+    /* Files must also have kept their sizes and times. */
+    for (uint64_t i = 0; ok && (i < header.files); i++) {
+        uint64_t size;
+        uint64_t data_offset;
+
+        ok = (fread(&size, sizeof(size), 1, fp) == 1) && (fread(&stamp, sizeof(stamp), 1, fp) == 1) &&
+             (fread(&data_offset, sizeof(data_offset), 1, fp) == 1) && ((s = viso_cache_read_string(fp)) != NULL);
+        if (!ok)
+            break;
+
+        if (stat(s, &stats) == 0) {
+            if (stats.st_size > ((uint32_t) -1))
+                stats.st_size = (uint32_t) -1;
+            viso_cache_get_stamp(&cur, &stats);
+            ok = !S_ISDIR(stats.st_mode) && ((uint64_t) stats.st_size == size) && viso_cache_stamp_equal(&cur, &stamp);
+        } else
+            ok = 0;
+
+        if (ok) {
+            const uint64_t sector  = data_offset / viso->sector_size;
+            uint64_t       sectors = (size + viso->sector_size - 1) / viso->sector_size;
+
+            ok = (sector >= viso->metadata_sectors) && ((sector + sectors) <= viso->all_sectors);
+            if (ok) {
+                entry = (viso_entry_t *) calloc(1, sizeof(viso_entry_t) + strlen(s) + 1);
+                ok    = (entry != NULL);
+            }
+            if (ok) {
+                strcpy(entry->path, s);
+                entry->stats       = stats;
+                entry->parent      = viso->root_dir;
+                entry->data_offset = data_offset;
+
+                last_entry->next = entry;
+                last_entry       = entry;
+
+                for (uint64_t j = sector - viso->metadata_sectors; sectors-- > 0; j++)
+                    viso->entry_map[j] = entry;
+            }
+        }
+
+        free(s);
+    }
+
+    if (ok) {
+        viso->metadata = (uint8_t *) malloc(viso->metadata_sectors * viso->sector_size);
+        ok             = (viso->metadata != NULL) &&
+             (fread(viso->metadata, viso->sector_size, viso->metadata_sectors, fp) == viso->metadata_sectors);
+    }
+
+    fclose(fp);
+
+    if (!ok) {
+        /* Undo everything, the caller starts over. */
+        while (viso->root_dir->next) {
+            entry                = viso->root_dir->next;
+            viso->root_dir->next = entry->next;
+            free(entry);
+        }
+        free(viso->entry_map);
+        viso->entry_map = NULL;
+        free(viso->metadata);
+        viso->metadata         = NULL;
+        viso->sector_size      = VISO_SECTOR_SIZE;
+        viso->metadata_sectors = 0;
+        viso->all_sectors      = 0;
+        viso->entry_map_size   = 0;
+    }
+
+    image_viso_log(viso->tf.log, "Metadata cache %s %s\n", path, ok ? "loaded" : "missing or out of date");
+
+    return ok;
+}
+
 void
 viso_close(void *priv)
 {
@@ -776,9 +1121,12 @@ viso_close(void *priv)
     if (tf->fp)
         fclose(tf->fp);
 #ifndef ENABLE_IMAGE_VISO_LOG
-    remove(nvr_path(viso->tf.fn));
+    if (viso->tf.fn[0] != '\0')
+        remove(nvr_path(viso->tf.fn));
 #endif
 
+    viso_cache_free_dirs(viso);
+
     viso_entry_t *entry = viso->root_dir;
     viso_entry_t *next_entry;
     while (entry) {
@@ -828,16 +1176,6 @@ viso_init(const uint8_t id, const char *dirname, int *error)
     if (!data)
         goto end;
 
-        /* Open temporary file. */
-#ifdef ENABLE_IMAGE_VISO_LOG
-    strcpy(viso->tf.fn, "viso-debug.iso");
-#else
-    plat_tempfile(viso->tf.fn, "viso", ".tmp");
-#endif
-    viso->tf.fp = plat_fopen64(nvr_path(viso->tf.fn), "w+b");
-    if (!viso->tf.fp)
-        goto end;
-
     /* Set up directory traversal. */
     image_viso_log(viso->tf.log, "Traversing directories:\n");
     viso_entry_t        *entry;
@@ -859,6 +1197,7 @@ viso_init(const uint8_t id, const char *dirname, int *error)
     if (!dir)
         goto end;
     strcpy(dir->path, dirname);
+    viso->cache_time = time(NULL);
     if (stat(dirname, &dir->stats) != 0) {
         /* Use a blank structure if stat failed. */
         memset(&dir->stats, 0x00, sizeof(stat_t));
@@ -868,10 +1207,28 @@ viso_init(const uint8_t id, const char *dirname, int *error)
     dir->parent = dir; /* for the root's path table and .. entries */
     image_viso_log(viso->tf.log, "[%08X] %s => [root]\n", dir, dir->path);
 
+    /* Reuse the metadata from the last time if nothing changed. */
+    if (viso_cache_load(viso, dirname)) {
+        *error = 0;
+        goto end;
+    }
+
+    /* Open temporary file. */
+#ifdef ENABLE_IMAGE_VISO_LOG
+    strcpy(viso->tf.fn, "viso-debug.iso");
+#else
+    plat_tempfile(viso->tf.fn, "viso", ".tmp");
+#endif
+    viso->tf.fp = plat_fopen64(nvr_path(viso->tf.fn), "w+b");
+    if (!viso->tf.fp)
+        goto end;
+
     /* Traverse directories, starting with the root. */
     viso_entry_t **dir_entries     = NULL;
     size_t         dir_entries_len = 0;
     while (dir) {
+        viso_cache_add_dir(viso, dir);
+
         /* Open directory for listing. */
         DIR *dirp = opendir(dir->path);
 
@@ -1610,6 +1967,10 @@ next_entry:
     remove(nvr_path(viso->tf.fn));
 #endif
 
+    /* Save the metadata for the next time. */
+    viso_cache_save(viso, dirname);
+    viso_cache_free_dirs(viso);
+
     /* All good. */
     *error = 0;
 
@@ -1619,6 +1980,8 @@ end:
     if (!*error) {
         image_viso_log(viso->tf.log, "Initialized\n");
 
+        free(data);
+
         viso->tf.read       = viso_read;
         viso->tf.get_length = viso_get_length;
         viso->tf.close      = viso_close;
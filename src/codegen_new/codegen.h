@@ -4,6 +4,7 @@
 #include <86box/mem.h>
 #include <stddef.h>
 #include "x86_ops.h"
+#include "codegen_public.h"
 
 /*Handling self-modifying code (of which there is a lot on x86) :
 
@@ -40,8 +41,9 @@ typedef struct codeblock_t {
     uint8_t  TOP;
 
     /*Pointers for codeblock tree, used to search for blocks when hash lookup
-      fails.*/
+      fails. The tree is kept height-balanced (AVL).*/
     uint16_t parent, left, right;
+    uint8_t  height;
 
     uint8_t *data;
 
@@ -54,6 +56,10 @@ typedef struct codeblock_t {
     uint16_t prev, next;
     uint16_t prev_2, next_2;
 
+    /*Heads of the lists of chain links jumping into this block, and of
+      those patched into this block's own exits. See codegen_chain_link().*/
+    uint16_t chain_in, chain_out;
+
     /*First mem_block_t used by this block. Any subsequent mem_block_ts
       will be in the list starting at head_mem_block->next.*/
     struct mem_block_t *head_mem_block;
@@ -92,179 +98,128 @@ get_block_nr(codeblock_t *block)
     return ((uintptr_t) block - (uintptr_t) codeblock) / sizeof(codeblock_t);
 }
 
+/*True if block can be executed at the current CS:PC and CPU mode*/
+static inline int
+codeblock_is_valid(codeblock_t *block, uint32_t phys, uint32_t _cs, uint32_t pc)
+{
+    return (block->pc == pc) && (block->_cs == _cs) && (block->phys == phys) && !((block->status ^ cpu_cur_status) & CPU_STATUS_FLAGS) && ((block->status & cpu_cur_status & CPU_STATUS_MASK) == (cpu_cur_status & CPU_STATUS_MASK));
+}
+
+/*The code block hash is set-associative. Each set holds up to HASH_WAYS blocks
+  for the same HASH(phys), most recently used first, and entries are tagged
+  by the full (phys, CS, status) of the block. Blocks for the same code run
+  with different CS bases or CPU modes therefore no longer evict each other.*/
+#define HASH_WAYS   4
+#define HASH_SET(l) (&codeblock_hash[HASH(l) * HASH_WAYS])
+
 static inline codeblock_t *
-codeblock_tree_find(uint32_t phys, uint32_t _cs)
+codeblock_hash_find(uint16_t *set, uint32_t phys, uint32_t _cs, uint32_t pc)
 {
-    codeblock_t *block;
-    uint64_t     a = _cs | ((uint64_t) phys << 32);
-
-    if (!pages[phys >> 12].head)
-        return NULL;
-
-    block = &codeblock[pages[phys >> 12].head];
-    while (block) {
-        uint64_t block_cmp = block->_cs | ((uint64_t) block->phys << 32);
-        if (a == block_cmp) {
-            if (!((block->status ^ cpu_cur_status) & CPU_STATUS_FLAGS) && ((block->status & cpu_cur_status & CPU_STATUS_MASK) == (cpu_cur_status & CPU_STATUS_MASK)))
-                break;
+    for (int c = 0; c < HASH_WAYS; c++) {
+        codeblock_t *block;
+        uint16_t     block_nr = set[c];
+
+        if (!block_nr)
+            continue;
+
+        codegen_stats.probes++;
+        block = &codeblock[block_nr];
+        if (codeblock_is_valid(block, phys, _cs, pc)) {
+            /*Move to the front of the set*/
+            for (; c > 0; c--)
+                set[c] = set[c - 1];
+            set[0] = block_nr;
+            codegen_stats.hash_hits++;
+            return block;
         }
-        if (a < block_cmp)
-            block = block->left ? &codeblock[block->left] : NULL;
-        else
-            block = block->right ? &codeblock[block->right] : NULL;
     }
 
-    return block;
+    return NULL;
 }
 
-static inline void
-codeblock_tree_add(codeblock_t *new_block)
+/*Key used to order blocks in the per-page tree. Blocks with the same key
+  (same CS and physical address, different status) are ordered by block
+  number, and are adjacent in tree order.*/
+static inline uint64_t
+codeblock_tree_key(codeblock_t *block)
 {
-    codeblock_t *block = &codeblock[pages[new_block->phys >> 12].head];
-    uint64_t     a     = new_block->_cs | ((uint64_t) new_block->phys << 32);
-
-    if (!pages[new_block->phys >> 12].head) {
-        pages[new_block->phys >> 12].head = get_block_nr(new_block);
-        new_block->parent = new_block->left = new_block->right = BLOCK_INVALID;
-    } else {
-        codeblock_t *old_block     = NULL;
-        uint64_t     old_block_cmp = 0;
-
-        while (block) {
-            old_block     = block;
-            old_block_cmp = old_block->_cs | ((uint64_t) old_block->phys << 32);
-
-            if (a < old_block_cmp)
-                block = block->left ? &codeblock[block->left] : NULL;
-            else
-                block = block->right ? &codeblock[block->right] : NULL;
-        }
-
-        if (old_block != NULL) {
-            if (a < old_block_cmp)
-                old_block->left = get_block_nr(new_block);
-            else
-                old_block->right = get_block_nr(new_block);
-
-            new_block->parent = get_block_nr(old_block);
-        } else
-            new_block->parent = BLOCK_INVALID;
-
-        new_block->left = new_block->right = BLOCK_INVALID;
-    }
+    return block->_cs | ((uint64_t) block->phys << 32);
 }
 
-static inline void
-codeblock_tree_delete(codeblock_t *block)
+static inline codeblock_t *
+codeblock_tree_find(uint32_t phys, uint32_t _cs)
 {
-    uint16_t     parent_nr = block->parent;
-    codeblock_t *parent;
-
-    if (block->parent)
-        parent = &codeblock[block->parent];
-    else
-        parent = NULL;
-
-    if (!block->left && !block->right) {
-        /*Easy case - remove from parent*/
-        if (!parent)
-            pages[block->phys >> 12].head = BLOCK_INVALID;
-        else {
-            uint16_t block_nr = get_block_nr(block);
-
-            if (parent->left == block_nr)
-                parent->left = BLOCK_INVALID;
-            if (parent->right == block_nr)
-                parent->right = BLOCK_INVALID;
-        }
-        return;
-    } else if (!block->left) {
-        /*Only right node*/
-        if (!parent_nr) {
-            pages[block->phys >> 12].head                   = block->right;
-            codeblock[pages[block->phys >> 12].head].parent = BLOCK_INVALID;
-        } else {
-            uint16_t block_nr = get_block_nr(block);
+    uint64_t a        = _cs | ((uint64_t) phys << 32);
+    uint16_t block_nr = pages[phys >> 12].head;
+    uint16_t first_nr = BLOCK_INVALID;
+
+    /*Find the first block with a key not below the one searched for*/
+    while (block_nr) {
+        codeblock_t *block = &codeblock[block_nr];
+
+        codegen_stats.probes++;
+        if (a <= codeblock_tree_key(block)) {
+            first_nr = block_nr;
+            block_nr = block->left;
+        } else
+            block_nr = block->right;
+    }
 
-            if (parent->left == block_nr) {
-                parent->left                   = block->right;
-                codeblock[parent->left].parent = parent_nr;
-            }
-            if (parent->right == block_nr) {
-                parent->right                   = block->right;
-                codeblock[parent->right].parent = parent_nr;
-            }
-        }
-        return;
-    } else if (!block->right) {
-        /*Only left node*/
-        if (!parent_nr) {
-            pages[block->phys >> 12].head                   = block->left;
-            codeblock[pages[block->phys >> 12].head].parent = BLOCK_INVALID;
+    /*Walk the blocks with an equal key in order, checking their status*/
+    block_nr = first_nr;
+    while (block_nr) {
+        codeblock_t *block = &codeblock[block_nr];
+
+        if (codeblock_tree_key(block) != a)
+            break;
+        if (!((block->status ^ cpu_cur_status) & CPU_STATUS_FLAGS) && ((block->status & cpu_cur_status & CPU_STATUS_MASK) == (cpu_cur_status & CPU_STATUS_MASK)))
+            return block;
+
+        codegen_stats.probes++;
+        if (block->right) {
+            block_nr = block->right;
+            while (codeblock[block_nr].left)
+                block_nr = codeblock[block_nr].left;
         } else {
-            uint16_t block_nr = get_block_nr(block);
-
-            if (parent->left == block_nr) {
-                parent->left                   = block->left;
-                codeblock[parent->left].parent = parent_nr;
-            }
-            if (parent->right == block_nr) {
-                parent->right                   = block->left;
-                codeblock[parent->right].parent = parent_nr;
+            while (block->parent && (codeblock[block->parent].right == block_nr)) {
+                block_nr = block->parent;
+                block    = &codeblock[block_nr];
             }
-        }
-        return;
-    } else {
-        /*Difficult case - node has two children. Walk right child to find lowest node*/
-        codeblock_t *lowest = &codeblock[block->right];
-        codeblock_t *highest;
-        codeblock_t *old_parent;
-        uint16_t     lowest_nr;
-
-        while (lowest->left)
-            lowest = &codeblock[lowest->left];
-        lowest_nr = get_block_nr(lowest);
-
-        old_parent = &codeblock[lowest->parent];
-
-        /*Replace deleted node with lowest node*/
-        if (!parent_nr)
-            pages[block->phys >> 12].head = lowest_nr;
-        else {
-            uint16_t block_nr = get_block_nr(block);
-
-            if (parent->left == block_nr)
-                parent->left = lowest_nr;
-            if (parent->right == block_nr)
-                parent->right = lowest_nr;
-        }
-
-        lowest->parent = parent_nr;
-        lowest->left   = block->left;
-        if (lowest->left)
-            codeblock[lowest->left].parent = lowest_nr;
-
-        old_parent->left = BLOCK_INVALID;
-
-        highest = &codeblock[lowest->right];
-        if (!lowest->right) {
-            if (lowest_nr != block->right) {
-                lowest->right                  = block->right;
-                codeblock[block->right].parent = lowest_nr;
-            }
-            return;
-        }
-
-        while (highest->right)
-            highest = &codeblock[highest->right];
-
-        if (block->right && block->right != lowest_nr) {
-            highest->right                 = block->right;
-            codeblock[block->right].parent = get_block_nr(highest);
+            block_nr = block->parent;
         }
     }
+
+    return NULL;
 }
 
+extern void codeblock_hash_insert(codeblock_t *block);
+extern void codeblock_hash_remove(codeblock_t *block);
+extern void codeblock_tree_add(codeblock_t *new_block);
+extern void codeblock_tree_delete(codeblock_t *block);
+
+/*Block chaining. A branch out of a block to a constant address ends in a chain
+  exit (uop_JMP_CHAIN). While unlinked, the exit reports itself through
+  codegen_chain_exit() and returns to the dispatcher. When the dispatcher next
+  runs a recompiled block at the address the exit stored in PC, and that block
+  lies in the same page as the one that exited, codegen_chain_link() patches
+  the exit to go to codegen_chain_next() with that block instead.
+  codegen_chain_next() repeats the cycle, timer, interrupt and block checks the
+  dispatcher loop would make and then jumps to the block directly, or leaves
+  for the dispatcher if any of them fail.
+
+  Links are kept on per-block lists, and are removed by codegen_chain_unlink()
+  whenever the code of either block is freed or recompiled.*/
+extern int      codegen_chain_entry_pos; /*Offset of the chained entry point in a block's code, past the register saves*/
+extern uint16_t codegen_chain_block;     /*Block currently running*/
+extern int32_t  codegen_chain_cycles;    /*Value of cycles when the dispatcher entered the first block*/
+extern uint64_t codegen_chain_tsc;       /*Value of tsc when the dispatcher entered the first block*/
+extern int      codegen_chain_mmuflush;  /*Value of mmuflush when the dispatcher entered the first block*/
+
+extern void  codegen_chain_exit(uint8_t *exit);
+extern void *codegen_chain_next(codeblock_t *block);
+extern void  codegen_chain_link(codeblock_t *block);
+extern void  codegen_chain_unlink(codeblock_t *block);
+
 #define PAGE_MASK_MASK  63
 #define PAGE_MASK_SHIFT 6
 
@@ -12,6 +12,8 @@
 void codegen_backend_init(void);
 void codegen_backend_prologue(codeblock_t *block);
 void codegen_backend_epilogue(codeblock_t *block);
+/*Point a chain exit at dest, or back at the dispatcher if dest is NULL*/
+void codegen_backend_chain_patch(uint8_t *exit, codeblock_t *dest);
 
 struct ir_data_t;
 struct uop_t;
@@ -26,6 +26,9 @@
 #        include <windows.h>
 #    endif
 #    include <string.h>
+#    if defined(__APPLE__) && defined(__aarch64__)
+#        include <pthread.h>
+#    endif
 
 void *codegen_mem_load_byte;
 void *codegen_mem_load_word;
@@ -46,6 +49,8 @@ void *codegen_fp_round_quad;
 
 void *codegen_gpf_rout;
 void *codegen_exit_rout;
+void *codegen_chain_rout;
+void *codegen_chain_exit_rout;
 
 host_reg_def_t codegen_host_reg_list[CODEGEN_HOST_REGS] = {
     { REG_X19, 0},
@@ -286,7 +291,7 @@ codegen_backend_init(void)
     codeblock_t *block;
 
     codeblock      = calloc(BLOCK_SIZE, sizeof(codeblock_t));
-    codeblock_hash = calloc(HASH_SIZE, sizeof(codeblock_t *));
+    codeblock_hash = calloc(HASH_SIZE * HASH_WAYS, sizeof(uint16_t));
 
     for (int c = 0; c < BLOCK_SIZE; c++) {
         codeblock[c].pc = BLOCK_PC_INVALID;
@@ -320,6 +325,17 @@ codegen_backend_init(void)
     host_arm64_LDP_POSTIDX_X(block, REG_X29, REG_X30, REG_XSP, 16);
     host_arm64_RET(block, REG_X30);
 
+    /*Chain exits load the block to continue with (or, while unlinked, the
+      address of the exit itself) into X0 and branch here, see
+      codegen_backend_chain_patch()*/
+    codegen_alloc(block, 48);
+    codegen_chain_rout = &block_write_data[block_pos];
+    host_arm64_call(block, (void *) codegen_chain_next);
+    host_arm64_BR(block, REG_X0);
+    codegen_chain_exit_rout = &block_write_data[block_pos];
+    host_arm64_call(block, (void *) codegen_chain_exit);
+    host_arm64_B(block, codegen_exit_rout);
+
     block_write_data = NULL;
 
     codegen_allocator_clean_blocks(block->head_mem_block);
@@ -351,6 +367,8 @@ codegen_backend_prologue(codeblock_t *block)
     host_arm64_STP_PREIDX_X(block, REG_X21, REG_X22, REG_XSP, -16);
     host_arm64_STP_PREIDX_X(block, REG_X19, REG_X20, REG_XSP, -64);
 
+    /*Chained jumps enter here, keeping the stack frame of the first block*/
+    codegen_chain_entry_pos = block_pos;
     host_arm64_MOVX_IMM(block, REG_CPUSTATE, (uint64_t) &cpu_state);
 
     if (block->flags & CODEBLOCK_HAS_FPU) {
@@ -374,4 +392,26 @@ codegen_backend_epilogue(codeblock_t *block)
     codegen_allocator_clean_blocks(block->head_mem_block);
 }
 
+/*Chain exits are a fixed MOVZ/MOVK sequence loading X0 followed by B, as
+  emitted by codegen_JMP_CHAIN()*/
+void
+codegen_backend_chain_patch(uint8_t *exit, codeblock_t *dest)
+{
+#    if defined(__APPLE__) && defined(__aarch64__)
+    if (__builtin_available(macOS 11.0, *)) {
+        pthread_jit_write_protect_np(0);
+    }
+#    endif
+    host_arm64_MOVX_IMM_patch((uint32_t *) exit, REG_ARG0, dest ? (uintptr_t) dest : (uintptr_t) exit);
+    host_arm64_B_patch((uint32_t *) &exit[16], dest ? codegen_chain_rout : codegen_chain_exit_rout);
+#    if defined(__APPLE__) && defined(__aarch64__)
+    /*Code is being generated, which needs the memory to stay writable*/
+    if (__builtin_available(macOS 11.0, *)) {
+        if (!codegen_in_recompile)
+            pthread_jit_write_protect_np(1);
+    }
+#    endif
+    __clear_cache(exit, &exit[20]);
+}
+
 #endif
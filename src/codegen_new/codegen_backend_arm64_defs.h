@@ -133,3 +133,5 @@ extern void *codegen_fp_round_quad;
 
 extern void *codegen_gpf_rout;
 extern void *codegen_exit_rout;
+extern void *codegen_chain_rout;
+extern void *codegen_chain_exit_rout;
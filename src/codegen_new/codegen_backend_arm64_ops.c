@@ -453,6 +453,17 @@ host_arm64_B(codeblock_t *block, void *dest)
     codegen_addlong(block, OPCODE_B | OFFSET26(offset));
 }
 
+/*Rewrite the B at opcode to jump to dest*/
+void
+host_arm64_B_patch(uint32_t *opcode, void *dest)
+{
+    int offset = (uintptr_t) dest - (uintptr_t) opcode;
+
+    if (!offset_is_26bit(offset))
+        fatal("host_arm64_B_patch - offset out of range %x\n", offset);
+    *opcode = OPCODE_B | OFFSET26(offset);
+}
+
 void
 host_arm64_BFI(codeblock_t *block, int dst_reg, int src_reg, int lsb, int width)
 {
@@ -1078,6 +1089,24 @@ host_arm64_MOVX_IMM(codeblock_t *block, int reg, uint64_t imm_data)
     if ((imm_data >> 48) & 0xffff)
         codegen_addlong(block, OPCODE_MOVK_X | MOV_WIDE_HW(3) | IMM16((imm_data >> 48) & 0xffff) | Rd(reg));
 }
+/*Always four instructions, so that the immediate can be rewritten in place
+  with host_arm64_MOVX_IMM_patch()*/
+void
+host_arm64_MOVX_IMM_FIXED(codeblock_t *block, int reg, uint64_t imm_data)
+{
+    codegen_addlong(block, OPCODE_MOVZ_X | MOV_WIDE_HW(0) | IMM16(imm_data & 0xffff) | Rd(reg));
+    codegen_addlong(block, OPCODE_MOVK_X | MOV_WIDE_HW(1) | IMM16((imm_data >> 16) & 0xffff) | Rd(reg));
+    codegen_addlong(block, OPCODE_MOVK_X | MOV_WIDE_HW(2) | IMM16((imm_data >> 32) & 0xffff) | Rd(reg));
+    codegen_addlong(block, OPCODE_MOVK_X | MOV_WIDE_HW(3) | IMM16((imm_data >> 48) & 0xffff) | Rd(reg));
+}
+void
+host_arm64_MOVX_IMM_patch(uint32_t *opcode, int reg, uint64_t imm_data)
+{
+    opcode[0] = OPCODE_MOVZ_X | MOV_WIDE_HW(0) | IMM16(imm_data & 0xffff) | Rd(reg);
+    opcode[1] = OPCODE_MOVK_X | MOV_WIDE_HW(1) | IMM16((imm_data >> 16) & 0xffff) | Rd(reg);
+    opcode[2] = OPCODE_MOVK_X | MOV_WIDE_HW(2) | IMM16((imm_data >> 32) & 0xffff) | Rd(reg);
+    opcode[3] = OPCODE_MOVK_X | MOV_WIDE_HW(3) | IMM16((imm_data >> 48) & 0xffff) | Rd(reg);
+}
 void
 host_arm64_MOVX_REG(codeblock_t *block, int dst_reg, int src_m_reg, int shift)
 {
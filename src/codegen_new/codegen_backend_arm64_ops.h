@@ -21,6 +21,7 @@ void host_arm64_ANDS_IMM(codeblock_t *block, int dst_reg, int src_n_reg, uint32_
 void host_arm64_ASR(codeblock_t *block, int dst_reg, int src_n_reg, int shift_reg);
 
 void host_arm64_B(codeblock_t *block, void *dest);
+void host_arm64_B_patch(uint32_t *opcode, void *dest);
 
 void host_arm64_BFI(codeblock_t *block, int dst_reg, int src_reg, int lsb, int width);
 
@@ -151,6 +152,8 @@ void host_arm64_MOV_REG_LSR(codeblock_t *block, int dst_reg, int src_m_reg, int
 void host_arm64_MOV_REG_ROR(codeblock_t *block, int dst_reg, int src_m_reg, int shift);
 
 void host_arm64_MOVX_IMM(codeblock_t *block, int reg, uint64_t imm_data);
+void host_arm64_MOVX_IMM_FIXED(codeblock_t *block, int reg, uint64_t imm_data);
+void host_arm64_MOVX_IMM_patch(uint32_t *opcode, int reg, uint64_t imm_data);
 void host_arm64_MOVX_REG(codeblock_t *block, int dst_reg, int src_m_reg, int shift);
 
 void host_arm64_MOVZ_IMM(codeblock_t *block, int reg, uint32_t imm_data);
@@ -815,6 +815,21 @@ codegen_JMP(codeblock_t *block, uop_t *uop)
     return 0;
 }
 
+static int
+codegen_JMP_CHAIN(codeblock_t *block, UNUSED(uop_t *uop))
+{
+    if (cpu_dynarec_chaining) {
+        /*Keep the exit in one piece, codegen_backend_chain_patch() rewrites
+          both the immediate and the branch*/
+        codegen_alloc(block, 20);
+        host_arm64_MOVX_IMM_FIXED(block, REG_ARG0, (uintptr_t) &block_write_data[block_pos]);
+        host_arm64_B(block, codegen_chain_exit_rout);
+    } else
+        host_arm64_jump(block, (uintptr_t) codegen_exit_rout);
+
+    return 0;
+}
+
 static int
 codegen_LOAD_FUNC_ARG0(codeblock_t *block, uop_t *uop)
 {
@@ -2924,6 +2939,9 @@ const uOpFn uop_handlers[UOP_MAX] = {
     [UOP_JMP &
         UOP_MASK]
     = codegen_JMP,
+    [UOP_JMP_CHAIN &
+        UOP_MASK]
+    = codegen_JMP_CHAIN,
 
     [UOP_LOAD_SEG &
         UOP_MASK]
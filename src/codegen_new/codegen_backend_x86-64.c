@@ -5,12 +5,14 @@
 #    include <86box/86box.h>
 #    include "cpu.h"
 #    include <86box/mem.h>
+#    include <86box/plat_unused.h>
 
 #    include "codegen.h"
 #    include "codegen_allocator.h"
 #    include "codegen_backend.h"
 #    include "codegen_backend_x86-64_defs.h"
 #    include "codegen_backend_x86-64_ops.h"
+#    include "codegen_backend_x86-64_ops_helpers.h"
 #    include "codegen_backend_x86-64_ops_sse.h"
 #    include "codegen_reg.h"
 #    include "x86.h"
@@ -42,6 +44,8 @@ void *codegen_mem_store_double;
 
 void *codegen_gpf_rout;
 void *codegen_exit_rout;
+void *codegen_chain_rout;
+void *codegen_chain_exit_rout;
 
 host_reg_def_t codegen_host_reg_list[CODEGEN_HOST_REGS] = {
   /*Note: while EAX and EDX are normally volatile registers under x86
@@ -289,7 +293,7 @@ codegen_backend_init(void)
     int          c;
 
     codeblock      = calloc(BLOCK_SIZE, sizeof(codeblock_t));
-    codeblock_hash = calloc(HASH_SIZE, sizeof(codeblock_t *));
+    codeblock_hash = calloc(HASH_SIZE * HASH_WAYS, sizeof(uint16_t));
 
     for (c = 0; c < BLOCK_SIZE; c++)
         codeblock[c].pc = BLOCK_PC_INVALID;
@@ -329,6 +333,17 @@ codegen_backend_init(void)
     host_x86_POP(block, REG_RBX);
     host_x86_RET(block);
 
+    /*Chain exits load the block to continue with (or, while unlinked, the
+      address of the exit itself) into the first argument register and jump
+      here, see codegen_backend_chain_patch()*/
+    codegen_alloc_bytes(block, 32);
+    codegen_chain_rout = &block_write_data[block_pos];
+    host_x86_CALL(block, (void *) codegen_chain_next);
+    host_x86_JMP_REG(block, REG_RAX);
+    codegen_chain_exit_rout = &block_write_data[block_pos];
+    host_x86_CALL(block, (void *) codegen_chain_exit);
+    host_x86_JMP(block, codegen_exit_rout);
+
     block_write_data = NULL;
 
     asm(
@@ -362,6 +377,8 @@ codegen_backend_prologue(codeblock_t *block)
 #else
     host_x86_SUB64_REG_IMM(block, REG_RSP, 0x48);
 #endif
+    /*Chained jumps enter here, keeping the stack frame of the first block*/
+    codegen_chain_entry_pos = block_pos;
     host_x86_MOV64_REG_IMM(block, REG_RBP, ((uintptr_t) &cpu_state) + 128);
     if (block->flags & CODEBLOCK_HAS_FPU) {
         host_x86_MOV32_REG_ABS(block, REG_EAX, &cpu_state.TOP);
@@ -392,4 +409,15 @@ codegen_backend_epilogue(codeblock_t *block)
     host_x86_POP(block, REG_RBX);
     host_x86_RET(block);
 }
+
+/*Chain exits are MOV arg0, imm64 followed by JMP rel32, as emitted by
+  codegen_JMP_CHAIN()*/
+void
+codegen_backend_chain_patch(uint8_t *exit, codeblock_t *dest)
+{
+    void *rout = dest ? codegen_chain_rout : codegen_chain_exit_rout;
+
+    *(uint64_t *) &exit[2]  = dest ? (uintptr_t) dest : (uintptr_t) exit;
+    *(uint32_t *) &exit[11] = (uintptr_t) rout - (uintptr_t) &exit[15];
+}
 #endif
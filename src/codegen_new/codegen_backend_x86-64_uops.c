@@ -13,9 +13,11 @@
 #    include "x87.h"
 #    include "386_common.h"
 #    include "codegen.h"
+#    include "codegen_allocator.h"
 #    include "codegen_backend.h"
 #    include "codegen_backend_x86-64_defs.h"
 #    include "codegen_backend_x86-64_ops.h"
+#    include "codegen_backend_x86-64_ops_helpers.h"
 #    include "codegen_backend_x86-64_ops_sse.h"
 #    include "codegen_ir_defs.h"
 
@@ -858,6 +860,25 @@ codegen_JMP(codeblock_t *block, uop_t *uop)
     return 0;
 }
 
+static int
+codegen_JMP_CHAIN(codeblock_t *block, UNUSED(uop_t *uop))
+{
+    if (cpu_dynarec_chaining) {
+        /*Keep the exit in one piece, codegen_backend_chain_patch() rewrites
+          both the immediate and the jump*/
+        codegen_alloc_bytes(block, 15);
+#    if _WIN64
+        host_x86_MOV64_REG_IMM(block, REG_RCX, (uintptr_t) &block_write_data[block_pos]);
+#    else
+        host_x86_MOV64_REG_IMM(block, REG_RDI, (uintptr_t) &block_write_data[block_pos]);
+#    endif
+        host_x86_JMP(block, codegen_chain_exit_rout);
+    } else
+        host_x86_JMP(block, codegen_exit_rout);
+
+    return 0;
+}
+
 static int
 codegen_LOAD_FUNC_ARG0(codeblock_t *block, uop_t *uop)
 {
@@ -2880,6 +2901,9 @@ const uOpFn uop_handlers[UOP_MAX] = {
     [UOP_JMP &
         UOP_MASK]
     = codegen_JMP,
+    [UOP_JMP_CHAIN &
+        UOP_MASK]
+    = codegen_JMP_CHAIN,
 
     [UOP_LOAD_SEG &
         UOP_MASK]
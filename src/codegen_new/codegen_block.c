@@ -39,9 +39,8 @@ uint32_t op_old_pc;
 
 uint32_t recomp_page = -1;
 
-int        block_current = 0;
-static int block_num;
-int        block_pos;
+int block_current = 0;
+int block_pos;
 
 uint32_t codegen_endpc;
 
@@ -61,6 +60,32 @@ static uint16_t block_free_list;
 static void     delete_block(codeblock_t *block);
 static void     delete_dirty_block(codeblock_t *block);
 
+/*Chain links. Each link is on the chain_out list of the block whose exit was
+  patched, and on the chain_in list of the block the exit now jumps to. Link 0
+  is never used, so that 0 can end the lists as BLOCK_INVALID does for blocks.*/
+#define CHAIN_LINK_SIZE 0x8000
+
+typedef struct chain_link_t {
+    uint8_t *exit;
+    uint16_t from, to;
+    uint16_t prev_out, next_out;
+    uint16_t prev_in, next_in;
+} chain_link_t;
+
+static chain_link_t chain_links[CHAIN_LINK_SIZE];
+static uint16_t     chain_link_free_list;
+
+/*Unlinked exit the last block returned to the dispatcher through*/
+static uint8_t *chain_exit;
+static uint16_t chain_exit_block;
+static uint32_t chain_exit_pc;
+
+int      codegen_chain_entry_pos;
+uint16_t codegen_chain_block;
+int32_t  codegen_chain_cycles;
+uint64_t codegen_chain_tsc;
+int      codegen_chain_mmuflush;
+
 /*Temporary list of code blocks that have recently been evicted. This allows for
   some historical state to be kept when a block is the target of self-modifying
   code.
@@ -214,6 +239,109 @@ block_free_list_get(void)
     return block;
 }
 
+static void
+chain_reset(void)
+{
+    chain_link_free_list = BLOCK_INVALID;
+    for (int c = CHAIN_LINK_SIZE - 1; c > 0; c--) {
+        chain_links[c].next_out = chain_link_free_list;
+        chain_link_free_list    = c;
+    }
+    chain_exit_block = BLOCK_INVALID;
+}
+
+static void
+chain_link_remove(uint16_t link_nr)
+{
+    chain_link_t *link = &chain_links[link_nr];
+
+    if (link->prev_out)
+        chain_links[link->prev_out].next_out = link->next_out;
+    else
+        codeblock[link->from].chain_out = link->next_out;
+    if (link->next_out)
+        chain_links[link->next_out].prev_out = link->prev_out;
+
+    if (link->prev_in)
+        chain_links[link->prev_in].next_in = link->next_in;
+    else
+        codeblock[link->to].chain_in = link->next_in;
+    if (link->next_in)
+        chain_links[link->next_in].prev_in = link->prev_in;
+
+    link->next_out       = chain_link_free_list;
+    chain_link_free_list = link_nr;
+}
+
+/*Called by an unlinked chain exit on its way back to the dispatcher*/
+void
+codegen_chain_exit(uint8_t *exit)
+{
+    chain_exit       = exit;
+    chain_exit_block = codegen_chain_block;
+    chain_exit_pc    = cs + cpu_state.pc;
+}
+
+/*Called by the dispatcher before running block. If the previous block left
+  through an unlinked chain exit to this block, patch the exit to jump here.*/
+void
+codegen_chain_link(codeblock_t *block)
+{
+    codeblock_t  *from = &codeblock[chain_exit_block];
+    chain_link_t *link;
+    uint16_t      link_nr;
+
+    if (!chain_exit_block)
+        return;
+    chain_exit_block = BLOCK_INVALID;
+
+    /*Only link blocks in the same page, so that the page translation checked
+      by the dispatcher for the first block holds for all blocks chained from
+      it, and only to blocks that do not continue into another page, as that
+      page would have to be checked as well.*/
+    if ((block->pc != chain_exit_pc) || block->page_mask2 || ((block->pc ^ from->pc) & ~0xfff) || ((block->phys ^ from->phys) & ~0xfff))
+        return;
+    if (!chain_link_free_list)
+        return;
+
+    link_nr              = chain_link_free_list;
+    link                 = &chain_links[link_nr];
+    chain_link_free_list = link->next_out;
+
+    link->exit     = chain_exit;
+    link->from     = get_block_nr(from);
+    link->to       = get_block_nr(block);
+    link->prev_out = BLOCK_INVALID;
+    link->next_out = from->chain_out;
+    if (from->chain_out)
+        chain_links[from->chain_out].prev_out = link_nr;
+    from->chain_out = link_nr;
+    link->prev_in   = BLOCK_INVALID;
+    link->next_in   = block->chain_in;
+    if (block->chain_in)
+        chain_links[block->chain_in].prev_in = link_nr;
+    block->chain_in = link_nr;
+
+    codegen_backend_chain_patch(link->exit, block);
+    codegen_stats.chain_links++;
+}
+
+/*Remove all chain links into and out of block, before its code is freed or
+  recompiled*/
+void
+codegen_chain_unlink(codeblock_t *block)
+{
+    if (chain_exit_block == get_block_nr(block))
+        chain_exit_block = BLOCK_INVALID;
+
+    while (block->chain_in) {
+        codegen_backend_chain_patch(chain_links[block->chain_in].exit, NULL);
+        chain_link_remove(block->chain_in);
+    }
+    while (block->chain_out)
+        chain_link_remove(block->chain_out);
+}
+
 void
 codegen_init(void)
 {
@@ -226,6 +354,7 @@ codegen_init(void)
         block_free_list_add(&codeblock[c]);
     block_dirty_list_head = block_dirty_list_tail = 0;
     dirty_list_size                               = 0;
+    chain_reset();
 #ifdef DEBUG_EXTRA
     memset(instr_counts, 0, sizeof(instr_counts));
 #endif
@@ -247,8 +376,9 @@ codegen_reset(void)
     }
 
     memset(codeblock, 0, BLOCK_SIZE * sizeof(codeblock_t));
-    memset(codeblock_hash, 0, HASH_SIZE * sizeof(uint16_t));
+    memset(codeblock_hash, 0, HASH_SIZE * HASH_WAYS * sizeof(uint16_t));
     mem_reset_page_blocks();
+    chain_reset();
 
     block_free_list = 0;
     for (c = 0; c < BLOCK_SIZE; c++) {
@@ -366,6 +496,217 @@ remove_from_block_list(codeblock_t *block, UNUSED(uint32_t pc))
     }
 }
 
+void
+codeblock_hash_insert(codeblock_t *block)
+{
+    uint16_t *set      = HASH_SET(block->phys);
+    uint16_t  block_nr = get_block_nr(block);
+    int       c;
+
+    /*Insert at the front of the set, evicting the least recently used entry
+      if the block is not already present*/
+    for (c = 0; c < (HASH_WAYS - 1); c++) {
+        if (set[c] == block_nr)
+            break;
+    }
+    for (; c > 0; c--)
+        set[c] = set[c - 1];
+    set[0] = block_nr;
+}
+
+void
+codeblock_hash_remove(codeblock_t *block)
+{
+    uint16_t *set      = HASH_SET(block->phys);
+    uint16_t  block_nr = get_block_nr(block);
+
+    for (int c = 0; c < HASH_WAYS; c++) {
+        if (set[c] == block_nr)
+            set[c] = BLOCK_INVALID;
+    }
+}
+
+static inline int
+codeblock_tree_height(uint16_t block_nr)
+{
+    return block_nr ? codeblock[block_nr].height : 0;
+}
+
+static inline void
+codeblock_tree_update_height(codeblock_t *block)
+{
+    int left  = codeblock_tree_height(block->left);
+    int right = codeblock_tree_height(block->right);
+
+    block->height = ((left > right) ? left : right) + 1;
+}
+
+/*True if block a comes before block b in tree order*/
+static inline int
+codeblock_tree_less(codeblock_t *a, codeblock_t *b)
+{
+    uint64_t a_key = codeblock_tree_key(a);
+    uint64_t b_key = codeblock_tree_key(b);
+
+    if (a_key != b_key)
+        return a_key < b_key;
+
+    return get_block_nr(a) < get_block_nr(b);
+}
+
+/*Make new_nr take the place of old_nr as a child of parent_nr, or as the root
+  of the tree for page if parent_nr is BLOCK_INVALID*/
+static void
+codeblock_tree_replace_child(uint32_t phys, uint16_t parent_nr, uint16_t old_nr, uint16_t new_nr)
+{
+    if (!parent_nr)
+        pages[phys >> 12].head = new_nr;
+    else if (codeblock[parent_nr].left == old_nr)
+        codeblock[parent_nr].left = new_nr;
+    else
+        codeblock[parent_nr].right = new_nr;
+
+    if (new_nr)
+        codeblock[new_nr].parent = parent_nr;
+}
+
+static uint16_t
+codeblock_tree_rotate_left(uint16_t block_nr)
+{
+    codeblock_t *block    = &codeblock[block_nr];
+    uint16_t     pivot_nr = block->right;
+    codeblock_t *pivot    = &codeblock[pivot_nr];
+
+    codeblock_tree_replace_child(block->phys, block->parent, block_nr, pivot_nr);
+
+    block->right = pivot->left;
+    if (block->right)
+        codeblock[block->right].parent = block_nr;
+    pivot->left   = block_nr;
+    block->parent = pivot_nr;
+
+    codeblock_tree_update_height(block);
+    codeblock_tree_update_height(pivot);
+
+    return pivot_nr;
+}
+
+static uint16_t
+codeblock_tree_rotate_right(uint16_t block_nr)
+{
+    codeblock_t *block    = &codeblock[block_nr];
+    uint16_t     pivot_nr = block->left;
+    codeblock_t *pivot    = &codeblock[pivot_nr];
+
+    codeblock_tree_replace_child(block->phys, block->parent, block_nr, pivot_nr);
+
+    block->left = pivot->right;
+    if (block->left)
+        codeblock[block->left].parent = block_nr;
+    pivot->right  = block_nr;
+    block->parent = pivot_nr;
+
+    codeblock_tree_update_height(block);
+    codeblock_tree_update_height(pivot);
+
+    return pivot_nr;
+}
+
+/*Walk from block_nr up to the root, restoring the AVL balance*/
+static void
+codeblock_tree_rebalance(uint16_t block_nr)
+{
+    while (block_nr) {
+        codeblock_t *block   = &codeblock[block_nr];
+        int          balance = codeblock_tree_height(block->left) - codeblock_tree_height(block->right);
+
+        if (balance > 1) {
+            codeblock_t *left = &codeblock[block->left];
+
+            if (codeblock_tree_height(left->left) < codeblock_tree_height(left->right))
+                codeblock_tree_rotate_left(block->left);
+            block_nr = codeblock_tree_rotate_right(block_nr);
+        } else if (balance < -1) {
+            codeblock_t *right = &codeblock[block->right];
+
+            if (codeblock_tree_height(right->right) < codeblock_tree_height(right->left))
+                codeblock_tree_rotate_right(block->right);
+            block_nr = codeblock_tree_rotate_left(block_nr);
+        } else
+            codeblock_tree_update_height(block);
+
+        block_nr = codeblock[block_nr].parent;
+    }
+}
+
+void
+codeblock_tree_add(codeblock_t *new_block)
+{
+    uint16_t new_nr    = get_block_nr(new_block);
+    uint16_t block_nr  = pages[new_block->phys >> 12].head;
+    uint16_t parent_nr = BLOCK_INVALID;
+
+    new_block->left = new_block->right = BLOCK_INVALID;
+    new_block->height                  = 1;
+
+    while (block_nr) {
+        parent_nr = block_nr;
+
+        if (codeblock_tree_less(new_block, &codeblock[block_nr]))
+            block_nr = codeblock[block_nr].left;
+        else
+            block_nr = codeblock[block_nr].right;
+    }
+
+    new_block->parent = parent_nr;
+    if (!parent_nr)
+        pages[new_block->phys >> 12].head = new_nr;
+    else if (codeblock_tree_less(new_block, &codeblock[parent_nr]))
+        codeblock[parent_nr].left = new_nr;
+    else
+        codeblock[parent_nr].right = new_nr;
+
+    codeblock_tree_rebalance(parent_nr);
+}
+
+void
+codeblock_tree_delete(codeblock_t *block)
+{
+    uint16_t block_nr = get_block_nr(block);
+    uint16_t rebalance_nr;
+
+    if (!block->left || !block->right) {
+        /*At most one child - replace block with it*/
+        rebalance_nr = block->parent;
+        codeblock_tree_replace_child(block->phys, block->parent, block_nr, block->left ? block->left : block->right);
+    } else {
+        /*Two children - replace block with the lowest node of its right subtree*/
+        uint16_t     lowest_nr = block->right;
+        codeblock_t *lowest;
+
+        while (codeblock[lowest_nr].left)
+            lowest_nr = codeblock[lowest_nr].left;
+        lowest = &codeblock[lowest_nr];
+
+        if (lowest_nr == block->right)
+            rebalance_nr = lowest_nr;
+        else {
+            rebalance_nr = lowest->parent;
+            codeblock_tree_replace_child(block->phys, lowest->parent, lowest_nr, lowest->right);
+            lowest->right                   = block->right;
+            codeblock[lowest->right].parent = lowest_nr;
+        }
+
+        lowest->left                   = block->left;
+        codeblock[lowest->left].parent = lowest_nr;
+        lowest->height                 = block->height;
+        codeblock_tree_replace_child(block->phys, block->parent, block_nr, lowest_nr);
+    }
+
+    block->parent = block->left = block->right = BLOCK_INVALID;
+    codeblock_tree_rebalance(rebalance_nr);
+}
+
 static void
 invalidate_block(codeblock_t *block)
 {
@@ -379,6 +720,7 @@ invalidate_block(codeblock_t *block)
 #endif
     remove_from_block_list(block, old_pc);
     block_dirty_list_add(block);
+    codegen_chain_unlink(block);
     if (block->head_mem_block)
         codegen_allocator_free(block->head_mem_block);
     block->head_mem_block = NULL;
@@ -389,8 +731,7 @@ delete_block(codeblock_t *block)
 {
     uint32_t old_pc = block->pc;
 
-    if (block == &codeblock[codeblock_hash[HASH(block->phys)]])
-        codeblock_hash[HASH(block->phys)] = BLOCK_INVALID;
+    codeblock_hash_remove(block);
 
 #ifndef RELEASE_BUILD
     if (block->pc == BLOCK_PC_INVALID)
@@ -403,6 +744,7 @@ delete_block(codeblock_t *block)
         block_dirty_list_remove(block);
     else
         remove_from_block_list(block, old_pc);
+    codegen_chain_unlink(block);
     if (block->head_mem_block)
         codegen_allocator_free(block->head_mem_block);
     block->head_mem_block = NULL;
@@ -412,8 +754,7 @@ delete_block(codeblock_t *block)
 static void
 delete_dirty_block(codeblock_t *block)
 {
-    if (block == &codeblock[codeblock_hash[HASH(block->phys)]])
-        codeblock_hash[HASH(block->phys)] = BLOCK_INVALID;
+    codeblock_hash_remove(block);
 
 #ifndef RELEASE_BUILD
     if (block->pc == BLOCK_PC_INVALID)
@@ -516,9 +857,6 @@ codegen_block_init(uint32_t phys_addr)
 #endif
     block_current = get_block_nr(block);
 
-    block_num                 = HASH(phys_addr);
-    codeblock_hash[block_num] = block_current;
-
     block->ins         = 0;
     block->pc          = cs + cpu_state.pc;
     block->_cs         = cs;
@@ -532,6 +870,7 @@ codegen_block_init(uint32_t phys_addr)
     block->status                        = cpu_cur_status;
 
     recomp_page = block->phys & ~0xfff;
+    codeblock_hash_insert(block);
     codeblock_tree_add(block);
 }
 
@@ -551,7 +890,6 @@ codegen_block_start_recompile(codeblock_t *block)
     if (!page->block)
         mem_flush_write_page(block->phys, cs + cpu_state.pc);
 
-    block_num     = HASH(block->phys);
     block_current = get_block_nr(block); // block->pnt;
 
 #ifndef RELEASE_BUILD
@@ -559,6 +897,7 @@ codegen_block_start_recompile(codeblock_t *block)
         fatal("Recompile to used block!\n");
 #endif
 
+    codegen_chain_unlink(block);
     if (block->head_mem_block) {
         codegen_allocator_free(block->head_mem_block);
         block->head_mem_block = NULL;
@@ -87,6 +87,7 @@
 #include <86box/path.h>
 #include <86box/plat.h>
 #include <86box/plat_dir.h>
+#include <86box/profile.h>
 #include <86box/ui.h>
 #include <86box/snd_opl.h>
 #include <86box/version.h>
@@ -221,6 +222,15 @@ load_general(void)
 
     force_10ms = !!ini_section_get_int(cat, "force_10ms", 0);
 
+    timer_scheduler = ini_section_get_int(cat, "timer_scheduler", TIMER_SCHED_LIST);
+    if ((timer_scheduler != TIMER_SCHED_LIST) && (timer_scheduler != TIMER_SCHED_HEAP))
+        timer_scheduler = TIMER_SCHED_LIST;
+
+    profile_set(!!ini_section_get_int(cat, "profile", 0));
+    profile_interval = ini_section_get_int(cat, "profile_interval", 10);
+    if (profile_interval < 0)
+        profile_interval = 0;
+
     rctrl_is_lalt = ini_section_get_int(cat, "rctrl_is_lalt", 0);
     update_icons  = ini_section_get_int(cat, "update_icons", 1);
 
@@ -493,6 +503,8 @@ load_machine(void)
         mem_size = machine_get_max_ram(machine);
 
     cpu_use_dynarec = !!ini_section_get_int(cat, "cpu_use_dynarec", 0);
+    cpu_dynarec_chaining = !!ini_section_get_int(cat, "cpu_dynarec_chaining", 1);
+    cpu_idle_skip = !!ini_section_get_int(cat, "cpu_idle_skip", 1);
     fpu_softfloat = !!ini_section_get_int(cat, "fpu_softfloat", 0);
     if ((fpu_type != FPU_NONE) && machine_has_flags(machine, MACHINE_SOFTFLOAT_ONLY))
         fpu_softfloat = 1;
@@ -796,6 +808,18 @@ load_sound(void)
     else
         midi_input_device_current = 0;
 
+    for (int i = 0; i < SOUND_CARD_MAX; i++) {
+        if (i == 0)
+            sprintf(temp, "sndcard_gain");
+        else
+            sprintf(temp, "sndcard%i_gain", i + 1);
+        sound_card_gain[i] = ini_section_get_int(cat, temp, 0);
+        if (sound_card_gain[i] < -60)
+            sound_card_gain[i] = -60;
+        else if (sound_card_gain[i] > 18)
+            sound_card_gain[i] = 18;
+    }
+
     mpu401_standalone_enable = !!ini_section_get_int(cat, "mpu401_standalone", 0);
 
     /* Backwards compatibility for standalone SSI-2001, CMS and GUS from v3.11 and older. */
@@ -918,6 +942,12 @@ load_network(void)
     ini_section_delete_var(cat, "net_type");
     ini_section_delete_var(cat, "net_host_device");
 
+    net_queue_depth = ini_section_get_int(cat, "queue_depth", NET_QUEUE_DEPTH_DEF);
+    if (net_queue_depth < NET_QUEUE_DEPTH_MIN)
+        net_queue_depth = NET_QUEUE_DEPTH_MIN;
+    else if (net_queue_depth > NET_QUEUE_DEPTH_MAX)
+        net_queue_depth = NET_QUEUE_DEPTH_MAX;
+
     for (c = min; c < NET_CARD_MAX; c++) {
         nc = &net_cards_conf[c];
         sprintf(temp, "net_%02i_card", c + 1);
@@ -1370,6 +1400,10 @@ load_hard_disks(void)
 
     hdd_audio_load_profiles();
 
+    hdd_image_async      = !!ini_section_get_int(cat, "image_async_io", 0);
+    hdd_image_write_back = !!ini_section_get_int(cat, "image_write_back", 0);
+    hdd_image_mmap       = !!ini_section_get_int(cat, "image_mmap", 0);
+
     memset(temp, '\0', sizeof(temp));
     for (uint8_t c = 0; c < HDD_NUM; c++) {
         sprintf(temp, "hdd_%02i_parameters", c + 1);
@@ -2655,6 +2689,18 @@ save_general(void)
     if (force_10ms == 0)
         ini_section_delete_var(cat, "force_10ms");
 
+    ini_section_set_int(cat, "timer_scheduler", timer_scheduler);
+    if (timer_scheduler == TIMER_SCHED_LIST)
+        ini_section_delete_var(cat, "timer_scheduler");
+
+    ini_section_set_int(cat, "profile", profile_on);
+    if (profile_on == 0)
+        ini_section_delete_var(cat, "profile");
+
+    ini_section_set_int(cat, "profile_interval", profile_interval);
+    if (profile_interval == 10)
+        ini_section_delete_var(cat, "profile_interval");
+
     ini_section_set_int(cat, "sound_muted", sound_muted);
     if (sound_muted == 0)
         ini_section_delete_var(cat, "sound_muted");
@@ -2889,6 +2935,16 @@ save_machine(void)
 
     ini_section_set_int(cat, "cpu_use_dynarec", cpu_use_dynarec);
 
+    if (cpu_dynarec_chaining == 1)
+        ini_section_delete_var(cat, "cpu_dynarec_chaining");
+    else
+        ini_section_set_int(cat, "cpu_dynarec_chaining", cpu_dynarec_chaining);
+
+    if (cpu_idle_skip == 1)
+        ini_section_delete_var(cat, "cpu_idle_skip");
+    else
+        ini_section_set_int(cat, "cpu_idle_skip", cpu_idle_skip);
+
     if (fpu_softfloat == 0)
         ini_section_delete_var(cat, "fpu_softfloat");
     else
@@ -3079,6 +3135,7 @@ static void
 save_sound(void)
 {
     ini_section_t cat = ini_find_or_create_section(config, "Sound");
+    char          temp[512];
 
     if (sound_card_current[0] == 0)
         ini_section_delete_var(cat, "sndcard");
@@ -3110,6 +3167,17 @@ save_sound(void)
     else
         ini_section_set_string(cat, "midi_in_device", midi_in_device_get_internal_name(midi_input_device_current));
 
+    for (int i = 0; i < SOUND_CARD_MAX; i++) {
+        if (i == 0)
+            sprintf(temp, "sndcard_gain");
+        else
+            sprintf(temp, "sndcard%i_gain", i + 1);
+        if (sound_card_gain[i] == 0)
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_int(cat, temp, sound_card_gain[i]);
+    }
+
     if (mpu401_standalone_enable == 0)
         ini_section_delete_var(cat, "mpu401_standalone");
     else
@@ -3241,6 +3309,11 @@ save_network(void)
             ini_section_set_string(cat, temp, net_cards_conf[c].nrs_hostname);
     }
 
+    if (net_queue_depth == NET_QUEUE_DEPTH_DEF)
+        ini_section_delete_var(cat, "queue_depth");
+    else
+        ini_section_set_int(cat, "queue_depth", net_queue_depth);
+
     ini_delete_section_if_empty(config, cat);
 }
 
@@ -3746,6 +3819,21 @@ save_hard_disks(void)
         }
     }
 
+    if (hdd_image_async == 0)
+        ini_section_delete_var(cat, "image_async_io");
+    else
+        ini_section_set_int(cat, "image_async_io", hdd_image_async);
+
+    if (hdd_image_write_back == 0)
+        ini_section_delete_var(cat, "image_write_back");
+    else
+        ini_section_set_int(cat, "image_write_back", hdd_image_write_back);
+
+    if (hdd_image_mmap == 0)
+        ini_section_delete_var(cat, "image_mmap");
+    else
+        ini_section_set_int(cat, "image_mmap", hdd_image_mmap);
+
     ini_delete_section_if_empty(config, cat);
 }
 
@@ -294,6 +294,7 @@ exec386_2386(int32_t cycs)
                     in_lock = 1;
                 x86_2386_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
                 in_lock = 0;
+                cpu_instructions++;
                 if (x86_was_reset)
                     break;
             }
@@ -404,6 +405,9 @@ block_ended:
             ins_cycles -= cycles;
             tsc += ins_cycles;
 
+            /* This core does not skip idle time, drop HLT's request. */
+            cpu_halted = 0;
+
             cycdiff = oldcyc - cycles;
 
             if (timetolive) {
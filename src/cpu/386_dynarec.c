@@ -32,6 +32,7 @@
 #include <86box/plat_fallthrough.h>
 #include <86box/plat_unused.h>
 #include <86box/gdbstub.h>
+#include <86box/profile.h>
 #ifdef USE_DYNAREC
 #    include "codegen.h"
 #    ifdef USE_NEW_DYNAREC
@@ -56,6 +57,13 @@ int cpu_override_dynarec    = 0;
 int inrecomp                = 0;
 int cpu_block_end           = 0;
 int cpu_end_block_after_ins = 0;
+int cpu_halted              = 0;
+
+/* Cycles skipped while the CPU was halted. */
+uint64_t cpu_idle_cycles = 0;
+/* Instructions executed by the 286 and later cores. A compiled block is
+   counted as all of its instructions each time it is entered. */
+uint64_t cpu_instructions = 0;
 
 #ifdef ENABLE_386_DYNAREC_LOG
 int x386_dynarec_do_log = ENABLE_386_DYNAREC_LOG;
@@ -234,6 +242,33 @@ fetch_ea_16_long(uint32_t rmdat)
 #    define CACHE_ON() (!(cr0 & (1 << 30)) && !(cpu_state.flags & T_FLAG))
 #endif
 
+/* The CPU is halted and nothing can wake it up before the next timer fires,
+   so skip straight to that timer instead of executing HLT over and over.
+   Returns the number of cycles skipped. */
+static __inline int32_t
+exec386_idle(void)
+{
+    int64_t skip;
+
+    cpu_halted = 0;
+
+    if (!cpu_idle_skip || (cycles <= 0) || smi_line || (nmi && nmi_enable && nmi_mask) ||
+        ((cpu_state.flags & I_FLAG) && pic.int_pending))
+        return 0;
+
+    skip = (int64_t) (timer_target - tsc);
+    if (skip <= 0)
+        return 0;
+    if (skip > cycles)
+        skip = cycles;
+
+    cycles -= skip;
+    tsc += skip;
+    cpu_idle_cycles += skip;
+
+    return (int32_t) skip;
+}
+
 #ifdef USE_DYNAREC
 int32_t         cycles_main = 0;
 static int32_t  cycles_old  = 0;
@@ -329,6 +364,7 @@ exec386_dynarec_int(void)
             cpu_state.eflags &= ~(RF_FLAG);
 #    endif
             x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+            cpu_instructions++;
         }
 
 #    ifndef USE_NEW_DYNAREC
@@ -389,6 +425,49 @@ block_ended:
     cpu_end_block_after_ins = 0;
 }
 
+#    ifdef USE_NEW_DYNAREC
+/* Called by a linked chain exit, with cpu_state.pc already set to the start
+   of block. Returns the code to continue with: block itself if nothing that
+   the loop in exec386_dynarec() and the block lookup would check between the
+   two blocks stands in the way, otherwise the exit back to the dispatcher,
+   which then handles everything as usual. */
+void *
+codegen_chain_next(codeblock_t *block)
+{
+    /* Stop at the end of the time slice and before the next timer is due. The
+       cycles run since the dispatcher entered the first block are only added
+       to tsc afterwards, so it must not have changed in between. */
+    if ((cycles <= 0) || (tsc != codegen_chain_tsc) ||
+        TIMER_VAL_LESS_THAN_VAL(timer_target, tsc + (uint64_t) (codegen_chain_cycles - cycles)))
+        return codegen_exit_rout;
+
+    if (cpu_state.abrt || cpu_init || new_ne || trap || smi_line || cpu_halted || cpu_end_block_after_ins ||
+        (nmi && nmi_enable && nmi_mask) || ((cpu_state.flags & I_FLAG) && pic.int_pending))
+        return codegen_exit_rout;
+
+    if (cpu_force_interpreter || cpu_override_dynarec || !CACHE_ON())
+        return codegen_exit_rout;
+
+    /* Links only join blocks in the same page, and that page's translation
+       still holds unless the TLB has been flushed since the dispatcher looked
+       up the first block. */
+    if ((mmuflush != codegen_chain_mmuflush) || (block->pc != cs + cpu_state.pc) || (block->_cs != cs) ||
+        ((block->status ^ cpu_cur_status) & CPU_STATUS_FLAGS) ||
+        ((block->status & cpu_cur_status & CPU_STATUS_MASK) != (cpu_cur_status & CPU_STATUS_MASK)))
+        return codegen_exit_rout;
+
+    if ((block->page_mask & *block->dirty_mask) ||
+        ((block->flags & CODEBLOCK_STATIC_TOP) && (block->TOP != (cpu_state.TOP & 7))))
+        return codegen_exit_rout;
+
+    cpu_instructions += block->ins;
+    codegen_stats.chain_hits++;
+    codegen_chain_block = get_block_nr(block);
+
+    return &block->data[codegen_chain_entry_pos];
+}
+#    endif
+
 #if defined(__linux__) && !defined(__clang__) && defined(USE_NEW_DYNAREC)
 static inline void __attribute__((optimize("O2")))
 #else
@@ -398,13 +477,20 @@ exec386_dynarec_dyn(void)
 {
     uint32_t start_pc  = 0;
     uint32_t phys_addr = get_phys(cs + cpu_state.pc);
-    int      hash      = HASH(phys_addr);
 #    ifdef USE_NEW_DYNAREC
-    codeblock_t *block = &codeblock[codeblock_hash[hash]];
+    uint16_t    *hash_set    = HASH_SET(phys_addr);
+    codeblock_t *block       = cpu_state.abrt ? NULL : codeblock_hash_find(hash_set, phys_addr, cs, cs + cpu_state.pc);
+    int          valid_block = (block != NULL);
+
+    /* Fall back to the most recently used block of the set, as the block
+       size limit below is taken from whichever block is looked at. */
+    if (!valid_block)
+        block = &codeblock[hash_set[0]];
 #    else
+    int      hash      = HASH(phys_addr);
     codeblock_t *block = codeblock_hash[hash];
-#    endif
     int valid_block = 0;
+#    endif
 
 #    ifdef USE_NEW_DYNAREC
     if (!cpu_state.abrt)
@@ -417,7 +503,9 @@ exec386_dynarec_dyn(void)
         /* Block must match current CS, PC, code segment size,
            and physical address. The physical address check will
            also catch any page faults at this stage */
+#    ifndef USE_NEW_DYNAREC
         valid_block = (block->pc == cs + cpu_state.pc) && (block->_cs == cs) && (block->phys == phys_addr) && !((block->status ^ cpu_cur_status) & CPU_STATUS_FLAGS) && ((block->status & cpu_cur_status & CPU_STATUS_MASK) == (cpu_cur_status & CPU_STATUS_MASK));
+#    endif
         if (!valid_block) {
             uint64_t mask = (uint64_t) 1 << ((phys_addr >> PAGE_MASK_SHIFT) & PAGE_MASK_MASK);
 #    ifdef USE_NEW_DYNAREC
@@ -437,11 +525,16 @@ exec386_dynarec_dyn(void)
                     if (valid_block) {
                         block = new_block;
 #    ifdef USE_NEW_DYNAREC
-                        codeblock_hash[hash] = get_block_nr(block);
+                        codeblock_hash_insert(block);
+                        codegen_stats.tree_hits++;
 #    endif
                     }
                 }
             }
+#    ifdef USE_NEW_DYNAREC
+            if (!valid_block)
+                codegen_stats.misses++;
+#    endif
         }
 
         if (valid_block && (block->page_mask & *block->dirty_mask)) {
@@ -521,23 +614,42 @@ exec386_dynarec_dyn(void)
 #    endif
     {
         void (*code)(void) = (void *) &block->data[BLOCK_START];
+        uint64_t prof      = profile_start();
 
 #    ifndef USE_NEW_DYNAREC
         codeblock_hash[hash] = block;
+#    else
+        /* Chained blocks would skip the breakpoint check made between blocks. */
+#        ifndef USE_GDBSTUB
+        if (cpu_dynarec_chaining)
+            codegen_chain_link(block);
+#        endif
+        codegen_chain_block    = get_block_nr(block);
+        codegen_chain_cycles   = cycles;
+        codegen_chain_tsc      = tsc;
+        codegen_chain_mmuflush = mmuflush;
+        codegen_stats.blocks_run++;
 #    endif
         inrecomp = 1;
         code();
+        cpu_instructions += block->ins;
 #    ifdef USE_ACYCS
         acycs = 0;
 #    endif
         inrecomp = 0;
 
+        if (prof)
+            profile_end(PROFILE_CODEGEN_EXEC, NULL, NULL, prof);
+
 #    ifndef USE_NEW_DYNAREC
         if (!use32)
             cpu_state.pc &= 0xffff;
 #    endif
     } else if (valid_block && !cpu_state.abrt) {
+        uint64_t prof = profile_start();
+
 #    ifdef USE_NEW_DYNAREC
+        codegen_stats.compiles++;
         start_pc                 = cs + cpu_state.pc;
         const int max_block_size = (block->flags & CODEBLOCK_BYTE_MASK) ? ((128 - 25) - (start_pc & 0x3f)) : 1000;
 #    else
@@ -552,8 +664,10 @@ exec386_dynarec_dyn(void)
             pthread_jit_write_protect_np(0);
         }
 #    endif
-        codegen_block_start_recompile(block);
+        /* Set first, freeing the old code can patch chain exits and the
+           code buffer must stay writable for that. */
         codegen_in_recompile = 1;
+        codegen_block_start_recompile(block);
 
         while (!cpu_block_end) {
 #    ifndef USE_NEW_DYNAREC
@@ -581,6 +695,7 @@ exec386_dynarec_dyn(void)
                 codegen_generate_call(opcode, x86_opcodes[(opcode | cpu_state.op32) & 0x3ff], fetchdat, cpu_state.pc, cpu_state.pc - 1);
 
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                cpu_instructions++;
 
                 if (x86_was_reset)
                     break;
@@ -637,6 +752,9 @@ exec386_dynarec_dyn(void)
         if (x86_was_reset)
             codegen_reset();
 
+        if (prof)
+            profile_end(PROFILE_CODEGEN_COMPILE, NULL, NULL, prof);
+
         codegen_in_recompile = 0;
 #    if defined(__APPLE__) && defined(__aarch64__)
         if (__builtin_available(macOS 11.0, *)) {
@@ -645,7 +763,10 @@ exec386_dynarec_dyn(void)
 #    endif
     } else if (!cpu_state.abrt) {
         /* Mark block but do not recompile */
+        uint64_t prof = profile_start();
+
 #    ifdef USE_NEW_DYNAREC
+        codegen_stats.interpreted++;
         start_pc                 = cs + cpu_state.pc;
         const int max_block_size = (block->flags & CODEBLOCK_BYTE_MASK) ? ((128 - 25) - (start_pc & 0x3f)) : 1000;
 #    else
@@ -683,6 +804,7 @@ exec386_dynarec_dyn(void)
                 cpu_state.pc++;
 
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                cpu_instructions++;
 
                 if (x86_was_reset)
                     break;
@@ -738,6 +860,9 @@ exec386_dynarec_dyn(void)
 
         if (x86_was_reset)
             codegen_reset();
+
+        if (prof)
+            profile_end(PROFILE_CODEGEN_INTERP, NULL, NULL, prof);
     }
 #    ifdef USE_NEW_DYNAREC
     else
@@ -825,14 +950,18 @@ exec386_dynarec(int32_t cycs)
                 x86_int(16);
             }
 
-            if (smi_line)
+            /* Delivering any of these wakes a halted CPU up, so there is
+               no idle time to skip afterwards. */
+            if (smi_line) {
                 enter_smm_check(0);
-            else if (nmi && nmi_enable && nmi_mask) {
+                cpu_halted = 0;
+            } else if (nmi && nmi_enable && nmi_mask) {
 #    ifndef USE_NEW_DYNAREC
                 oldcs = CS;
 #    endif
                 cpu_state.oldpc = cpu_state.pc;
                 x86_int(2);
+                cpu_halted = 0;
                 nmi_enable = 0;
 #    ifdef OLD_NMI_BEHAVIOR
                 if (nmi_auto_clear) {
@@ -845,6 +974,7 @@ exec386_dynarec(int32_t cycs)
             } else if ((cpu_state.flags & I_FLAG) && pic.int_pending) {
                 vector = picinterrupt();
                 if (vector != -1) {
+                    cpu_halted = 0;
 #    ifndef USE_NEW_DYNAREC
                     oldcs = CS;
 #    endif
@@ -866,6 +996,9 @@ exec386_dynarec(int32_t cycs)
                 tsc += cycdiff;
             }
 
+            if (cpu_halted)
+                cycdiff += exec386_idle();
+
             if (cycdiff > 0) {
                 if (TIMER_VAL_LESS_THAN_VAL(timer_target, (uint64_t) tsc))
                     timer_process();
@@ -954,6 +1087,7 @@ exec386(int32_t cycs)
                 cpu_state.eflags &= ~(RF_FLAG);
 #endif
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                cpu_instructions++;
                 if (x86_was_reset)
                     break;
             }
@@ -1033,14 +1167,18 @@ block_ended:
                 x86_int(1);
             }
 
-            if (smi_line)
+            /* Delivering any of these wakes a halted CPU up, so there is
+               no idle time to skip afterwards. */
+            if (smi_line) {
                 enter_smm_check(0);
-            else if (nmi && nmi_enable && nmi_mask) {
+                cpu_halted = 0;
+            } else if (nmi && nmi_enable && nmi_mask) {
 #ifndef USE_NEW_DYNAREC
                 oldcs = CS;
 #endif
                 cpu_state.oldpc = cpu_state.pc;
                 x86_int(2);
+                cpu_halted = 0;
                 nmi_enable = 0;
 #ifdef OLD_NMI_BEHAVIOR
                 if (nmi_auto_clear) {
@@ -1053,6 +1191,7 @@ block_ended:
             } else if ((cpu_state.flags & I_FLAG) && pic.int_pending && !cpu_end_block_after_ins) {
                 vector = picinterrupt();
                 if (vector != -1) {
+                    cpu_halted = 0;
                     flags_rebuild();
                     if (msw & 1)
                         pmodeint(vector, 0);
@@ -1073,6 +1212,9 @@ block_ended:
             ins_cycles -= cycles;
             tsc += ins_cycles;
 
+            if (cpu_halted)
+                exec386_idle();
+
             cycdiff = oldcyc - cycles;
 
             if (timetolive) {
@@ -47,6 +47,21 @@
 #ifdef USE_NEW_DYNAREC
 #    define BLOCK_PC_INVALID 0xffffffff
 #    define BLOCK_INVALID    0
+
+/*Block lookup statistics, for measuring the code block hash and tree*/
+typedef struct codegen_stats_t {
+    uint64_t hash_hits;   /*Lookups satisfied by the code block hash*/
+    uint64_t tree_hits;   /*Lookups satisfied by the per-page tree*/
+    uint64_t misses;      /*Lookups that found no usable block*/
+    uint64_t probes;      /*Hash ways and tree nodes examined by all lookups*/
+    uint64_t chain_hits;  /*Blocks entered from the previous block through a chain link*/
+    uint64_t chain_links; /*Chain links patched into block exits*/
+    uint64_t blocks_run;  /*Recompiled blocks entered from the dispatcher*/
+    uint64_t compiles;    /*Blocks run through the recompiler*/
+    uint64_t interpreted; /*Blocks run through the interpreter, being marked for recompiling*/
+} codegen_stats_t;
+
+extern codegen_stats_t codegen_stats;
 #endif
 
 extern void codegen_init(void);
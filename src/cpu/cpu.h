@@ -692,6 +692,10 @@ extern int is_vpc;
 extern int soft_reset_mask;
 extern int alt_access;
 extern int cpu_end_block_after_ins;
+extern int cpu_halted;
+
+extern uint64_t cpu_idle_cycles;
+extern uint64_t cpu_instructions;
 
 extern uint16_t cpu_fast_off_count;
 extern uint16_t cpu_fast_off_val;
@@ -354,6 +354,7 @@ reset_common(int hard)
 
     shadowbios = shadowbios_write = 0;
     alt_access = cpu_end_block_after_ins = 0;
+    cpu_halted                           = 0;
 
     if (hard) {
         reset_on_hlt = hlt_reset_pending = 0;
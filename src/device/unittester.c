@@ -328,7 +328,7 @@ unittester_write(uint16_t port, uint8_t val, UNUSED(void *priv))
                         /* Take snapshot */
                         for (size_t y = 0; y < unittester.snap_overscan_height; y++) {
                             for (size_t x = 0; x < unittester.snap_overscan_width; x++) {
-                                unittester_screen_buffer->line[y][x] = m->target_buffer->line[y][x];
+                                unittester_screen_buffer->line[y][x] = m->blit_buffer->line[y][x];
                             }
                         }
                     }
@@ -96,6 +96,8 @@
 #define WIN_SETIDLE1                   0xe3
 #define WIN_CHECKPOWERMODE1            0xe5
 #define WIN_SLEEP1                     0xe6
+#define WIN_FLUSH_CACHE                0xe7
+#define WIN_FLUSH_CACHE_EXT            0xea /* 48-Bit Flush Cache */
 #define WIN_IDENTIFY                   0xec /* Ask drive to identify itself */
 #define WIN_SET_FEATURES               0xef
 #define WIN_READ_NATIVE_MAX            0xf8
@@ -623,6 +625,12 @@ ide_hd_identify(const ide_t *ide)
     ide->buffer[83] = ide->buffer[84] = 0x4000;
     ide->buffer[86] = 0x0000;
     ide->buffer[87] = 0x4000;
+
+    /* FLUSH CACHE supported and enabled, ATA-5 and later. */
+    if (ide->buffer[80] & 0x20) {
+        ide->buffer[83] |= (1 << 12);
+        ide->buffer[86] |= (1 << 12);
+    }
 }
 
 static void
@@ -1783,6 +1791,9 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
                         ui_sb_update_icon(SB_HDD | hdd[ide->hdd_num].bus_type, 1);
                         uint32_t sec_count;
                         double   wait_time;
+                        /* The callback reads the whole transfer at once, start it now. */
+                        hdd_image_prefetch(ide->hdd_num, ide_get_sector(ide),
+                                           ide->tf->secount ? ide->tf->secount : 256);
                         if ((val == WIN_READ) && (prev == WIN_SETIDLE1)) {
                             /* Do the callback instantly - this happens on the Intel Monsoon. */
                             (void) hdd_timing_read(&hdd[ide->hdd_num], ide_get_sector(ide), 1);
@@ -1844,6 +1855,8 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
                 case WIN_IDENTIFY:     /* Identify Device */
                 case WIN_SET_FEATURES: /* Set Features */
                 case WIN_READ_NATIVE_MAX:
+                case WIN_FLUSH_CACHE:
+                case WIN_FLUSH_CACHE_EXT:
                     ide->tf->atastat = BSY_STAT;
 
                     if (ide->type == IDE_ATAPI)
@@ -2588,6 +2601,19 @@ ide_callback(void *priv)
             }
             break;
 
+        case WIN_FLUSH_CACHE:
+        case WIN_FLUSH_CACHE_EXT:
+            if (ide->type == IDE_ATAPI)
+                err = ABRT_ERR;
+            else {
+                /* Writes out anything the image is holding back. */
+                hdd_image_sync(ide->hdd_num);
+
+                ide->tf->atastat = DRDY_STAT | DSC_STAT;
+                ide_irq_raise(ide);
+            }
+            break;
+
         case WIN_FORMAT:
             if (ide->type == IDE_ATAPI)
                 err = ABRT_ERR;
@@ -26,9 +26,11 @@
 #include <errno.h>
 #if defined(__unix__) || defined(__APPLE__)
 #include <unistd.h>
+#include <sys/mman.h>
 #endif
 #ifdef _WIN32
 #include <io.h>
+#include <windows.h>
 #define fsync(fd) _commit(fd)
 #endif
 #define HAVE_STDARG_H
@@ -36,6 +38,7 @@
 #include <86box/path.h>
 #include <86box/plat.h>
 #include <86box/random.h>
+#include <86box/thread.h>
 #include <86box/hdd.h>
 #include "minivhd/minivhd.h"
 #include "minivhd/internal.h"
@@ -45,6 +48,51 @@
 #define HDD_IMAGE_HDX 2
 #define HDD_IMAGE_VHD 3
 
+/* Largest image that gets mapped into the address space. */
+#define HDD_IMAGE_MMAP_MAX (1ULL << 40)
+
+/* Requests queued to the per-image I/O worker. */
+#define HDD_IMAGE_QUEUE_DEPTH  64
+#define HDD_IMAGE_PREFETCH_MAX 256
+
+enum {
+    HDD_IO_READ = 0,
+    HDD_IO_WRITE,
+    HDD_IO_ZERO,
+    HDD_IO_SYNC,
+    HDD_IO_QUIT
+};
+
+typedef struct hdd_io_req_t {
+    uint8_t  op;
+    uint8_t  owned; /* buffer is a private copy, freed by the worker */
+    uint32_t sector;
+    uint32_t count;
+    uint8_t *buffer;
+    int     *result; /* NULL for write-back requests nobody waits on */
+} hdd_io_req_t;
+
+typedef struct hdd_image_async_t {
+    thread_t    *thread;
+    mutex_t     *mutex;
+    event_t     *wake; /* set when a request is queued */
+    event_t     *done; /* set when a request completes */
+    hdd_io_req_t queue[HDD_IMAGE_QUEUE_DEPTH];
+    uint64_t     head; /* sequence number of the next request to queue */
+    uint64_t     tail; /* sequence number of the oldest pending request */
+    int          error; /* a write-back request failed */
+
+    /* Read-ahead slot, filled by the worker while the controller's
+       command timer runs. */
+    uint8_t     *pf_buffer;
+    uint64_t     pf_seq;
+    uint32_t     pf_sector;
+    uint32_t     pf_count;
+    int          pf_result;
+    uint8_t      pf_valid;
+    uint8_t      pf_issued;
+} hdd_image_async_t;
+
 typedef struct hdd_image_t {
     FILE     *file; /* Used for HDD_IMAGE_RAW, HDD_IMAGE_HDI, and HDD_IMAGE_HDX. */
     MVHDMeta *vhd;  /* Used for HDD_IMAGE_VHD. */
@@ -54,11 +102,16 @@ typedef struct hdd_image_t {
     uint8_t   type; /* HDD_IMAGE_RAW, HDD_IMAGE_HDI, HDD_IMAGE_HDX, or HDD_IMAGE_VHD */
     uint8_t   loaded;
     uint8_t   is_block_device; /* 1 if this is a raw block device (e.g., /dev/disk4s1) */
+    hdd_image_async_t *async; /* I/O worker, NULL if image I/O is synchronous */
+    uint8_t           *map;   /* whole image mapped into memory, or NULL */
+    uint64_t           map_size;
+    void              *map_handle; /* file mapping object on Windows */
 } hdd_image_t;
 
 hdd_image_t hdd_images[HDD_NUM];
 
 static char  empty_sector[512];
+static const uint8_t zero_block[32768];
 #ifndef __unix__
 static char *empty_sector_1mb;
 #endif
@@ -81,6 +134,441 @@ hdd_image_log(const char *fmt, ...)
 #    define hdd_image_log(fmt, ...)
 #endif
 
+/* Transfer whole sectors between the image and a buffer, at an absolute
+   sector number. Only the I/O worker calls these while it is running, so
+   the file is never touched from two threads at once. */
+static int
+hdd_image_file_read(hdd_image_t *img, uint8_t *buffer, uint32_t sector, uint32_t count)
+{
+    uint64_t addr = ((uint64_t) sector << 9LL) + img->base;
+    size_t   len  = (size_t) count << 9;
+
+#if defined(__unix__) || defined(__APPLE__)
+    int     fd = fileno(img->file);
+    ssize_t n;
+
+    while (len > 0) {
+        n = pread(fd, buffer, len, (off_t) addr);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        } else if (n == 0) {
+            /* Past the end of the image, like fread() hitting EOF. */
+            memset(buffer, 0x00, len);
+            break;
+        }
+        buffer += n;
+        addr += n;
+        len -= n;
+    }
+#else
+    size_t num_read;
+
+    if (fseeko64(img->file, addr, SEEK_SET) == -1)
+        return -1;
+
+    num_read = fread(buffer, 512, count, img->file);
+    if ((num_read < count) && !feof(img->file))
+        return -1;
+#endif
+
+    return 0;
+}
+
+static int
+hdd_image_file_write(hdd_image_t *img, const uint8_t *buffer, uint32_t sector, uint32_t count)
+{
+    uint64_t addr = ((uint64_t) sector << 9LL) + img->base;
+    size_t   len  = (size_t) count << 9;
+
+#if defined(__unix__) || defined(__APPLE__)
+    int     fd = fileno(img->file);
+    ssize_t n;
+
+    while (len > 0) {
+        n = pwrite(fd, buffer, len, (off_t) addr);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        } else if (n == 0)
+            return -1;
+        buffer += n;
+        addr += n;
+        len -= n;
+    }
+#else
+    if (fseeko64(img->file, addr, SEEK_SET) == -1)
+        return -1;
+
+    if (fwrite(buffer, 512, count, img->file) < count)
+        return -1;
+
+    /* pwrite() hands the data straight to the OS; do the same here unless
+       writes are allowed to linger until the next sync. */
+    if (!hdd_image_write_back)
+        fflush(img->file);
+#endif
+
+    return 0;
+}
+
+static int
+hdd_image_do_io(hdd_image_t *img, const hdd_io_req_t *req)
+{
+    uint32_t sector = req->sector;
+    uint32_t count  = req->count;
+    uint32_t chunk;
+
+    switch (req->op) {
+        case HDD_IO_READ:
+            return hdd_image_file_read(img, req->buffer, sector, count);
+
+        case HDD_IO_WRITE:
+            return hdd_image_file_write(img, req->buffer, sector, count);
+
+        case HDD_IO_ZERO:
+            while (count > 0) {
+                chunk = count;
+                if (chunk > (sizeof(zero_block) >> 9))
+                    chunk = sizeof(zero_block) >> 9;
+                if (hdd_image_file_write(img, zero_block, sector, chunk) < 0)
+                    return -1;
+                sector += chunk;
+                count -= chunk;
+            }
+            return 0;
+
+        case HDD_IO_SYNC:
+            if (fflush(img->file))
+                return -1;
+            if (hdd_image_write_back && !img->is_block_device)
+                (void) fsync(fileno(img->file));
+            return 0;
+
+        default:
+            return 0;
+    }
+}
+
+static void
+hdd_image_worker(void *priv)
+{
+    hdd_image_t       *img = (hdd_image_t *) priv;
+    hdd_image_async_t *as  = img->async;
+    hdd_io_req_t       req;
+    int                ret;
+
+    while (1) {
+        thread_wait_mutex(as->mutex);
+        while (as->tail == as->head) {
+            thread_reset_event(as->wake);
+            thread_release_mutex(as->mutex);
+            thread_wait_event(as->wake, -1);
+            thread_wait_mutex(as->mutex);
+        }
+        /* The slot stays owned by the worker until the tail moves on. */
+        req = as->queue[as->tail % HDD_IMAGE_QUEUE_DEPTH];
+        thread_release_mutex(as->mutex);
+
+        ret = hdd_image_do_io(img, &req);
+        if (req.owned)
+            free(req.buffer);
+
+        thread_wait_mutex(as->mutex);
+        if (req.result != NULL)
+            *req.result = ret;
+        else if (ret < 0)
+            as->error = 1;
+        as->tail++;
+        thread_set_event(as->done);
+        thread_release_mutex(as->mutex);
+
+        if (req.op == HDD_IO_QUIT)
+            break;
+    }
+}
+
+static uint64_t
+hdd_image_async_queue(hdd_image_async_t *as, uint8_t op, uint32_t sector, uint32_t count,
+                      uint8_t *buffer, uint8_t owned, int *result)
+{
+    hdd_io_req_t *req;
+    uint64_t      seq;
+
+    thread_wait_mutex(as->mutex);
+    while ((as->head - as->tail) >= HDD_IMAGE_QUEUE_DEPTH) {
+        thread_reset_event(as->done);
+        thread_release_mutex(as->mutex);
+        thread_wait_event(as->done, 10);
+        thread_wait_mutex(as->mutex);
+    }
+
+    seq         = as->head++;
+    req         = &as->queue[seq % HDD_IMAGE_QUEUE_DEPTH];
+    req->op     = op;
+    req->owned  = owned;
+    req->sector = sector;
+    req->count  = count;
+    req->buffer = buffer;
+    req->result = result;
+
+    thread_set_event(as->wake);
+    thread_release_mutex(as->mutex);
+
+    return seq;
+}
+
+/* Wait until the request with the given sequence number has completed.
+   The timeout only guards against a lost wake-up when two threads wait
+   on the same image, e.g. the CPU thread and a sync from the UI. */
+static void
+hdd_image_async_wait(hdd_image_async_t *as, uint64_t seq)
+{
+    thread_wait_mutex(as->mutex);
+    while (as->tail <= seq) {
+        thread_reset_event(as->done);
+        thread_release_mutex(as->mutex);
+        thread_wait_event(as->done, 10);
+        thread_wait_mutex(as->mutex);
+    }
+    thread_release_mutex(as->mutex);
+}
+
+static int
+hdd_image_async_request(hdd_image_async_t *as, uint8_t op, uint32_t sector, uint32_t count,
+                        uint8_t *buffer)
+{
+    int ret = -1;
+
+    hdd_image_async_wait(as, hdd_image_async_queue(as, op, sector, count, buffer, 0, &ret));
+
+    return ret;
+}
+
+/* Returns, and clears, a failure of an earlier write-back request, so that
+   the guest sees it on its next write instead of never. */
+static int
+hdd_image_async_error(hdd_image_async_t *as)
+{
+    int ret;
+
+    thread_wait_mutex(as->mutex);
+    ret       = as->error;
+    as->error = 0;
+    thread_release_mutex(as->mutex);
+
+    return ret;
+}
+
+static void
+hdd_image_async_invalidate(hdd_image_async_t *as, uint32_t sector, uint32_t count)
+{
+    if (as->pf_valid && (sector < (as->pf_sector + as->pf_count)) &&
+        ((sector + count) > as->pf_sector))
+        as->pf_valid = 0;
+}
+
+static void
+hdd_image_async_start(uint8_t id)
+{
+    hdd_image_t       *img = &hdd_images[id];
+    hdd_image_async_t *as;
+
+    if (!hdd_image_async || !img->loaded || (img->file == NULL) ||
+        (img->type == HDD_IMAGE_VHD) || (img->async != NULL))
+        return;
+
+    /* Anything written while creating the image must reach the OS before
+       the worker starts using positioned I/O on the descriptor. */
+    fflush(img->file);
+
+    as = (hdd_image_async_t *) calloc(1, sizeof(hdd_image_async_t));
+    if (as == NULL)
+        fatal("hdd_image_async_start(): Out of memory\n");
+    as->pf_buffer = (uint8_t *) malloc(HDD_IMAGE_PREFETCH_MAX << 9);
+    if (as->pf_buffer == NULL)
+        fatal("hdd_image_async_start(): Out of memory\n");
+    as->mutex  = thread_create_mutex();
+    as->wake   = thread_create_event();
+    as->done   = thread_create_event();
+    img->async = as;
+    as->thread = thread_create(hdd_image_worker, img);
+
+    hdd_image_log("Hard disk image %i: Asynchronous I/O enabled (write-back %s)\n",
+                  id, hdd_image_write_back ? "on" : "off");
+}
+
+static void
+hdd_image_async_stop(uint8_t id)
+{
+    hdd_image_t       *img = &hdd_images[id];
+    hdd_image_async_t *as  = img->async;
+
+    if (as == NULL)
+        return;
+
+    /* The worker drains everything queued before the quit request. */
+    hdd_image_async_wait(as, hdd_image_async_queue(as, HDD_IO_QUIT, 0, 0, NULL, 0, NULL));
+    thread_wait(as->thread);
+
+    if (as->error)
+        pclog("Hard disk image %i: Deferred write failed\n", id);
+
+    thread_destroy_event(as->done);
+    thread_destroy_event(as->wake);
+    thread_close_mutex(as->mutex);
+    free(as->pf_buffer);
+    free(as);
+
+    img->async = NULL;
+}
+
+/* Maps the image file, so sector transfers become a plain memcpy(). Only
+   an image whose file covers all of it is mapped, so that every sector
+   transfer goes through the mapping and never through stdio, whose buffers
+   would not see the data written through the other. */
+static void
+hdd_image_map(uint8_t id)
+{
+    hdd_image_t *img  = &hdd_images[id];
+    uint64_t     size = ((uint64_t) img->last_sector + 1) << 9LL;
+    uint64_t     file_size;
+
+    if (!hdd_image_mmap || (sizeof(void *) < 8) || !img->loaded || (img->file == NULL) ||
+        (img->type == HDD_IMAGE_VHD) || img->is_block_device || (img->map != NULL))
+        return;
+
+    size += img->base;
+    if (size > HDD_IMAGE_MMAP_MAX)
+        return;
+
+    fflush(img->file);
+
+    /* Touching a mapped page past the end of the file faults, so a file
+       shorter than the image is left to stdio. */
+    if (fseeko64(img->file, 0, SEEK_END) == -1)
+        return;
+    file_size = ftello64(img->file);
+    if (file_size < size) {
+        hdd_image_log("Hard disk image %i: File shorter than the image, not mapping it\n", id);
+        return;
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    void *map = mmap(NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(img->file), 0);
+
+    if (map == MAP_FAILED) {
+        hdd_image_log("Hard disk image %i: Unable to map the image\n", id);
+        return;
+    }
+#elif defined(_WIN32)
+    HANDLE fh      = (HANDLE) _get_osfhandle(_fileno(img->file));
+    HANDLE mapping = CreateFileMapping(fh, NULL, PAGE_READWRITE, (DWORD) (size >> 32),
+                                       (DWORD) size, NULL);
+    void  *map;
+
+    if (mapping == NULL) {
+        hdd_image_log("Hard disk image %i: Unable to map the image\n", id);
+        return;
+    }
+    map = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, (SIZE_T) size);
+    if (map == NULL) {
+        hdd_image_log("Hard disk image %i: Unable to map the image\n", id);
+        CloseHandle(mapping);
+        return;
+    }
+    img->map_handle = (void *) mapping;
+#else
+    return;
+#endif
+
+    img->map      = (uint8_t *) map;
+    img->map_size = size;
+
+    hdd_image_log("Hard disk image %i: Mapped %llu bytes\n", id, (unsigned long long) size);
+}
+
+static void
+hdd_image_map_sync(hdd_image_t *img)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (msync(img->map, (size_t) img->map_size, MS_SYNC))
+        hdd_image_log("Hard disk image: msync() failed\n");
+#elif defined(_WIN32)
+    FlushViewOfFile(img->map, 0);
+    FlushFileBuffers((HANDLE) _get_osfhandle(_fileno(img->file)));
+#endif
+}
+
+static void
+hdd_image_unmap(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->map == NULL)
+        return;
+
+    hdd_image_map_sync(img);
+
+#if defined(__unix__) || defined(__APPLE__)
+    munmap(img->map, (size_t) img->map_size);
+#elif defined(_WIN32)
+    UnmapViewOfFile(img->map);
+    CloseHandle((HANDLE) img->map_handle);
+    img->map_handle = NULL;
+#endif
+
+    img->map      = NULL;
+    img->map_size = 0;
+}
+
+/* Returns the mapped address of a sector range, or NULL if the image is not
+   mapped or the range runs past the end of the image, which is then left to
+   stdio as for an unmapped image. */
+static inline uint8_t *
+hdd_image_map_ptr(hdd_image_t *img, uint32_t sector, uint32_t count)
+{
+    uint64_t addr = ((uint64_t) sector << 9LL) + img->base;
+
+    if ((img->map == NULL) || ((addr + ((uint64_t) count << 9LL)) > img->map_size))
+        return NULL;
+
+    return img->map + addr;
+}
+
+/* Starts reading sectors into the read-ahead slot, so that the host I/O
+   overlaps the seek and transfer time emulated by the controller. */
+void
+hdd_image_prefetch(uint8_t id, uint32_t sector, uint32_t count)
+{
+    hdd_image_async_t *as = hdd_images[id].async;
+
+    if ((as == NULL) || (count == 0) || (sector > hdd_images[id].last_sector))
+        return;
+
+    if (count > HDD_IMAGE_PREFETCH_MAX)
+        count = HDD_IMAGE_PREFETCH_MAX;
+    if (count > (hdd_images[id].last_sector - sector + 1))
+        count = hdd_images[id].last_sector - sector + 1;
+
+    if (as->pf_valid && (sector >= as->pf_sector) &&
+        ((sector + count) <= (as->pf_sector + as->pf_count)))
+        return;
+
+    /* The worker may still be filling the slot for an invalidated request. */
+    if (as->pf_issued)
+        hdd_image_async_wait(as, as->pf_seq);
+
+    as->pf_sector = sector;
+    as->pf_count  = count;
+    as->pf_valid  = 1;
+    as->pf_issued = 1;
+    as->pf_seq    = hdd_image_async_queue(as, HDD_IO_READ, sector, count,
+                                          as->pf_buffer, 0, &as->pf_result);
+}
+
 int
 image_is_hdi(const char *s)
 {
@@ -259,8 +747,8 @@ hdd_image_init(void)
         memset(&hdd_images[i], 0, sizeof(hdd_image_t));
 }
 
-int
-hdd_image_load(int id)
+static int
+hdd_image_load_file(int id)
 {
     uint32_t sector_size = 512;
     uint32_t zero        = 0;
@@ -558,6 +1046,28 @@ fail_raw:
     return ret;
 }
 
+int
+hdd_image_load(int id)
+{
+    int ret;
+
+    hdd_image_async_stop(id);
+    hdd_image_unmap(id);
+
+    ret = hdd_image_load_file(id);
+    if (ret > 0) {
+        /* VHD metadata is only deferred to the next sync when asked to. */
+        if (hdd_images[id].vhd != NULL)
+            mvhd_set_write_back(hdd_images[id].vhd, !!hdd_image_write_back);
+        hdd_image_map(id);
+        /* A mapped image has no use for the I/O worker. */
+        if (hdd_images[id].map == NULL)
+            hdd_image_async_start(id);
+    }
+
+    return ret;
+}
+
 int
 hdd_image_seek(uint8_t id, uint32_t sector)
 {
@@ -565,6 +1075,11 @@ hdd_image_seek(uint8_t id, uint32_t sector)
     addr         = (uint64_t) sector << 9LL;
 
     hdd_images[id].pos = sector;
+    /* The worker and the mapping use absolute offsets, there is no file
+       position to move. */
+    if ((hdd_images[id].async != NULL) || (hdd_images[id].map != NULL))
+        return 0;
+
     if (hdd_images[id].type != HDD_IMAGE_VHD) {
         if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, addr + hdd_images[id].base, SEEK_SET) == -1)) {
             hdd_image_log("hdd_image_seek(): Error seeking\n");
@@ -578,10 +1093,29 @@ hdd_image_seek(uint8_t id, uint32_t sector)
 int
 hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
-    int    non_transferred_sectors;
-    size_t num_read;
+    hdd_image_async_t *as = hdd_images[id].async;
+    uint8_t           *src;
+    int                non_transferred_sectors;
+    size_t             num_read;
+
+    if ((src = hdd_image_map_ptr(&hdd_images[id], sector, count)) != NULL) {
+        memcpy(buffer, src, (size_t) count << 9);
+        hdd_images[id].pos = sector + count;
+    } else if (as != NULL) {
+        hdd_images[id].pos = sector + count;
+
+        if (as->pf_valid && (sector >= as->pf_sector) &&
+            ((sector + count) <= (as->pf_sector + as->pf_count))) {
+            hdd_image_async_wait(as, as->pf_seq);
+            if (as->pf_result == 0) {
+                memcpy(buffer, as->pf_buffer + ((sector - as->pf_sector) << 9), count << 9);
+                return 0;
+            }
+            as->pf_valid = 0;
+        }
 
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
+        return hdd_image_async_request(as, HDD_IO_READ, sector, count, buffer);
+    } else if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error = 0;
         non_transferred_sectors   = mvhd_read_sectors(hdd_images[id].vhd, sector, count, buffer);
         hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
@@ -634,10 +1168,33 @@ hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 int
 hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
-    int    non_transferred_sectors;
-    size_t num_write;
+    hdd_image_async_t *as = hdd_images[id].async;
+    uint8_t           *copy;
+    uint8_t           *dst;
+    int                non_transferred_sectors;
+    size_t             num_write;
+
+    if ((dst = hdd_image_map_ptr(&hdd_images[id], sector, count)) != NULL) {
+        memcpy(dst, buffer, (size_t) count << 9);
+        hdd_images[id].pos = sector + count;
+    } else if (as != NULL) {
+        hdd_images[id].pos = sector + count;
+        hdd_image_async_invalidate(as, sector, count);
+
+        if (hdd_image_async_error(as))
+            return -1;
+
+        if (hdd_image_write_back) {
+            copy = (uint8_t *) malloc(count << 9);
+            if (copy != NULL) {
+                memcpy(copy, buffer, count << 9);
+                (void) hdd_image_async_queue(as, HDD_IO_WRITE, sector, count, copy, 1, NULL);
+                return 0;
+            }
+        }
 
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
+        return hdd_image_async_request(as, HDD_IO_WRITE, sector, count, buffer);
+    } else if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error = 0;
         non_transferred_sectors   = mvhd_write_sectors(hdd_images[id].vhd, sector, count, buffer);
         hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
@@ -651,7 +1208,10 @@ hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 
         num_write          = fwrite(buffer, 512, count, hdd_images[id].file);
         hdd_images[id].pos = sector + num_write;
-        fflush(hdd_images[id].file);
+        /* With write-back, the data is left in the stdio buffer until the
+           next sync. */
+        if (!hdd_image_write_back)
+            fflush(hdd_images[id].file);
         if (num_write < count)
             return -1;
     }
@@ -679,7 +1239,26 @@ hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 int
 hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
 {
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
+    hdd_image_async_t *as = hdd_images[id].async;
+    uint8_t           *dst;
+
+    if ((dst = hdd_image_map_ptr(&hdd_images[id], sector, count)) != NULL) {
+        memset(dst, 0x00, (size_t) count << 9);
+        hdd_images[id].pos = sector + count;
+    } else if (as != NULL) {
+        hdd_images[id].pos = sector + count;
+        hdd_image_async_invalidate(as, sector, count);
+
+        if (hdd_image_async_error(as))
+            return -1;
+
+        if (hdd_image_write_back) {
+            (void) hdd_image_async_queue(as, HDD_IO_ZERO, sector, count, NULL, 0, NULL);
+            return 0;
+        }
+
+        return hdd_image_async_request(as, HDD_IO_ZERO, sector, count, NULL);
+    } else if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error   = 0;
         int non_transferred_sectors = mvhd_format_sectors(hdd_images[id].vhd, sector, count);
         hdd_images[id].pos          = sector + count - non_transferred_sectors - 1;
@@ -702,7 +1281,8 @@ hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
                 return -1;
         }
 
-        fflush(hdd_images[id].file);
+        if (!hdd_image_write_back)
+            fflush(hdd_images[id].file);
     }
 
     return 0;
@@ -742,6 +1322,9 @@ hdd_image_unload(uint8_t id, UNUSED(int fn_preserve))
     if (strlen(hdd[id].fn) == 0)
         return;
 
+    hdd_image_async_stop(id);
+    hdd_image_unmap(id);
+
     if (hdd_images[id].loaded) {
         if (hdd_images[id].file != NULL) {
             fclose(hdd_images[id].file);
@@ -766,6 +1349,9 @@ hdd_image_close(uint8_t id)
     if (!hdd_images[id].loaded)
         return;
 
+    hdd_image_async_stop(id);
+    hdd_image_unmap(id);
+
     if (hdd_images[id].file != NULL) {
         fclose(hdd_images[id].file);
         hdd_images[id].file = NULL;
@@ -784,8 +1370,18 @@ hdd_image_sync(uint8_t id)
     if (!hdd_images[id].loaded)
         return;
 
-    if (hdd_images[id].file != NULL) {
+    if (hdd_images[id].map != NULL) {
+        hdd_image_map_sync(&hdd_images[id]);
+        fflush(hdd_images[id].file);
+    } else if (hdd_images[id].async != NULL) {
+        /* Drains the queue ahead of it, including write-back data. */
+        if (hdd_image_async_request(hdd_images[id].async, HDD_IO_SYNC, 0, 0, NULL) < 0)
+            hdd_image_log("Hard disk image %i: Sync failed\n", id);
+    } else if (hdd_images[id].file != NULL) {
         fflush(hdd_images[id].file);
+    } else if (hdd_images[id].vhd != NULL) {
+        /* Writes out the cached sector bitmaps and BAT entries. */
+        mvhd_flush(hdd_images[id].vhd);
     }
 }
 
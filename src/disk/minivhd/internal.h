@@ -59,12 +59,19 @@
 #define MVHD_DIF_LOC_W2KU      0x57326B75
 
 #define MVHD_START_TS          946684800
+#define MVHD_BITMAP_CACHE_SIZE 64 /* must be a power of two */
 
 
+typedef struct MVHDBitmapCacheEntry {
+    uint8_t* bitmap;
+    int      block; /* -1 if the entry is unused */
+    bool     dirty;
+} MVHDBitmapCacheEntry;
+
 typedef struct MVHDSectorBitmap {
-    uint8_t* curr_bitmap;
-    int      sector_count;
-    int      curr_block;
+    uint8_t*             cache_data;
+    int                  sector_count;
+    MVHDBitmapCacheEntry cache[MVHD_BITMAP_CACHE_SIZE];
 } MVHDSectorBitmap;
 
 typedef struct MVHDFooter {
@@ -121,6 +128,9 @@ struct MVHDMeta {
     MVHDFooter       footer;
     MVHDSparseHeader sparse;
     uint32_t*        block_offset;
+    bool             write_back;      /* defer bitmap and BAT writes until mvhd_flush() */
+    int              bat_dirty_first; /* range of BAT entries not yet written, or -1 */
+    int              bat_dirty_last;
     int              sect_per_block;
     MVHDSectorBitmap bitmap;
     int (*read_sectors)(struct MVHDMeta*, uint32_t, int, void*);
@@ -194,13 +194,22 @@ calc_sparse_values(MVHDMeta* vhdm)
 static int
 init_sector_bitmap(MVHDMeta* vhdm, MVHDError* err)
 {
-    vhdm->bitmap.curr_bitmap = calloc(vhdm->bitmap.sector_count, MVHD_SECTOR_SIZE);
-    if (vhdm->bitmap.curr_bitmap == NULL) {
+    size_t bm_size = (size_t) vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE;
+
+    vhdm->bitmap.cache_data = calloc(MVHD_BITMAP_CACHE_SIZE, bm_size);
+    if (vhdm->bitmap.cache_data == NULL) {
         *err = MVHD_ERR_MEM;
         return -1;
     }
 
-    vhdm->bitmap.curr_block = -1;
+    for (int i = 0; i < MVHD_BITMAP_CACHE_SIZE; i++) {
+        vhdm->bitmap.cache[i].bitmap = vhdm->bitmap.cache_data + (i * bm_size);
+        vhdm->bitmap.cache[i].block  = -1;
+        vhdm->bitmap.cache[i].dirty  = false;
+    }
+
+    vhdm->bat_dirty_first = -1;
+    vhdm->bat_dirty_last  = -1;
 
     return 0;
 }
@@ -595,8 +604,8 @@ cleanup_format_buff:
     vhdm->format_buffer.zero_data = NULL;
 
 cleanup_bitmap:
-    free(vhdm->bitmap.curr_bitmap);
-    vhdm->bitmap.curr_bitmap = NULL;
+    free(vhdm->bitmap.cache_data);
+    vhdm->bitmap.cache_data = NULL;
 
 cleanup_bat:
     free(vhdm->block_offset);
@@ -624,15 +633,16 @@ mvhd_close(MVHDMeta* vhdm)
     if (vhdm->parent != NULL)
         mvhd_close(vhdm->parent);
 
+    mvhd_flush(vhdm);
     fclose(vhdm->f);
 
     if (vhdm->block_offset != NULL) {
         free(vhdm->block_offset);
         vhdm->block_offset = NULL;
     }
-    if (vhdm->bitmap.curr_bitmap != NULL) {
-        free(vhdm->bitmap.curr_bitmap);
-        vhdm->bitmap.curr_bitmap = NULL;
+    if (vhdm->bitmap.cache_data != NULL) {
+        free(vhdm->bitmap.cache_data);
+        vhdm->bitmap.cache_data = NULL;
     }
     if (vhdm->format_buffer.zero_data != NULL) {
         free(vhdm->format_buffer.zero_data);
@@ -259,6 +259,29 @@ MVHDAPI MVHDMeta* mvhd_create_ex(MVHDCreationOptions options, int* err);
  */
 MVHDAPI void mvhd_close(MVHDMeta* vhdm);
 
+/**
+ * \brief Write cached metadata to the VHD file
+ *
+ * In write-back mode, sector bitmaps and BAT entries changed by writes are
+ * kept in memory, and only written out here. This is called by mvhd_close().
+ *
+ * \param [in] vhdm MiniVHD data structure
+ */
+MVHDAPI void mvhd_flush(MVHDMeta* vhdm);
+
+/**
+ * \brief Enable or disable write-back of the VHD metadata
+ *
+ * By default, the sector bitmaps and BAT entries changed by a write are
+ * written to the file before the write returns. With write-back enabled,
+ * they are only written by mvhd_flush(), or when a bitmap leaves the cache.
+ * Data written since the last flush may then be lost if the process dies.
+ *
+ * \param [in] vhdm MiniVHD data structure
+ * \param [in] write_back true to defer the metadata writes
+ */
+MVHDAPI void mvhd_set_write_back(MVHDMeta* vhdm, bool write_back);
+
 /**
  * \brief Calculate hard disk geometry from a provided size
  *
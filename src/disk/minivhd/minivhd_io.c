@@ -56,9 +56,9 @@
  *
  * http://www.mathcs.emory.edu/~cheung/Courses/255/Syllabus/1-C-intro/bit-array.html
  */
-#define VHD_SETBIT(A,k)     ( A[(k>>3)] |= (0x80 >> (k&7)) )
-#define VHD_CLEARBIT(A,k)   ( A[(k>>3)] &= ~(0x80 >> (k&7)) )
-#define VHD_TESTBIT(A,k)    ( A[(k>>3)] & (0x80 >> (k&7)) )
+#define VHD_SETBIT(A,k)     ( A[((k)>>3)] |= (0x80 >> ((k)&7)) )
+#define VHD_CLEARBIT(A,k)   ( A[((k)>>3)] &= ~(0x80 >> ((k)&7)) )
+#define VHD_TESTBIT(A,k)    ( A[((k)>>3)] & (0x80 >> ((k)&7)) )
 
 /**
  * \brief Check that we will not be overflowing buffers
@@ -96,64 +96,110 @@ mvhd_write_empty_sectors(FILE *f, int sector_count)
     return 1;
 }
 
+static void write_sect_bitmap(MVHDMeta *vhdm, MVHDBitmapCacheEntry *ent);
+
 /**
- * \brief Read the sector bitmap for a block.
+ * \brief Get the sector bitmap for a block from the bitmap cache.
  *
- * If the block is sparse, the sector bitmap in memory will be
- * zeroed. Otherwise, the sector bitmap is read from the VHD file.
+ * The cache is direct-mapped by block number. On a miss, the previous
+ * occupant of the entry is written back if it was modified, and the bitmap
+ * is read from the VHD file. If the block is sparse, the bitmap is zeroed.
  *
  * \param [in] vhdm MiniVHD data structure
- * \param [in] blk The block for which to read the sector bitmap from
+ * \param [in] blk The block for which to get the sector bitmap
+ *
+ * \return the cache entry holding the bitmap for blk
  */
-static void
-read_sect_bitmap(MVHDMeta *vhdm, int blk)
+static MVHDBitmapCacheEntry*
+get_sect_bitmap(MVHDMeta *vhdm, int blk)
 {
+    MVHDBitmapCacheEntry *ent = &vhdm->bitmap.cache[blk & (MVHD_BITMAP_CACHE_SIZE - 1)];
+
+    if (ent->block == blk)
+        return ent;
+
+    if (ent->dirty)
+        write_sect_bitmap(vhdm, ent);
+
     if (vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
         mvhd_fseeko64(vhdm->f, (uint64_t)vhdm->block_offset[blk] * MVHD_SECTOR_SIZE, SEEK_SET);
-        if (!fread(vhdm->bitmap.curr_bitmap, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE, 1, vhdm->f))
+        if (!fread(ent->bitmap, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE, 1, vhdm->f))
             vhdm->error = 1;
     } else
-        memset(vhdm->bitmap.curr_bitmap, 0, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+        memset(ent->bitmap, 0, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
 
-    vhdm->bitmap.curr_block = blk;
+    ent->block = blk;
+
+    return ent;
 }
 
 /**
- * \brief Write the current sector bitmap in memory to file
+ * \brief Write a cached sector bitmap to file
  *
  * \param [in] vhdm MiniVHD data structure
+ * \param [in] ent The bitmap cache entry to write
  */
 static void
-write_curr_sect_bitmap(MVHDMeta* vhdm)
+write_sect_bitmap(MVHDMeta *vhdm, MVHDBitmapCacheEntry *ent)
 {
-    if (vhdm->bitmap.curr_block >= 0) {
-        int64_t abs_offset = (int64_t)vhdm->block_offset[vhdm->bitmap.curr_block] * MVHD_SECTOR_SIZE;
-        if (mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET) == -1)
-            vhdm->error = 1;
-        if (!fwrite(vhdm->bitmap.curr_bitmap, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f))
-            vhdm->error = 1;
-    }
+    int64_t abs_offset = (int64_t)vhdm->block_offset[ent->block] * MVHD_SECTOR_SIZE;
+
+    if (mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET) == -1)
+        vhdm->error = 1;
+    if (!fwrite(ent->bitmap, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f))
+        vhdm->error = 1;
+
+    ent->dirty = false;
 }
 
 /**
- * \brief Write block offset from memory into file
+ * \brief Write the modified range of the BAT from memory into file
  *
  * \param [in] vhdm MiniVHD data structure
- * \param [in] blk The block for which to write the offset for
  */
 static void
-write_bat_entry(MVHDMeta *vhdm, int blk)
+write_bat(MVHDMeta *vhdm)
 {
-    uint64_t table_offset = vhdm->sparse.bat_offset + ((uint64_t)blk * sizeof *vhdm->block_offset);
-    uint32_t offset = mvhd_to_be32(vhdm->block_offset[blk]);
+    uint64_t table_offset = vhdm->sparse.bat_offset + ((uint64_t)vhdm->bat_dirty_first * sizeof *vhdm->block_offset);
+    uint32_t offset;
 
     if (mvhd_fseeko64(vhdm->f, table_offset, SEEK_SET) == -1)
         vhdm->error = 1;
-    if (!fwrite(&offset, sizeof offset, 1, vhdm->f))
-        vhdm->error = 1;
+    for (int blk = vhdm->bat_dirty_first; blk <= vhdm->bat_dirty_last; blk++) {
+        offset = mvhd_to_be32(vhdm->block_offset[blk]);
+        if (!fwrite(&offset, sizeof offset, 1, vhdm->f))
+            vhdm->error = 1;
+    }
+
+    vhdm->bat_dirty_first = -1;
+    vhdm->bat_dirty_last = -1;
+}
+
+MVHDAPI void
+mvhd_flush(MVHDMeta *vhdm)
+{
+    if (vhdm->bitmap.cache_data != NULL) {
+        for (int i = 0; i < MVHD_BITMAP_CACHE_SIZE; i++) {
+            if (vhdm->bitmap.cache[i].dirty)
+                write_sect_bitmap(vhdm, &vhdm->bitmap.cache[i]);
+        }
+
+        if (vhdm->bat_dirty_first >= 0)
+            write_bat(vhdm);
+    }
+
     fflush(vhdm->f);
 }
 
+MVHDAPI void
+mvhd_set_write_back(MVHDMeta *vhdm, bool write_back)
+{
+    if (vhdm->write_back && !write_back)
+        mvhd_flush(vhdm);
+
+    vhdm->write_back = write_back;
+}
+
 /**
  * \brief Create an empty block in a sparse or differencing VHD image
  *
@@ -211,11 +257,14 @@ create_block(MVHDMeta *vhdm, int blk)
     if (!fwrite(footer, sizeof footer, 1, vhdm->f))
         vhdm->error = 1;
 
-    /* We no longer have a sparse block. Update that BAT! */
+    /* We no longer have a sparse block. Update that BAT! The entry
+       itself is written out by mvhd_flush(), at the end of the write
+       unless write-back is enabled. */
     vhdm->block_offset[blk] = sect_offset;
-    write_bat_entry(vhdm, blk);
-
-    fflush(vhdm->f);
+    if ((vhdm->bat_dirty_first < 0) || (blk < vhdm->bat_dirty_first))
+        vhdm->bat_dirty_first = blk;
+    if (blk > vhdm->bat_dirty_last)
+        vhdm->bat_dirty_last = blk;
 }
 
 int
@@ -246,44 +295,78 @@ mvhd_sparse_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buf
     check_sectors(offset, num_sectors, total_sectors, &transfer_sectors, &truncated_sectors);
 
     uint8_t* buff = (uint8_t*)out_buff;
+    uint8_t* bitmap;
     int64_t addr = 0ULL;
     uint32_t s = 0;
     uint32_t ls = 0;
     int blk = 0;
-    int prev_blk = -1;
     int sib = 0;
+    int n = 0;
+    int i = 0;
+    int j = 0;
     ls = offset + transfer_sectors;
 
-    for (s = offset; s < ls; s++) {
+    for (s = offset; s < ls; s += n) {
         blk = s / vhdm->sect_per_block;
         sib = s % vhdm->sect_per_block;
-        if (blk != prev_blk) {
-            prev_blk = blk;
-            if (vhdm->bitmap.curr_block != blk) {
-                read_sect_bitmap(vhdm, blk);
-                if (mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR) == -1)
-                    vhdm->error = 1;
-            } else {
-                addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
+        n = vhdm->sect_per_block - sib;
+        if ((uint32_t) n > (ls - s))
+            n = ls - s;
+
+        if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK) {
+            memset(buff, 0, (size_t) n * MVHD_SECTOR_SIZE);
+            buff += n * MVHD_SECTOR_SIZE;
+            continue;
+        }
+
+        /* Transfer runs of present or absent sectors in one go. */
+        bitmap = get_sect_bitmap(vhdm, blk)->bitmap;
+        for (i = 0; i < n; i = j) {
+            bool present = VHD_TESTBIT(bitmap, sib + i) != 0;
+            for (j = i + 1; (j < n) && ((VHD_TESTBIT(bitmap, sib + j) != 0) == present); j++)
+                ;
+
+            if (present) {
+                addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib + i) *
                        MVHD_SECTOR_SIZE;
                 if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
                     vhdm->error = 1;
-            }
-        }
-
-        if (VHD_TESTBIT(vhdm->bitmap.curr_bitmap, sib)) {
-            if (!fread(buff, MVHD_SECTOR_SIZE, 1, vhdm->f) && !feof(vhdm->f))
-                vhdm->error = 1;
-        } else {
-            memset(buff, 0, MVHD_SECTOR_SIZE);
-            mvhd_fseeko64(vhdm->f, MVHD_SECTOR_SIZE, SEEK_CUR);
+                if (!fread(buff, (size_t) (j - i) * MVHD_SECTOR_SIZE, 1, vhdm->f) && !feof(vhdm->f))
+                    vhdm->error = 1;
+            } else
+                memset(buff, 0, (size_t) (j - i) * MVHD_SECTOR_SIZE);
+            buff += (j - i) * MVHD_SECTOR_SIZE;
         }
-        buff += MVHD_SECTOR_SIZE;
     }
 
     return truncated_sectors;
 }
 
+/**
+ * \brief Find the image in a differencing chain that holds a sector
+ *
+ * \param [in] vhdm MiniVHD data structure of the differencing image
+ * \param [in] s The sector to look up
+ *
+ * \return the first image in the chain whose sector bitmap has s set,
+ * or the fixed or dynamic image at the root of the chain
+ */
+static MVHDMeta*
+diff_sector_owner(MVHDMeta *vhdm, uint32_t s)
+{
+    int blk;
+
+    while (vhdm->footer.disk_type == MVHD_TYPE_DIFF) {
+        blk = s / vhdm->sect_per_block;
+        if ((vhdm->block_offset[blk] != MVHD_SPARSE_BLK) &&
+            VHD_TESTBIT(get_sect_bitmap(vhdm, blk)->bitmap, s % vhdm->sect_per_block))
+            break;
+        vhdm = vhdm->parent;
+    }
+
+    return vhdm;
+}
+
 int
 mvhd_diff_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buff)
 {
@@ -297,36 +380,29 @@ mvhd_diff_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buff)
     MVHDMeta *curr_vhdm = vhdm;
     uint32_t s = 0;
     uint32_t ls = 0;
-    int blk = 0;
-    int sib = 0;
+    int n = 0;
     ls = offset + transfer_sectors;
 
-    for (s = offset; s < ls; s++) {
-        while (curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) {
-            blk = s / curr_vhdm->sect_per_block;
-            sib = s % curr_vhdm->sect_per_block;
-            if (curr_vhdm->bitmap.curr_block != blk) {
-                read_sect_bitmap(curr_vhdm, blk);
-            }
-            if (!VHD_TESTBIT(curr_vhdm->bitmap.curr_bitmap, sib)) {
-                curr_vhdm = curr_vhdm->parent;
-            } else { break; }
-        }
+    for (s = offset; s < ls; s += n) {
+        /* Resolve the chain from the cached bitmaps, and read every run of
+           sectors held by the same image with a single call. */
+        curr_vhdm = diff_sector_owner(vhdm, s);
+        for (n = 1; ((s + n) < ls) && (diff_sector_owner(vhdm, s + n) == curr_vhdm); n++)
+            ;
 
         /* We handle actual sector reading using the fixed or sparse functions,
            as a differencing VHD is also a sparse VHD */
         if ((curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) ||
             (curr_vhdm->footer.disk_type == MVHD_TYPE_DYNAMIC))
-            mvhd_sparse_read(curr_vhdm, s, 1, buff);
+            mvhd_sparse_read(curr_vhdm, s, n, buff);
         else
-            mvhd_fixed_read(curr_vhdm, s, 1, buff);
+            mvhd_fixed_read(curr_vhdm, s, n, buff);
         if (curr_vhdm->error) {
             curr_vhdm->error = 0;
             vhdm->error = 1;
         }
 
-        curr_vhdm = vhdm;
-        buff += MVHD_SECTOR_SIZE;
+        buff += n * MVHD_SECTOR_SIZE;
     }
 
     return truncated_sectors;
@@ -362,55 +438,49 @@ mvhd_sparse_diff_write(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *i
     check_sectors(offset, num_sectors, total_sectors, &transfer_sectors, &truncated_sectors);
 
     uint8_t* buff = (uint8_t *) in_buff;
+    MVHDBitmapCacheEntry* ent;
     int64_t addr = 0ULL;
     uint32_t s = 0;
     uint32_t ls = 0;
     int blk = 0;
-    int prev_blk = -1;
     int sib = 0;
+    int n = 0;
     ls = offset + transfer_sectors;
 
     if (offset < total_sectors) {
-        for (s = offset; s < ls; s++) {
+        for (s = offset; s < ls; s += n) {
             blk = s / vhdm->sect_per_block;
             sib = s % vhdm->sect_per_block;
-            if (vhdm->bitmap.curr_block != blk && prev_blk >= 0) {
-                /* Write the sector bitmap for the previous block, before we replace it. */
-                write_curr_sect_bitmap(vhdm);
-            }
-
-            if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK) {
-                /* "read" the sector bitmap first, before creating a new block, as the bitmap will be
-                   zero either way */
-                read_sect_bitmap(vhdm, blk);
+            n = vhdm->sect_per_block - sib;
+            if ((uint32_t) n > (ls - s))
+                n = ls - s;
+
+            /* Get the sector bitmap first, before creating a new block, as the bitmap will be
+               zero either way */
+            ent = get_sect_bitmap(vhdm, blk);
+            if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK)
                 create_block(vhdm, blk);
-            }
-
-            if (blk != prev_blk) {
-                if (vhdm->bitmap.curr_block != blk) {
-                    read_sect_bitmap(vhdm, blk);
-                    if (mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR) == -1)
-                        vhdm->error = 1;
-                } else {
-                    addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
-                           MVHD_SECTOR_SIZE;
-                    if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
-                        vhdm->error = 1;
-                }
-                prev_blk = blk;
-            }
-
-            if (!fwrite(buff, MVHD_SECTOR_SIZE, 1, vhdm->f))
+
+            /* All the sectors falling into one block are written at once. The
+               bitmap is written out at the end, or in write-back mode, when it
+               leaves the cache or on flush. */
+            addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
+                   MVHD_SECTOR_SIZE;
+            if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
                 vhdm->error = 1;
-            VHD_SETBIT(vhdm->bitmap.curr_bitmap, sib);
-            buff += MVHD_SECTOR_SIZE;
+            if (!fwrite(buff, (size_t) n * MVHD_SECTOR_SIZE, 1, vhdm->f))
+                vhdm->error = 1;
+
+            for (int i = 0; i < n; i++)
+                VHD_SETBIT(ent->bitmap, sib + i);
+            ent->dirty = true;
+
+            buff += n * MVHD_SECTOR_SIZE;
         }
     }
 
-    /* And write the sector bitmap for the last block we visited to disk */
-    write_curr_sect_bitmap(vhdm);
-
-    fflush(vhdm->f);
+    if (!vhdm->write_back)
+        mvhd_flush(vhdm);
 
     return truncated_sectors;
 }
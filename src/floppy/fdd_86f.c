@@ -2174,7 +2174,7 @@ d86f_turbo_read(int drive, int side)
     uint8_t dat         = 0;
     int     recv_data   = 0;
     int     read_status = 0;
-    uint8_t flags       = d86f_sector_flags(drive, side, dev->req_sector.id.c, dev->req_sector.id.h, dev->req_sector.id.r, dev->req_sector.id.n);
+    uint8_t flags;
 
     if (d86f_handler[drive].read_data != NULL)
         dat = d86f_handler[drive].read_data(drive, side, dev->turbo_pos);
@@ -2199,6 +2199,7 @@ d86f_turbo_read(int drive, int side)
     dev->turbo_pos++;
 
     if (dev->turbo_pos >= (128UL << dev->req_sector.id.n)) {
+        flags = d86f_sector_flags(drive, side, dev->req_sector.id.c, dev->req_sector.id.h, dev->req_sector.id.r, dev->req_sector.id.n);
         dev->data_find.sync_marks = dev->data_find.bits_obtained = dev->data_find.bytes_obtained = 0;
         if ((flags & SECTOR_CRC_ERROR) && (dev->state != STATE_02_READ_DATA)) {
 #ifdef ENABLE_D86F_LOG
@@ -2318,6 +2319,46 @@ d86f_sector_is_present(int drive, int side, uint8_t c, uint8_t h, uint8_t r, uin
     return 0;
 }
 
+/* Transfer the data of the current sector. With DMA, the whole sector is
+   transferred in one poll, otherwise the host gets one byte per poll. */
+static void
+d86f_turbo_transfer(int drive, int side)
+{
+    d86f_t *dev   = d86f[drive];
+    int     state = dev->state;
+
+    switch (state) {
+        case STATE_16_VERIFY_DATA:
+            /* Nothing is transferred to the host, skip to the last byte. */
+            dev->turbo_pos = (128UL << dev->req_sector.id.n) - 1;
+            d86f_turbo_read(drive, side);
+            break;
+
+        case STATE_02_READ_DATA:
+        case STATE_06_READ_DATA:
+        case STATE_0C_READ_DATA:
+        case STATE_11_SCAN_DATA:
+            if (fdc_is_dma(d86f_fdc))
+                while (dev->state == state)
+                    d86f_turbo_read(drive, side);
+            else
+                d86f_turbo_read(drive, side);
+            break;
+
+        case STATE_05_WRITE_DATA:
+        case STATE_09_WRITE_DATA:
+            if (fdc_is_dma(d86f_fdc))
+                while (dev->state == state)
+                    d86f_turbo_write(drive, side);
+            else
+                d86f_turbo_write(drive, side);
+            break;
+
+        default:
+            break;
+    }
+}
+
 void
 d86f_turbo_poll(int drive, int side)
 {
@@ -2356,7 +2397,8 @@ d86f_turbo_poll(int drive, int side)
             dev->last_sector.id.n = fdc_get_read_track_sector(d86f_fdc).id.n;
             d86f_handler[drive].set_sector(drive, side, dev->last_sector.id.c, dev->last_sector.id.h, dev->last_sector.id.r, dev->last_sector.id.n);
             dev->turbo_pos = 0;
-            dev->state++;
+            dev->state     = STATE_02_READ_DATA;
+            d86f_turbo_transfer(drive, side);
             return;
 
         case STATE_05_FIND_ID:
@@ -2381,7 +2423,11 @@ d86f_turbo_poll(int drive, int side)
             dev->last_sector.id.r = dev->req_sector.id.r;
             dev->last_sector.id.n = dev->req_sector.id.n;
             d86f_handler[drive].set_sector(drive, side, dev->last_sector.id.c, dev->last_sector.id.h, dev->last_sector.id.r, dev->last_sector.id.n);
-            fallthrough;
+            /* There are no address marks to look for, go straight to the data. */
+            dev->turbo_pos = 0;
+            dev->state += (STATE_06_READ_DATA - STATE_06_FIND_ID);
+            d86f_turbo_transfer(drive, side);
+            return;
 
         case STATE_0A_FIND_ID:
             dev->turbo_pos = 0;
@@ -2419,20 +2465,9 @@ d86f_turbo_poll(int drive, int side)
         case STATE_0C_READ_DATA:
         case STATE_11_SCAN_DATA:
         case STATE_16_VERIFY_DATA:
-            if (fdc_is_dma(d86f_fdc))
-                for (int i = 0; i < (128 << dev->last_sector.id.n); i++)
-                    d86f_turbo_read(drive, side);
-            else
-                d86f_turbo_read(drive, side);
-            break;
-
         case STATE_05_WRITE_DATA:
         case STATE_09_WRITE_DATA:
-            if (fdc_is_dma(d86f_fdc))
-                for (int i = 0; i < (128 << dev->last_sector.id.n); i++)
-                    d86f_turbo_write(drive, side);
-            else
-                d86f_turbo_write(drive, side);
+            d86f_turbo_transfer(drive, side);
             break;
 
         case STATE_0D_FORMAT_TRACK:
@@ -155,6 +155,8 @@ extern int video_fps; /* (O) render speed in fps */
 #endif
 extern int settings_only;     /* (O) show only the settings dialog */
 extern int confirm_exit_cmdl; /* (O) do not ask for confirmation on quit if set to 0 */
+extern int benchmark_seconds; /* (O) emulated seconds to benchmark for */
+extern int benchmark_profile; /* (O) profile handlers during the benchmark */
 #ifdef _WIN32
 extern uint64_t unique_id;
 extern uint64_t source_hwnd;
@@ -214,10 +216,15 @@ extern uint32_t mem_size;                   /* (C) memory size (Installed on sys
 extern uint32_t isa_mem_size;               /* (C) memory size (ISA Memory Cards) */
 extern int      cpu;                        /* (C) cpu type */
 extern int      cpu_use_dynarec;            /* (C) cpu uses/needs Dyna */
+extern int      cpu_dynarec_chaining;       /* (C) jump directly between recompiled blocks */
+extern int      cpu_idle_skip;              /* (C) skip to the next timer when the CPU is halted */
 extern int      fpu_type;                   /* (C) fpu type */
 extern int      fpu_softfloat;              /* (C) fpu uses softfloat */
 extern int      time_sync;                  /* (C) enable time sync */
 extern int      hdd_format_type;            /* (C) hard disk file format */
+extern int      hdd_image_async;            /* (C) hard disk image I/O on a worker thread */
+extern int      hdd_image_write_back;       /* (C) defer hard disk image writes until sync */
+extern int      hdd_image_mmap;             /* (C) map hard disk images into memory */
 extern int      confirm_reset;              /* (G) enable reset confirmation */
 extern int      confirm_exit;               /* (G) enable exit confirmation */
 extern int      confirm_save;               /* (G) enable save confirmation */
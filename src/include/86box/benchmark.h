@@ -0,0 +1,30 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Definitions for the headless benchmark mode.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#ifndef EMU_BENCHMARK_H
+#define EMU_BENCHMARK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void benchmark_start(void);
+extern int  benchmark_done(void);
+extern void benchmark_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*EMU_BENCHMARK_H*/
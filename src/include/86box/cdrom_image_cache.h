@@ -0,0 +1,20 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          CD-ROM image read-ahead cache header.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#ifndef CDROM_IMAGE_CACHE_H
+#define CDROM_IMAGE_CACHE_H
+
+extern void image_cache_init(track_file_t *tf);
+
+#endif /*CDROM_IMAGE_CACHE_H*/
@@ -214,6 +214,7 @@ extern int      hdd_image_load(int id);
 extern int      hdd_image_seek(uint8_t id, uint32_t sector);
 extern int      hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern int      hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern void     hdd_image_prefetch(uint8_t id, uint32_t sector, uint32_t count);
 extern int      hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern int      hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern int      hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count);
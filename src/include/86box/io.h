@@ -19,6 +19,8 @@
 #define EMU_IO_H
 
 extern void io_init(void);
+extern void io_set_direct(int enable);
+extern int  io_port_free(uint16_t port);
 
 extern void io_sethandler_common(uint16_t base, int size,
                                  uint8_t (*inb)(uint16_t addr, void *priv),
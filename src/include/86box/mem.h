@@ -295,6 +295,7 @@ extern int shadowbios;
 extern int shadowbios_write;
 extern int readlnum;
 extern int writelnum;
+extern int mmuflush;
 
 extern int memspeed[11];
 
@@ -417,6 +418,8 @@ extern void     mem_writeb_phys(uint32_t addr, uint8_t val);
 extern void     mem_writew_phys(uint32_t addr, uint16_t val);
 extern void     mem_writel_phys(uint32_t addr, uint32_t val);
 extern void     mem_write_phys(void *src, uint32_t addr, int tranfer_size);
+extern void     mem_read_phys_range(void *dest, uint32_t addr, uint32_t len, int transfer_size);
+extern void     mem_write_phys_range(const void *src, uint32_t addr, uint32_t len, int transfer_size);
 
 extern uint8_t  mem_read_ram(uint32_t addr, void *priv);
 extern uint16_t mem_read_ramw(uint32_t addr, void *priv);
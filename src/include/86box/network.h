@@ -54,9 +54,12 @@
 #define NET_TYPE_NRSWITCH 6 /* use the remote switch provider */
 
 #define NET_MAX_FRAME  1518
-/* Queue size must be a power of 2 */
+/* Number of packets the host drivers move per batch */
 #define NET_QUEUE_LEN      16
-#define NET_QUEUE_LEN_MASK (NET_QUEUE_LEN - 1)
+/* Queue depth, configurable, always rounded up to a power of 2 */
+#define NET_QUEUE_DEPTH_DEF 64
+#define NET_QUEUE_DEPTH_MIN 16
+#define NET_QUEUE_DEPTH_MAX 1024
 #define NET_QUEUE_COUNT    4
 #define NET_CARD_MAX       4
 #define NET_HOST_INTF_MAX  64
@@ -103,6 +106,7 @@ typedef struct netcard_conf_t {
 
 extern netcard_conf_t net_cards_conf[NET_CARD_MAX];
 extern uint16_t       net_card_current;
+extern int            net_queue_depth;
 extern int            slirp_card_num;
 
 typedef int (*NETRXCB)(void *, uint8_t *, int);
@@ -113,11 +117,15 @@ typedef struct netpkt {
     int      len;
 } netpkt_t;
 
-typedef struct netqueue_t {
-    netpkt_t packets[NET_QUEUE_LEN];
-    int      head;
-    int      tail;
-} netqueue_t;
+/* Single-producer/single-consumer packet ring, private to network.c. */
+typedef struct netqueue_t netqueue_t;
+
+typedef struct netqueue_stats_t {
+    uint32_t depth;
+    uint32_t used;  /* packets queued right now */
+    uint32_t peak;  /* highest number of packets queued at once */
+    uint32_t drops; /* packets discarded because the queue was full */
+} netqueue_stats_t;
 
 typedef struct _netcard_t netcard_t;
 
@@ -141,9 +149,8 @@ struct _netcard_t {
     struct netdrv_t host_drv;
     NETRXCB         rx;
     NETSETLINKSTATE set_link_state;
-    netqueue_t      queues[NET_QUEUE_COUNT];
+    netqueue_t     *queues[NET_QUEUE_COUNT];
     netpkt_t        queued_pkt;
-    mutex_t        *tx_mutex;
     mutex_t        *rx_mutex;
     pc_timer_t      timer;
     uint16_t        card_num;
@@ -215,6 +222,9 @@ extern int network_rx_on_tx_put(netcard_t *card, uint8_t *bufp, int len);
 extern int network_rx_put_pkt(netcard_t *card, netpkt_t *pkt);
 extern int network_rx_on_tx_put_pkt(netcard_t *card, netpkt_t *pkt);
 
+extern void       network_queue_get_stats(netcard_t *card, int queue, netqueue_stats_t *stats);
+extern netcard_t *network_get_card(int card_num);
+
 #ifdef EMU_DEVICE_H
 /* 3Com Etherlink */
 extern const device_t threec501_device;
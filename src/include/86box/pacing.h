@@ -0,0 +1,52 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Definitions for the main loop frame pacer.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#ifndef EMU_PACING_H
+#define EMU_PACING_H
+
+/* If the emulation falls more than this far behind, drop the backlog. */
+#define PACING_MAX_LAG_NS 50000000ULL
+
+/* Maximum number of slices the pacer will wait for in one host sleep. */
+#define PACING_MAX_BATCH 4
+
+typedef struct pacing_stats_t {
+    uint64_t slices;           /* Slices run since the pacer was started. */
+    uint64_t wakeups;          /* Times the pacer found slices due. */
+    uint64_t sleeps;           /* Host sleeps performed. */
+    uint64_t late;             /* Wakeups more than one slice late. */
+    uint64_t resyncs;          /* Times the backlog was dropped. */
+    uint64_t drift_avg_ns;     /* Average lateness of a wakeup. */
+    uint64_t drift_max_ns;     /* Worst lateness of a wakeup. */
+    uint64_t oversleep_avg_ns; /* Average host sleep overshoot. */
+    uint64_t oversleep_max_ns; /* Worst host sleep overshoot. */
+    int      batch;            /* Current number of slices per wakeup. */
+} pacing_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void pacing_reset(void);
+extern int  pacing_due(void);
+extern void pacing_advance(void);
+extern void pacing_sleep(void);
+extern void pacing_get_stats(pacing_stats_t *stats);
+extern void pacing_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*EMU_PACING_H*/
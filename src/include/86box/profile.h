@@ -0,0 +1,75 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Definitions for the per-device host time profiler.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#ifndef EMU_PROFILE_H
+#define EMU_PROFILE_H
+
+#define PROFILE_MAX_ENTRIES 4096 /* Must be a power of two. */
+#define PROFILE_NAME_LEN    64
+
+enum {
+    PROFILE_TIMER = 0,       /* Timer callbacks. */
+    PROFILE_IO_IN,           /* I/O port read handlers. */
+    PROFILE_IO_OUT,          /* I/O port write handlers. */
+    PROFILE_MEM_READ,        /* Memory mapping read handlers. */
+    PROFILE_MEM_WRITE,       /* Memory mapping write handlers. */
+    PROFILE_CODEGEN_COMPILE, /* Dynarec block compilation. */
+    PROFILE_CODEGEN_EXEC,    /* Dynarec compiled block execution. */
+    PROFILE_CODEGEN_INTERP,  /* Dynarec first pass, interpreted. */
+    PROFILE_SOUND,           /* Sound get_buffer handlers. */
+    PROFILE_KINDS
+};
+
+/* One profiled handler. Times are inclusive, so a timer callback that runs
+   the sound handlers is charged for them as well. */
+typedef struct profile_entry_t {
+    int         kind;
+    const void *func;
+    const void *priv;
+    uint64_t    calls;
+    uint64_t    ns;
+    uint64_t    max_ns;
+    char        name[PROFILE_NAME_LEN];
+} profile_entry_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int profile_on;       /* (C) Profiling enabled. */
+extern int profile_interval; /* (C) Seconds between summaries, 0 = none. */
+
+extern const char *profile_kind_names[PROFILE_KINDS];
+
+extern uint64_t profile_now(void);
+extern void     profile_end(int kind, const void *func, const void *priv, uint64_t start);
+extern void     profile_set(int on);
+extern void     profile_reset(void);
+extern void     profile_tick(void);
+extern void     profile_dump(void);
+extern int      profile_get_entries(profile_entry_t *entries, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Start timing a handler call, returns 0 if profiling is off. The matching
+   profile_end() must only be called if this returned non-zero. */
+static __inline uint64_t
+profile_start(void)
+{
+    return profile_on ? profile_now() : 0;
+}
+
+#endif /*EMU_PROFILE_H*/
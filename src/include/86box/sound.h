@@ -57,6 +57,7 @@ extern int music_pos_global;
 extern int wavetable_pos_global;
 
 extern int sound_card_current[SOUND_CARD_MAX];
+extern int sound_card_gain[SOUND_CARD_MAX];
 
 extern void sound_add_handler(void (*get_buffer)(int32_t *buffer,
                                                  int len, void *priv),
@@ -19,6 +19,10 @@ extern uint64_t tsc;
 #define TIMER_SPLIT   2
 #define TIMER_ENABLED 1
 
+/* Timer queue implementations, selected at timer_init() time. */
+#define TIMER_SCHED_LIST 0 /* Sorted doubly-linked list, O(n) insertion. */
+#define TIMER_SCHED_HEAP 1 /* Binary min-heap, O(log n) insertion and removal. */
+
 /*Timers are based on the CPU Time Stamp Counter. Timer timestamps are in a
   32:32 fixed point format, with the integer part compared against the TSC. The
   fractional part is used when advancing the timestamp to ensure a more accurate
@@ -44,6 +48,10 @@ typedef struct pc_timer_t {
 
     struct pc_timer_t *prev;
     struct pc_timer_t *next;
+
+    uint32_t heap_idx; /* Position in the heap, only valid while enabled. */
+    uint64_t heap_seq; /* Insertion sequence, used to break ties in the heap
+                          the same way the sorted list does. */
 } pc_timer_t;
 
 #ifdef __cplusplus
@@ -66,6 +74,10 @@ extern void timer_process(void);
 extern void timer_close(void);
 extern void timer_init(void);
 
+/*Timer queue implementation requested by the configuration (TIMER_SCHED_*),
+  takes effect on the next timer_init()*/
+extern int timer_scheduler;
+
 /*Add new timer. If start_timer is set, timer will be enabled with a zero
   timestamp - this is useful for permanently enabled timers*/
 extern void timer_add(pc_timer_t *timer, void (*callback)(void *priv), void *priv, int start_timer);
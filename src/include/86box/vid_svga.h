@@ -116,9 +116,11 @@ typedef struct svga_t {
     int lastline_draw;
     int displine;
     int fullchange;
+    int cursorchange; /* Frames left to redraw the old and new text cursor lines. */
     int left_overscan;
     int x_add;
     int y_add;
+    int blit_y_add;
     int pan;
     int vram_display_mask;
     int vidclock;
@@ -170,7 +172,10 @@ typedef struct svga_t {
     uint32_t  extra_banks[2];
     uint32_t  banked_mask;
     uint32_t  cursoraddr;
+    uint32_t  cursoraddr_prev; /* Text cursor address before it last changed. */
+    uint32_t  cursorshape;     /* CRTC 0x0a/0x0b as of the last frame. */
     uint32_t  overscan_color;
+    uint32_t  blit_overscan_color; /* Overscan color at the last blit. */
     uint32_t *map8;
     uint32_t  pallook[512];
 
@@ -269,6 +274,7 @@ typedef struct svga_t {
     uint8_t dac_status;
     uint8_t dpms;
     uint8_t dpms_ui;
+    uint8_t blit_dpms;
     uint8_t color_2bpp;
     uint8_t ksc5601_sbyte_mask;
     uint8_t ksc5601_udc_area_msb[2];
@@ -376,6 +382,8 @@ extern int  svga_init(const device_t *info, svga_t *svga, void *priv, int memsiz
 extern void svga_recalctimings(svga_t *svga);
 extern void svga_close(svga_t *svga);
 
+extern uint32_t svga_conv_16to32(struct svga_t *svga, uint16_t color, uint8_t bpp);
+
 uint8_t  svga_read(uint32_t addr, void *priv);
 uint16_t svga_readw(uint32_t addr, void *priv);
 uint32_t svga_readl(uint32_t addr, void *priv);
@@ -71,6 +71,14 @@ extern void svga_render_ABGR8888_highres(svga_t *svga);
 extern void svga_render_RGBA8888_lowres(svga_t *svga);
 extern void svga_render_RGBA8888_highres(svga_t *svga);
 
+extern void           svga_render_simd_init(void);
+extern const uint8_t *svga_render_linear_src(svga_t *svga, uint32_t bytes);
+extern void           svga_render_line_15to32(uint32_t *p, const uint8_t *src, int count);
+extern void           svga_render_line_16to32(uint32_t *p, const uint8_t *src, int count);
+extern void           svga_render_line_24to32(uint32_t *p, const uint8_t *src, int count);
+extern void           svga_render_line_32to32(uint32_t *p, const uint8_t *src, int count);
+extern void           svga_render_line_8to32(uint32_t *p, const uint8_t *src, const uint32_t *pal, uint8_t mask, int count);
+
 extern void ibm8514_render_blank(svga_t *svga);
 extern void ibm8514_render_8bpp(svga_t *svga);
 extern void ibm8514_render_15bpp(svga_t *svga);
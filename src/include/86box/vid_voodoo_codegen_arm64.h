@@ -61,8 +61,6 @@
 #include <stdint.h>
 #include <string.h>
 
-#define BLOCK_NUM  32
-#define BLOCK_MASK (BLOCK_NUM - 1)
 #define BLOCK_SIZE 16384
 
 #define LOD_MASK (LOD_TMIRROR_S | LOD_TMIRROR_T)
@@ -116,41 +114,6 @@
  * that emit BL or BLR instructions.
  */
 
-/*
- * voodoo_arm64_data_t -- cache slot for one compiled pixel pipeline block.
- *
- * Each slot holds:
- *   code_block  -- pointer into MAP_JIT executable memory (BLOCK_SIZE bytes)
- *   <key fields> -- the hardware register state that uniquely identifies
- *                   the compiled pipeline variant (mirrors voodoo_x86_data_t)
- *   last_used   -- LRU timestamp (monotonic per-partition generation counter).
- *                  On hit, set to ++voodoo->jit_generation[partition].
- *                  On reject, set to 0 so the slot is evicted first.
- *   valid       -- 1 if code_block holds valid compiled code
- *   rejected    -- 1 if this variant was rejected (emit overflow, W^X failure)
- *                  Rejected slots return NULL from voodoo_get_block() without
- *                  retrying JIT compilation.
- */
-typedef struct voodoo_arm64_data_t {
-    uint8_t *code_block;
-    uint64_t last_used;
-    int      xdir;
-    uint32_t alphaMode;
-    uint32_t fbzMode;
-    uint32_t fogMode;
-    uint32_t fbzColorPath;
-    uint32_t textureMode[2];
-    uint32_t tLOD[2];
-    uint32_t trexInit1;
-    int      is_tiled;
-    int      valid;
-    int      rejected;
-} voodoo_arm64_data_t;
-
-/* LRU generation counter per partition (4 partitions = odd_even).
- * Per-instance in voodoo_t so SLI cards don't share eviction state.
- * Thread-safe: each partition is touched by exactly one render thread. */
-
 /* Linux ARM64 without PROT_MPROTECT: pages are born RWX, so mprotect
  * toggles in set_writable/set_executable are redundant syscalls that
  * only cost TLB shootdowns.  Skip them at compile time. */
@@ -160,8 +123,6 @@ static int arm64_jit_rwx = 1;  /* Linux: born RWX, skip mprotect */
 static int arm64_jit_rwx = 0;
 #endif
 
-/* jit_last_block[4] is in voodoo_t for MRU-hint fast probe. */
-
 /* ========================================================================
  * Emission primitive -- ARM64 instructions are always 4 bytes
  * ======================================================================== */
@@ -4448,24 +4409,6 @@ arm64_codegen_set_executable(uint8_t *code_block)
 #endif
 }
 
-static inline void
-arm64_codegen_store_cache_key(voodoo_arm64_data_t *data, voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int valid, int rejected)
-{
-    data->xdir           = state->xdir;
-    data->alphaMode      = params->alphaMode;
-    data->fbzMode        = params->fbzMode;
-    data->fogMode        = params->fogMode;
-    data->fbzColorPath   = params->fbzColorPath;
-    data->trexInit1      = voodoo->trexInit1[0] & (1 << 18);
-    data->textureMode[0] = params->textureMode[0];
-    data->textureMode[1] = params->textureMode[1];
-    data->tLOD[0]        = params->tLOD[0] & LOD_MASK;
-    data->tLOD[1]        = params->tLOD[1] & LOD_MASK;
-    data->is_tiled       = (params->col_tiled || params->aux_tiled) ? 1 : 0;
-    data->valid          = valid;
-    data->rejected       = rejected;
-}
-
 /*
  * ========================================================================
  * JIT BLOCK CACHE + COMPILATION
@@ -4480,16 +4423,16 @@ arm64_codegen_store_cache_key(voodoo_arm64_data_t *data, voodoo_t *voodoo, voodo
  * for the active pipeline stages. This is dramatically faster than the
  * C interpreter, which must check every option on every pixel.
  *
- * Blocks are cached in a 32-entry LRU cache per partition. When the game
- * changes rendering state (e.g., switches from opaque to transparent
- * objects), a new block is compiled for the new state. On miss, the
- * least-recently-used slot is evicted. Most games use only a handful of
- * distinct pipeline configurations per frame.
+ * Blocks are kept in the shared pipeline cache (vid_voodoo_jit.c), hashed
+ * on the full state key and shared by all render threads of the card.
+ * When the game changes rendering state (e.g., switches from opaque to
+ * transparent objects), a new block is compiled for the new state. On miss,
+ * the least-recently-used block that no render thread is drawing with is
+ * recycled. Most games use only a handful of distinct pipeline
+ * configurations per frame, so with a few hundred blocks recompiles are rare.
  *
- * Array layout: contiguous per-partition (partition * BLOCK_NUM + slot).
- * This keeps all 32 slots for one partition in adjacent memory, reducing
- * cache line footprint during the linear scan from ~125 lines (interleaved)
- * to ~36 lines (contiguous) on a 64-byte cache line architecture.
+ * Each block has its own BLOCK_SIZE mapping so that W^X transitions on
+ * one block never affect code another render thread is executing.
  *
  * On macOS ARM64, the JIT must handle W^X (write-xor-execute) memory
  * protection: code pages are made writable for compilation, then switched
@@ -4503,105 +4446,75 @@ arm64_codegen_store_cache_key(voodoo_arm64_data_t *data, voodoo_t *voodoo, voodo
  * voodoo_get_block() -- find or JIT-compile a pixel pipeline block.
  *
  * Algorithm:
- *   1. Probe starting at jit_last_block[odd_even] (MRU hint), scanning all
- *      32 slots for a cached block whose key matches the current state.
- *   2. On hit: update LRU timestamp, update MRU hint, return code_block.
- *   3. On miss: scan all 32 slots for the one with the smallest last_used
- *      (LRU eviction), then JIT-compile into that slot:
+ *   1. If the block this render thread used last matches the current state,
+ *      return it without locking (the thread holds a reference to it).
+ *   2. Otherwise look the key up in the shared hash table. On hit, return
+ *      the cached block, or NULL while another thread is still compiling it.
+ *   3. On miss, the cache reserves its LRU victim and releases the lock, and
+ *      the block is JIT-compiled, then published by voodoo_jit_compiled():
  *      a. Make code page writable (W^X toggle).
- *      b. Call voodoo_generate() to emit ARM64 into data->code_block.
+ *      b. Call voodoo_generate() to emit ARM64 into block->code.
  *      c. Check for emit overflow (block exceeded BLOCK_SIZE).
  *      d. Make code page executable and flush I-cache (narrow range).
- *   4. On reject (W^X fail or emit overflow): set last_used = 0 so the
- *      slot is evicted first on the next miss.
- *   5. Return the compiled code_block pointer, or NULL for interpreter fallback.
+ *   4. On reject (W^X fail or emit overflow): the block is marked rejected so
+ *      that the state falls back to the interpreter without retrying.
+ *   5. Return the compiled code pointer, or NULL for interpreter fallback.
  *
- * odd_even selects the partition (0-3). Array layout is contiguous:
- * slot index = odd_even * BLOCK_NUM + probe.
+ * odd_even is the render thread index.
  */
 static inline void *
 voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even)
 {
-    int                  b                 = voodoo->jit_last_block[odd_even];
-    int                  base              = odd_even * BLOCK_NUM;
-    voodoo_arm64_data_t *voodoo_arm64_data = voodoo->codegen_data;
-    voodoo_arm64_data_t *data;
-
-    /* --- Cache lookup: linear scan from MRU hint --- */
-    for (uint8_t c = 0; c < BLOCK_NUM; c++) {
-        int probe = (b + c) & BLOCK_MASK;
-        data      = &voodoo_arm64_data[base + probe];
-
-        if ((data->valid || data->rejected)
-            && state->xdir == data->xdir
-            && params->alphaMode == data->alphaMode
-            && params->fbzMode == data->fbzMode
-            && params->fogMode == data->fogMode
-            && params->fbzColorPath == data->fbzColorPath
-            && (voodoo->trexInit1[0] & (1 << 18)) == data->trexInit1
-            && params->textureMode[0] == data->textureMode[0]
-            && params->textureMode[1] == data->textureMode[1]
-            && (params->tLOD[0] & LOD_MASK) == data->tLOD[0]
-            && (params->tLOD[1] & LOD_MASK) == data->tLOD[1]
-            && ((params->col_tiled || params->aux_tiled) ? 1 : 0) == data->is_tiled) {
-            if (data->rejected)
-                return NULL;
-
-            /* LRU: stamp this slot as most-recently-used */
-            data->last_used                  = ++voodoo->jit_generation[odd_even];
-            voodoo->jit_last_block[odd_even] = probe;
-            return data->code_block;
-        }
-    }
-
-    /* --- Cache miss: find LRU victim --- */
-    {
-        int      lru_slot = 0;
-        uint64_t lru_min  = voodoo_arm64_data[base].last_used;
-        for (int s = 1; s < BLOCK_NUM; s++) {
-            if (voodoo_arm64_data[base + s].last_used < lru_min) {
-                lru_min  = voodoo_arm64_data[base + s].last_used;
-                lru_slot = s;
-            }
-        }
-        data = &voodoo_arm64_data[base + lru_slot];
-    }
+    voodoo_jit_cache_t *cache = voodoo->jit_cache;
+    voodoo_jit_block_t *block;
+    voodoo_jit_key_t    key;
+    int                 compile;
+    int                 code_size;
+
+    voodoo_jit_make_key(&key, voodoo, params, state->xdir);
+
+    /* --- Fast path: this thread's current block --- */
+    block = voodoo_jit_current(cache, odd_even, &key);
+    if (block)
+        return voodoo_jit_code(block);
+
+    /* --- Shared cache lookup --- */
+    block = voodoo_jit_lookup(cache, odd_even, &key, &compile);
+    if (!block)
+        return NULL;
+    if (!compile)
+        return voodoo_jit_code(block);
 
     /* W^X: make code page writable before JIT emission. */
-    if (!arm64_codegen_set_writable(data->code_block)) {
-        arm64_codegen_store_cache_key(data, voodoo, params, state, 0, 1);
-        data->last_used = 0;
+    if (!arm64_codegen_set_writable(block->code)) {
+        voodoo_jit_compiled(cache, block, 0);
         return NULL;
     }
 
-    int code_size = voodoo_generate(data->code_block, voodoo, params, state, depth_op);
+    code_size = voodoo_generate(block->code, voodoo, params, state, depth_op);
 
     if (arm64_codegen_emit_overflowed()) {
-        arm64_codegen_store_cache_key(data, voodoo, params, state, 0, 1);
-        data->last_used = 0;
-        arm64_codegen_set_executable(data->code_block);
+        arm64_codegen_set_executable(block->code);
+        voodoo_jit_compiled(cache, block, 0);
         return NULL;
     }
 
-    arm64_codegen_store_cache_key(data, voodoo, params, state, 1, 0);
-    data->last_used                  = ++voodoo->jit_generation[odd_even];
-    voodoo->jit_last_block[odd_even] = (int) (data - &voodoo_arm64_data[base]);
-
     /* W^X: make executable, flush I-cache (narrow range = actual code size) */
-    if (!arm64_codegen_set_executable(data->code_block)) {
-        arm64_codegen_store_cache_key(data, voodoo, params, state, 0, 1);
-        data->last_used = 0;
+    if (!arm64_codegen_set_executable(block->code)) {
+        voodoo_jit_compiled(cache, block, 0);
         return NULL;
     }
 #if defined(__aarch64__) || defined(_M_ARM64)
 #    ifdef _WIN32
-    FlushInstructionCache(GetCurrentProcess(), data->code_block, code_size);
+    FlushInstructionCache(GetCurrentProcess(), block->code, code_size);
 #    else
-    __clear_cache((char *) data->code_block, (char *) data->code_block + code_size);
+    __clear_cache((char *) block->code, (char *) block->code + code_size);
 #    endif
 #endif
 
-    return data->code_block;
+    voodoo_jit_compiled(cache, block, 1);
+
+    return block->code;
 }
 
 /*
@@ -4611,8 +4524,8 @@ voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *stat
  * One-time setup when the emulated Voodoo card is initialized:
  *
  * 1. Allocate executable memory (MAP_JIT on macOS) for compiled blocks.
- *    Each block gets BLOCK_SIZE bytes. Total allocation covers all cache
- *    slots across both render targets (odd/even double-buffering).
+ *    Each block of the shared pipeline cache gets its own BLOCK_SIZE
+ *    mapping; the number of blocks is the card's "jit_cache_size" option.
  *
  * 2. Build lookup tables used by the compiled code at runtime:
  *    - alookup[256]: alpha multiply factors {a, a, a, a} as NEON halfwords
@@ -4631,52 +4544,21 @@ voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *stat
 void
 voodoo_codegen_init(voodoo_t *voodoo)
 {
-    voodoo_arm64_data_t *voodoo_arm64_data;
-    uint32_t             slot;
+    voodoo_jit_cache_t *cache;
+    int                 slot;
 
-    voodoo->codegen_data = plat_mmap(sizeof(voodoo_arm64_data_t) * BLOCK_NUM * 4, 0);
-    if (!voodoo->codegen_data) {
-        fatal("ARM64 JIT: failed to allocate codegen metadata buffer\n");
-    }
-    voodoo_arm64_data = voodoo->codegen_data;
-    memset(voodoo_arm64_data, 0, sizeof(voodoo_arm64_data_t) * BLOCK_NUM * 4);
-
-    for (slot = 0; slot < (uint32_t) (BLOCK_NUM * 4); slot++) {
-        voodoo_arm64_data[slot].code_block = plat_mmap(BLOCK_SIZE, 1);
-        if (!voodoo_arm64_data[slot].code_block) {
-            while (slot > 0) {
-                slot--;
-                if (voodoo_arm64_data[slot].code_block) {
-                    plat_munmap(voodoo_arm64_data[slot].code_block, BLOCK_SIZE);
-                    voodoo_arm64_data[slot].code_block = NULL;
-                }
-            }
-            plat_munmap(voodoo_arm64_data, sizeof(voodoo_arm64_data_t) * BLOCK_NUM * 4);
-            voodoo->codegen_data = NULL;
+    cache = voodoo->jit_cache = voodoo_jit_init(voodoo->jit_cache_size);
+
+    for (slot = 0; slot < cache->nr_blocks; slot++) {
+        cache->blocks[slot].code = plat_mmap(BLOCK_SIZE, 1);
+        if (!cache->blocks[slot].code)
             fatal("ARM64 JIT: failed to allocate executable code block\n");
-        }
 #if !defined(__APPLE__) || !defined(__aarch64__)
-        if (!arm64_codegen_set_executable(voodoo_arm64_data[slot].code_block)) {
-            plat_munmap(voodoo_arm64_data[slot].code_block, BLOCK_SIZE);
-            voodoo_arm64_data[slot].code_block = NULL;
-            while (slot > 0) {
-                slot--;
-                if (voodoo_arm64_data[slot].code_block) {
-                    plat_munmap(voodoo_arm64_data[slot].code_block, BLOCK_SIZE);
-                    voodoo_arm64_data[slot].code_block = NULL;
-                }
-            }
-            plat_munmap(voodoo_arm64_data, sizeof(voodoo_arm64_data_t) * BLOCK_NUM * 4);
-            voodoo->codegen_data = NULL;
+        if (!arm64_codegen_set_executable(cache->blocks[slot].code))
             fatal("ARM64 JIT: failed to set code block executable\n");
-        }
 #endif
     }
 
-    /* Initialize per-instance JIT cache state */
-    memset(voodoo->jit_last_block, 0, sizeof(voodoo->jit_last_block));
-    memset(voodoo->jit_generation, 0, sizeof(voodoo->jit_generation));
-
     for (uint16_t c = 0; c < 256; c++) {
         int d[4];
         int _ds = c & 0xf;
@@ -4768,22 +4650,21 @@ voodoo_codegen_init(voodoo_t *voodoo)
 void
 voodoo_codegen_close(voodoo_t *voodoo)
 {
-    voodoo_arm64_data_t *voodoo_arm64_data = voodoo->codegen_data;
-    uint32_t             slot;
+    voodoo_jit_cache_t *cache = voodoo->jit_cache;
 
-    if (!voodoo_arm64_data) {
+    if (!cache) {
         return;
     }
 
-    for (slot = 0; slot < (uint32_t) (BLOCK_NUM * 4); slot++) {
-        if (voodoo_arm64_data[slot].code_block) {
-            plat_munmap(voodoo_arm64_data[slot].code_block, BLOCK_SIZE);
-            voodoo_arm64_data[slot].code_block = NULL;
+    for (int slot = 0; slot < cache->nr_blocks; slot++) {
+        if (cache->blocks[slot].code) {
+            plat_munmap(cache->blocks[slot].code, BLOCK_SIZE);
+            cache->blocks[slot].code = NULL;
         }
     }
 
-    plat_munmap(voodoo_arm64_data, sizeof(voodoo_arm64_data_t) * BLOCK_NUM * 4);
-    voodoo->codegen_data = NULL;
+    voodoo_jit_close(cache);
+    voodoo->jit_cache = NULL;
 }
 
 #endif /* VIDEO_VOODOO_CODEGEN_ARM64_H */
@@ -10,8 +10,6 @@
 
 #include <xmmintrin.h>
 
-#define BLOCK_NUM  8
-#define BLOCK_MASK (BLOCK_NUM - 1)
 #define BLOCK_SIZE 8192
 
 #define LOD_MASK   (LOD_TMIRROR_S | LOD_TMIRROR_T)
@@ -21,26 +19,6 @@
 #    pragma GCC diagnostic ignored "-Wstringop-overflow"
 #endif
 
-typedef struct voodoo_x86_data_t {
-    uint8_t  code_block[BLOCK_SIZE];
-    int      xdir;
-    uint32_t alphaMode;
-    uint32_t fbzMode;
-    uint32_t fogMode;
-    uint32_t fbzColorPath;
-    uint32_t textureMode[2];
-    uint32_t tLOD[2];
-    uint32_t trexInit1;
-    int      is_tiled;
-} voodoo_x86_data_t;
-
-#if 0
-static voodoo_x86_data_t voodoo_x86_data[2][BLOCK_NUM];
-#endif
-
-static int last_block[4]          = { 0, 0 };
-static int next_block_to_write[4] = { 0, 0 };
-
 #define addbyte(val)                   \
     do {                               \
         code_block[block_pos++] = val; \
@@ -3487,49 +3465,37 @@ int voodoo_recomp = 0;
 static inline void *
 voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even)
 {
-    int                b               = last_block[odd_even];
-    voodoo_x86_data_t *voodoo_x86_data = voodoo->codegen_data;
-    voodoo_x86_data_t *data;
+    voodoo_jit_block_t *block;
+    voodoo_jit_key_t    key;
+    int                 compile;
 
-    for (uint8_t c = 0; c < 8; c++) {
-        data = &voodoo_x86_data[odd_even + c * 4]; //&voodoo_x86_data[odd_even][b];
+    voodoo_jit_make_key(&key, voodoo, params, state->xdir);
 
-        if (state->xdir == data->xdir && params->alphaMode == data->alphaMode && params->fbzMode == data->fbzMode && params->fogMode == data->fogMode && params->fbzColorPath == data->fbzColorPath && (voodoo->trexInit1[0] & (1 << 18)) == data->trexInit1 && params->textureMode[0] == data->textureMode[0] && params->textureMode[1] == data->textureMode[1] && (params->tLOD[0] & LOD_MASK) == data->tLOD[0] && (params->tLOD[1] & LOD_MASK) == data->tLOD[1] && ((params->col_tiled || params->aux_tiled) ? 1 : 0) == data->is_tiled) {
-            last_block[odd_even] = b;
-            return data->code_block;
-        }
+    block = voodoo_jit_current(voodoo->jit_cache, odd_even, &key);
+    if (!block) {
+        block = voodoo_jit_lookup(voodoo->jit_cache, odd_even, &key, &compile);
+        if (!block)
+            return NULL;
 
-        b = (b + 1) & 7;
+        if (compile) {
+            voodoo_generate(block->code, voodoo, params, state, depth_op);
+            voodoo_jit_compiled(voodoo->jit_cache, block, 1);
+        }
     }
-    voodoo_recomp++;
-    data = &voodoo_x86_data[odd_even + next_block_to_write[odd_even] * 4];
-#if 0
-    code_block = data->code_block;
-#endif
-
-    voodoo_generate(data->code_block, voodoo, params, state, depth_op);
 
-    data->xdir           = state->xdir;
-    data->alphaMode      = params->alphaMode;
-    data->fbzMode        = params->fbzMode;
-    data->fogMode        = params->fogMode;
-    data->fbzColorPath   = params->fbzColorPath;
-    data->trexInit1      = voodoo->trexInit1[0] & (1 << 18);
-    data->textureMode[0] = params->textureMode[0];
-    data->textureMode[1] = params->textureMode[1];
-    data->tLOD[0]        = params->tLOD[0] & LOD_MASK;
-    data->tLOD[1]        = params->tLOD[1] & LOD_MASK;
-    data->is_tiled       = (params->col_tiled || params->aux_tiled) ? 1 : 0;
-
-    next_block_to_write[odd_even] = (next_block_to_write[odd_even] + 1) & 7;
-
-    return data->code_block;
+    return voodoo_jit_code(block);
 }
 
 void
 voodoo_codegen_init(voodoo_t *voodoo)
 {
-    voodoo->codegen_data = plat_mmap(sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4, 1);
+    voodoo->jit_cache    = voodoo_jit_init(voodoo->jit_cache_size);
+    voodoo->codegen_data = plat_mmap(BLOCK_SIZE * voodoo->jit_cache->nr_blocks, 1);
+    if (!voodoo->codegen_data)
+        fatal("Voodoo JIT: failed to allocate code buffer\n");
+
+    for (int c = 0; c < voodoo->jit_cache->nr_blocks; c++)
+        voodoo->jit_cache->blocks[c].code = (uint8_t *) voodoo->codegen_data + (c * BLOCK_SIZE);
 
     for (uint16_t c = 0; c < 256; c++) {
         int d[4];
@@ -3555,7 +3521,10 @@ voodoo_codegen_init(voodoo_t *voodoo)
 void
 voodoo_codegen_close(voodoo_t *voodoo)
 {
-    plat_munmap(voodoo->codegen_data, sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4);
+    plat_munmap(voodoo->codegen_data, BLOCK_SIZE * voodoo->jit_cache->nr_blocks);
+    voodoo_jit_close(voodoo->jit_cache);
+    voodoo->codegen_data = NULL;
+    voodoo->jit_cache    = NULL;
 }
 
 #endif /*VIDEO_VOODOO_CODEGEN_X86_64_H*/
@@ -27,7 +27,15 @@
 
 #define TEX_DIRTY_SHIFT 10
 
-#define TEX_CACHE_MAX   64
+/* Cached textures are indexed by the 64 kB blocks of texture memory they
+   were decoded from, so that writes only have to check a few of them. */
+#define TEX_INDEX_SHIFT 16
+#define TEX_INDEX_SIZE  (16384 >> (TEX_INDEX_SHIFT - TEX_DIRTY_SHIFT))
+
+#define TEX_CACHE_MAX     576 /* Largest configurable size plus the spare entries. */
+#define TEX_CACHE_DEFAULT 64
+#define TEX_CACHE_SPARE   16  /* Allocated rather than stalling while all are queued. */
+#define TEX_HASH_SIZE     2048
 
 enum {
     VOODOO_1 = 0,
@@ -97,6 +105,10 @@ enum {
 #define PARAM_MASK       (PARAM_SIZE - 1)
 #define PARAM_ENTRY_SIZE (1 << 31)
 
+/* Maximum number of render threads per card; params_threads[] holds one bit
+   per thread. */
+#define VOODOO_MAX_RENDER_THREADS 16
+
 /* On ARM64, params/busy fields are cache-line padded to prevent false sharing
    between render threads. These accessors hide the .value indirection. */
 #if (defined __aarch64__ || defined _M_ARM64)
@@ -245,12 +257,14 @@ typedef struct texture_t {
     uint32_t   base;
     uint32_t   tLOD;
     ATOMIC_INT refcount;
-    ATOMIC_INT refcount_r[4];
+    ATOMIC_INT refcount_r[VOODOO_MAX_RENDER_THREADS];
     int        is16;
     uint32_t   palette_checksum;
     uint32_t   addr_start[4];
     uint32_t   addr_end[4];
     uint32_t  *data;
+    uint64_t   last_used;
+    int        hash_next;
 } texture_t;
 
 typedef struct vert_t {
@@ -277,6 +291,12 @@ typedef struct clip_t {
     int y_max;
 } clip_t;
 
+/* Argument passed to each render thread. */
+typedef struct voodoo_render_thread_param_t {
+    struct voodoo_t *voodoo;
+    int              index;
+} voodoo_render_thread_param_t;
+
 typedef struct voodoo_t {
     mem_mapping_t mapping;
 
@@ -373,14 +393,14 @@ typedef struct voodoo_t {
     int    ncc_dirty[2];
 
     thread_t *fifo_thread;
-    thread_t *render_thread[4];
+    thread_t *render_thread[VOODOO_MAX_RENDER_THREADS];
     event_t  *wake_fifo_thread;
     event_t  *wake_main_thread;
     event_t  *fifo_not_full_event;
     event_t  *fifo_empty_event;
     ATOMIC_INT fifo_empty_signaled;
-    event_t  *render_not_full_event[4];
-    event_t  *wake_render_thread[4];
+    event_t  *render_not_full_event[VOODOO_MAX_RENDER_THREADS];
+    event_t  *wake_render_thread[VOODOO_MAX_RENDER_THREADS];
 
     int voodoo_busy;
 #if (defined __aarch64__ || defined _M_ARM64)
@@ -389,20 +409,21 @@ typedef struct voodoo_t {
     struct {
         int value;
         char pad[128 - sizeof(int)];
-    } render_voodoo_busy[4];
+    } render_voodoo_busy[VOODOO_MAX_RENDER_THREADS];
 #else
-    int render_voodoo_busy[4];
+    int render_voodoo_busy[VOODOO_MAX_RENDER_THREADS];
 #endif
 
     int render_threads;
-    int odd_even_mask;
 
-    int pixel_count[4];
-    int texel_count[4];
+    voodoo_render_thread_param_t render_thread_param[VOODOO_MAX_RENDER_THREADS];
+
+    int pixel_count[VOODOO_MAX_RENDER_THREADS];
+    int texel_count[VOODOO_MAX_RENDER_THREADS];
     int tri_count;
     int frame_count;
-    int pixel_count_old[4];
-    int texel_count_old[4];
+    int pixel_count_old[VOODOO_MAX_RENDER_THREADS];
+    int texel_count_old[VOODOO_MAX_RENDER_THREADS];
     int wr_count;
     int rd_count;
     int tex_count;
@@ -435,19 +456,22 @@ typedef struct voodoo_t {
     ATOMIC_INT   pending_draw_cmds_buf[VOODOO_BUF_COUNT];
 
     voodoo_params_t params_buffer[PARAM_SIZE];
+    /* Render threads that own at least one scanline of each queued triangle;
+       the others skip it without setting it up. */
+    uint32_t        params_threads[PARAM_SIZE];
 #if (defined __aarch64__ || defined _M_ARM64)
     /* Each params index is on its own 128-byte cache line to prevent false
        sharing between render threads and the FIFO/CPU thread. */
     struct {
         ATOMIC_INT value;
         char       pad[128 - sizeof(ATOMIC_INT)];
-    } params_read_idx[4];
+    } params_read_idx[VOODOO_MAX_RENDER_THREADS];
     struct {
         ATOMIC_INT value;
         char       pad[128 - sizeof(ATOMIC_INT)];
     } params_write_idx;
 #else
-    ATOMIC_INT      params_read_idx[4];
+    ATOMIC_INT      params_read_idx[VOODOO_MAX_RENDER_THREADS];
     ATOMIC_INT      params_write_idx;
 #endif
 
@@ -702,14 +726,18 @@ typedef struct voodoo_t {
     uint16_t purpleline[256][3];
 
     texture_t texture_cache[2][TEX_CACHE_MAX];
+    int       texture_cache_size;  /* Textures kept before recycling the oldest. */
+    int       texture_cache_count[2];
+    int       texture_hash[2][TEX_HASH_SIZE];
+    uint64_t  texture_index[2][TEX_INDEX_SIZE][TEX_CACHE_MAX / 64];
+    uint64_t  texture_generation;
     uint8_t   texture_present[2][16384];
-    int       texture_last_removed;
 
     uint32_t palette_checksum[2];
     int      palette_dirty[2];
 
     uint64_t time;
-    int      render_time[4];
+    int      render_time[VOODOO_MAX_RENDER_THREADS];
     uint64_t fifo_full_waits;
     uint64_t fifo_full_wait_ticks;
     uint64_t fifo_full_spin_checks;
@@ -744,15 +772,15 @@ typedef struct voodoo_t {
     int   use_recompiler;
     void *codegen_data;
 
-    /* JIT cache state -- per-instance to avoid races between render threads */
-    int jit_last_block[4];
-    uint64_t jit_generation[4];
+    /* Compiled pipelines, shared by all render threads of this card */
+    int                       jit_cache_size;
+    struct voodoo_jit_cache_t *jit_cache;
     struct voodoo_set_t *set;
 
     uint32_t launch_pending;
 
     uint8_t fifo_thread_run;
-    uint8_t render_thread_run[4];
+    uint8_t render_thread_run[VOODOO_MAX_RENDER_THREADS];
 
     uint8_t *vram;
     uint8_t *changedvram;
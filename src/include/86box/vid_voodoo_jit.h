@@ -0,0 +1,137 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Definitions for the Voodoo compiled pipeline cache.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#ifndef VIDEO_VOODOO_JIT_H
+#define VIDEO_VOODOO_JIT_H
+
+/* Everything the generated pixel pipeline depends on. All fields are 32 bits
+   wide so that the key has no padding and can be hashed and compared as a
+   block of memory. */
+typedef struct voodoo_jit_key_t {
+    int32_t  xdir;
+    uint32_t alphaMode;
+    uint32_t fbzMode;
+    uint32_t fogMode;
+    uint32_t fbzColorPath;
+    uint32_t textureMode[2];
+    uint32_t tLOD[2];
+    uint32_t trexInit1;
+    uint32_t is_tiled;
+} voodoo_jit_key_t;
+
+enum {
+    VOODOO_JIT_EMPTY = 0,
+    VOODOO_JIT_COMPILING, /* Reserved, code not generated yet. */
+    VOODOO_JIT_VALID,
+    VOODOO_JIT_REJECTED /* Could not be compiled, use the interpreter. */
+};
+
+typedef struct voodoo_jit_block_t {
+    voodoo_jit_key_t key;
+    uint32_t         hash;
+    ATOMIC_INT       state;    /* Read without the lock by threads using the block. */
+    int              refcount; /* Render threads currently using the block. */
+    uint8_t         *code;     /* Owned by the codegen backend. */
+
+    struct voodoo_jit_block_t *hash_next;
+    struct voodoo_jit_block_t *lru_prev;
+    struct voodoo_jit_block_t *lru_next;
+} voodoo_jit_block_t;
+
+typedef struct voodoo_jit_stats_t {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t recompiles;
+    uint64_t evictions;
+    uint64_t rejects;
+    int      blocks;
+    int      used;
+} voodoo_jit_stats_t;
+
+/* One cache per card, shared by all of its render threads. Each thread keeps
+   a reference to the block it used last, which it can reuse without taking
+   the lock as long as the state does not change; a referenced block is
+   never evicted. The hits counted on that path are folded into hits under
+   the lock. Everything else is protected by the lock, except compiling,
+   which runs unlocked on a block reserved as VOODOO_JIT_COMPILING. */
+typedef struct voodoo_jit_cache_t {
+    mutex_t            *lock;
+    voodoo_jit_block_t *blocks;
+    int                 nr_blocks;
+    int                 used;
+    voodoo_jit_block_t **hash;
+    uint32_t            hash_mask;
+    voodoo_jit_block_t *lru_head; /* Most recently used. */
+    voodoo_jit_block_t *lru_tail;
+
+    voodoo_jit_block_t *current[VOODOO_MAX_RENDER_THREADS];
+    ATOMIC_UINT         current_hits[VOODOO_MAX_RENDER_THREADS];
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t recompiles;
+    uint64_t evictions;
+    uint64_t rejects;
+
+    struct voodoo_jit_cache_t *next; /* All caches, for voodoo_jit_get_total_stats(). */
+} voodoo_jit_cache_t;
+
+extern voodoo_jit_cache_t *voodoo_jit_init(int nr_blocks);
+extern void                voodoo_jit_close(voodoo_jit_cache_t *cache);
+extern voodoo_jit_block_t *voodoo_jit_lookup(voodoo_jit_cache_t *cache, int thread,
+                                             const voodoo_jit_key_t *key, int *compile);
+extern void                voodoo_jit_compiled(voodoo_jit_cache_t *cache, voodoo_jit_block_t *block, int ok);
+extern void                voodoo_jit_get_stats(voodoo_jit_cache_t *cache, voodoo_jit_stats_t *stats);
+extern void                voodoo_jit_get_total_stats(voodoo_jit_stats_t *stats);
+
+static __inline void
+voodoo_jit_make_key(voodoo_jit_key_t *key, voodoo_t *voodoo, voodoo_params_t *params, int xdir)
+{
+    key->xdir           = xdir;
+    key->alphaMode      = params->alphaMode;
+    key->fbzMode        = params->fbzMode;
+    key->fogMode        = params->fogMode;
+    key->fbzColorPath   = params->fbzColorPath;
+    key->textureMode[0] = params->textureMode[0];
+    key->textureMode[1] = params->textureMode[1];
+    key->tLOD[0]        = params->tLOD[0] & (LOD_TMIRROR_S | LOD_TMIRROR_T);
+    key->tLOD[1]        = params->tLOD[1] & (LOD_TMIRROR_S | LOD_TMIRROR_T);
+    key->trexInit1      = voodoo->trexInit1[0] & (1 << 18);
+    key->is_tiled       = (params->col_tiled || params->aux_tiled) ? 1 : 0;
+}
+
+/* Return the block the render thread used last if it still matches the key.
+   The thread holds a reference to it, so no locking is needed. */
+static __inline voodoo_jit_block_t *
+voodoo_jit_current(voodoo_jit_cache_t *cache, int thread, const voodoo_jit_key_t *key)
+{
+    voodoo_jit_block_t *block = cache->current[thread];
+
+    if (block && !memcmp(&block->key, key, sizeof(voodoo_jit_key_t))) {
+        ATOMIC_INC(cache->current_hits[thread]);
+        return block;
+    }
+
+    return NULL;
+}
+
+/* Return the code of a block, or NULL if it is still being compiled or could
+   not be compiled, in which case the interpreter is used. */
+static __inline void *
+voodoo_jit_code(voodoo_jit_block_t *block)
+{
+    return (ATOMIC_LOAD(block->state) == VOODOO_JIT_VALID) ? block->code : NULL;
+}
+
+#endif /*VIDEO_VOODOO_JIT_H*/
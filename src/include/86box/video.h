@@ -118,6 +118,9 @@ typedef struct dbcs_font_t {
 
 struct blit_data_struct;
 
+/* Damage is tracked per line of the 2048-line target buffer, one bit each. */
+#define VIDEO_DIRTY_WORDS (2048 / 32)
+
 typedef struct monitor_t {
     char                     name[512];
     int                      mon_xsize;
@@ -130,7 +133,8 @@ typedef struct monitor_t {
     double                   mon_res_x;
     double                   mon_res_y;
     int                      mon_bpp;
-    bitmap_t                *target_buffer;
+    bitmap_t                *target_buffer; /* Buffer the emulation draws to. */
+    bitmap_t                *blit_buffer;   /* Last complete frame, handed to the frontend. */
     int                      mon_video_timing_read_b;
     int                      mon_video_timing_read_w;
     int                      mon_video_timing_read_l;
@@ -143,6 +147,7 @@ typedef struct monitor_t {
     int                      mon_fullchange;
     int                      mon_changeframecount;
     int                      mon_renderedframes;
+    uint64_t                 mon_blits; /* Blits since the emulator was started. */
     atomic_int               mon_actualrenderedframes;
     atomic_int               mon_screenshots;
     atomic_int               mon_screenshots_clipboard;
@@ -157,6 +162,7 @@ typedef struct monitor_t {
     atomic_bool              mon_interlace;
     atomic_bool              mon_composite;
     struct blit_data_struct *mon_blit_data_ptr;
+    uint32_t                 mon_dirty[VIDEO_DIRTY_WORDS]; /* Lines changed since the last blit. */
 } monitor_t;
 
 typedef struct monitor_settings_t {
@@ -281,9 +287,13 @@ extern void video_blit_memtoscreen_8(int x, int y, int w, int h);
 extern void video_blend_monitor(int x, int y, int monitor_index);
 extern void video_process_8_monitor(int x, int y, int monitor_index);
 extern void video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index);
+extern void video_blit_memtoscreen_dirty_monitor(int x, int y, int w, int h, int monitor_index);
+extern int  video_blit_add_dirty_monitor(uint32_t *dirty, int monitor_index);
 extern void video_blit_complete_monitor(int monitor_index);
 extern void video_wait_for_blit_monitor(int monitor_index);
 extern void video_wait_for_buffer_monitor(int monitor_index);
+extern void video_wait_for_buffer_dirty_monitor(int monitor_index);
+extern void video_sync_line_monitor(int line, int monitor_index);
 
 extern bitmap_t *create_bitmap(int w, int h);
 extern void      destroy_bitmap(bitmap_t *b);
@@ -29,6 +29,7 @@
 #include "x86.h"
 #include <86box/m_amstrad.h>
 #include <86box/pci.h>
+#include <86box/profile.h>
 
 #define NPORTS 65536 /* PC/AT supports 64K ports */
 
@@ -54,9 +55,33 @@ typedef struct {
     void     *priv;
 } io_trap_t;
 
-int   initialized = 0;
-io_t *io[NPORTS];
-io_t *io_last[NPORTS];
+/* Per-port dispatch entries, rebuilt whenever handlers are added or removed.
+   An entry is only set when exactly one handler serves the whole access at
+   that port, so it can be called directly with no list walk and no byte or
+   word splitting; otherwise it is NULL and the lists are walked. */
+typedef struct {
+    io_t *inb;
+    io_t *inw;
+    io_t *inl;
+    io_t *outb;
+    io_t *outw;
+    io_t *outl;
+} io_direct_t;
+
+/* Handlers on a port that force word or dword accesses to be split, as
+   returned by io_port_kinds(). */
+#define IO_KIND_INB_SPLIT   0x01 /* inb without inw, splits word reads */
+#define IO_KIND_INB_SPLITL  0x02 /* inb without inw or inl, splits dword reads */
+#define IO_KIND_INW_SPLITL  0x04 /* inw without inl, splits dword reads */
+#define IO_KIND_OUTB_SPLIT  0x10 /* outb without outw, splits word writes */
+#define IO_KIND_OUTB_SPLITL 0x20 /* outb without outw or outl, splits dword writes */
+#define IO_KIND_OUTW_SPLITL 0x40 /* outw without outl, splits dword writes */
+
+int                initialized = 0;
+io_t              *io[NPORTS];
+io_t              *io_last[NPORTS];
+static io_direct_t io_direct[NPORTS];
+static int         io_direct_on = 1;
 
 #ifdef ENABLE_IO_LOG
 int io_do_log = ENABLE_IO_LOG;
@@ -76,6 +101,115 @@ io_log(const char *fmt, ...)
 #    define io_log(fmt, ...)
 #endif
 
+static int
+io_port_kinds(uint16_t port)
+{
+    int kinds = 0;
+
+    for (io_t *p = io[port]; p; p = p->next) {
+        if (p->inb && !p->inw)
+            kinds |= IO_KIND_INB_SPLIT;
+        if (p->inb && !p->inw && !p->inl)
+            kinds |= IO_KIND_INB_SPLITL;
+        if (p->inw && !p->inl)
+            kinds |= IO_KIND_INW_SPLITL;
+
+        if (p->outb && !p->outw)
+            kinds |= IO_KIND_OUTB_SPLIT;
+        if (p->outb && !p->outw && !p->outl)
+            kinds |= IO_KIND_OUTB_SPLITL;
+        if (p->outw && !p->outl)
+            kinds |= IO_KIND_OUTW_SPLITL;
+    }
+
+    return kinds;
+}
+
+/* Rebuild the dispatch entry of a single port from the handler lists of it
+   and the up to three ports following it. */
+static void
+io_direct_update(uint16_t port)
+{
+    io_direct_t *d = &io_direct[port];
+    io_t        *single[6] = { NULL, NULL, NULL, NULL, NULL, NULL };
+    int          count[6]  = { 0, 0, 0, 0, 0, 0 };
+    int          kinds[4];
+
+    if (!io_direct_on) {
+        memset(d, 0x00, sizeof(io_direct_t));
+        return;
+    }
+
+    for (io_t *p = io[port]; p; p = p->next) {
+        if (p->inb) {
+            single[0] = p;
+            count[0]++;
+        }
+        if (p->inw) {
+            single[1] = p;
+            count[1]++;
+        }
+        if (p->inl) {
+            single[2] = p;
+            count[2]++;
+        }
+        if (p->outb) {
+            single[3] = p;
+            count[3]++;
+        }
+        if (p->outw) {
+            single[4] = p;
+            count[4]++;
+        }
+        if (p->outl) {
+            single[5] = p;
+            count[5]++;
+        }
+    }
+
+    for (uint8_t i = 0; i < 4; i++)
+        kinds[i] = io_port_kinds((port + i) & 0xffff);
+
+    d->inb  = (count[0] == 1) ? single[0] : NULL;
+    d->outb = (count[3] == 1) ? single[3] : NULL;
+
+    /* Word accesses go direct only if no byte handler has to be split in. */
+    d->inw  = ((count[1] == 1) && !((kinds[0] | kinds[1]) & IO_KIND_INB_SPLIT)) ? single[1] : NULL;
+    d->outw = ((count[4] == 1) && !((kinds[0] | kinds[1]) & IO_KIND_OUTB_SPLIT)) ? single[4] : NULL;
+
+    /* Likewise for dword accesses and any word or byte handler. */
+    d->inl  = ((count[2] == 1) && !((kinds[0] | kinds[2]) & IO_KIND_INW_SPLITL) &&
+              !((kinds[0] | kinds[1] | kinds[2] | kinds[3]) & IO_KIND_INB_SPLITL)) ? single[2] : NULL;
+    d->outl = ((count[5] == 1) && !((kinds[0] | kinds[2]) & IO_KIND_OUTW_SPLITL) &&
+              !((kinds[0] | kinds[1] | kinds[2] | kinds[3]) & IO_KIND_OUTB_SPLITL)) ? single[5] : NULL;
+}
+
+/* A change to the handlers of a port also affects the word and dword
+   entries of the three ports preceding it. */
+static void
+io_direct_update_range(uint16_t base, int size)
+{
+    for (int c = -3; c < size; c++)
+        io_direct_update((base + c) & 0xffff);
+}
+
+/* Turn the dispatch entries on or off, so the benchmark can time the handler
+   list walk that they bypass. */
+void
+io_set_direct(int enable)
+{
+    io_direct_on = enable;
+
+    for (int c = 0; c < NPORTS; c++)
+        io_direct_update(c);
+}
+
+int
+io_port_free(uint16_t port)
+{
+    return io[port] == NULL;
+}
+
 void
 io_init(void)
 {
@@ -105,6 +239,8 @@ io_init(void)
         /* io[c] should be NULL. */
         io[c] = io_last[c] = NULL;
     }
+
+    memset(io_direct, 0x00, sizeof(io_direct));
 }
 
 void
@@ -146,6 +282,8 @@ io_sethandler_common(uint16_t base, int size,
 
         q = NULL;
     }
+
+    io_direct_update_range(base, size);
 }
 
 void
@@ -183,6 +321,8 @@ io_removehandler_common(uint16_t base, int size,
             p = q;
         }
     }
+
+    io_direct_update_range(base, size);
 }
 
 void
@@ -331,6 +471,24 @@ io_debug_check_addr(uint16_t addr)
 }
 #endif
 
+/* Charge a port access to the first handler on the port, PCI configuration
+   accesses included. */
+static void
+io_profile_end(int kind, uint16_t port, uint64_t start)
+{
+    const io_t *p    = io[port];
+    const void *func = NULL;
+
+    if (p != NULL) {
+        if (kind == PROFILE_IO_IN)
+            func = p->inb ? (const void *) p->inb : (p->inw ? (const void *) p->inw : (const void *) p->inl);
+        else
+            func = p->outb ? (const void *) p->outb : (p->outw ? (const void *) p->outw : (const void *) p->outl);
+    }
+
+    profile_end(kind, func, p ? p->priv : NULL, start);
+}
+
 uint8_t
 inb(uint16_t port)
 {
@@ -338,11 +496,13 @@ inb(uint16_t port)
     io_t   *p;
     io_t   *q;
     int     found  = 0;
+    uint64_t prof;
 #ifdef ENABLE_IO_LOG
     int     qfound = 0;
 #endif
 
     io_port = port;
+    prof    = profile_start();
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
@@ -359,6 +519,12 @@ inb(uint16_t port)
         found = 1;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
+#endif
+    } else if ((p = io_direct[port].inb) != NULL) {
+        ret = p->inb(port, p->priv);
+        found = 1;
+#ifdef ENABLE_IO_LOG
+        qfound = 1;
 #endif
     } else {
         p = io[port];
@@ -393,6 +559,9 @@ inb(uint16_t port)
         ret = 0xfe;
 #endif
 
+    if (prof)
+        io_profile_end(PROFILE_IO_IN, port, prof);
+
     io_log("[%04X:%08X] (%i, %i, %04i) in b(%04X) = %02X\n", CS, cpu_state.pc, in_smm, found, qfound, port, ret);
 
     return ret;
@@ -404,12 +573,14 @@ outb(uint16_t port, uint8_t val)
     io_t *p;
     io_t *q;
     int   found  = 0;
+    uint64_t prof;
 #ifdef ENABLE_IO_LOG
     int   qfound = 0;
 #endif
 
     io_port = port;
     io_val  = val;
+    prof    = profile_start();
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
@@ -426,6 +597,12 @@ outb(uint16_t port, uint8_t val)
         found = 1;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
+#endif
+    } else if ((p = io_direct[port].outb) != NULL) {
+        p->outb(port, val, p->priv);
+        found = 1;
+#ifdef ENABLE_IO_LOG
+        qfound = 1;
 #endif
     } else {
         p = io[port];
@@ -450,6 +627,9 @@ outb(uint16_t port, uint8_t val)
 #endif
     }
 
+    if (prof)
+        io_profile_end(PROFILE_IO_OUT, port, prof);
+
     io_log("[%04X:%08X] (%i, %i, %04i) outb(%04X, %02X)\n", CS, cpu_state.pc, in_smm, found, qfound, port, val);
 
     return;
@@ -462,12 +642,14 @@ inw(uint16_t port)
     io_t    *q;
     uint16_t ret    = 0xffff;
     int      found  = 0;
+    uint64_t prof;
 #ifdef ENABLE_IO_LOG
     int      qfound = 0;
 #endif
     uint8_t  ret8[2];
 
     io_port = port;
+    prof    = profile_start();
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
@@ -484,6 +666,12 @@ inw(uint16_t port)
         found = 2;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
+#endif
+    } else if ((p = io_direct[port].inw) != NULL) {
+        ret = p->inw(port, p->priv);
+        found = 2;
+#ifdef ENABLE_IO_LOG
+        qfound = 1;
 #endif
     } else {
         p = io[port];
@@ -530,6 +718,9 @@ inw(uint16_t port)
     if (!found)
         cycles -= io_delay;
 
+    if (prof)
+        io_profile_end(PROFILE_IO_IN, port, prof);
+
     io_log("[%04X:%08X] (%i, %i, %04i) in w(%04X) = %04X\n", CS, cpu_state.pc, in_smm, found, qfound, port, ret);
 
     return ret;
@@ -541,12 +732,14 @@ outw(uint16_t port, uint16_t val)
     io_t *p;
     io_t *q;
     int   found  = 0;
+    uint64_t prof;
 #ifdef ENABLE_IO_LOG
     int   qfound = 0;
 #endif
 
     io_port = port;
     io_val  = val;
+    prof    = profile_start();
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
@@ -563,6 +756,12 @@ outw(uint16_t port, uint16_t val)
         found = 2;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
+#endif
+    } else if ((p = io_direct[port].outw) != NULL) {
+        p->outw(port, val, p->priv);
+        found = 2;
+#ifdef ENABLE_IO_LOG
+        qfound = 1;
 #endif
     } else {
         p = io[port];
@@ -602,6 +801,9 @@ outw(uint16_t port, uint16_t val)
 #endif
     }
 
+    if (prof)
+        io_profile_end(PROFILE_IO_OUT, port, prof);
+
     io_log("[%04X:%08X] (%i, %i, %04i) outw(%04X, %04X)\n", CS, cpu_state.pc, in_smm, found, qfound, port, val);
 
     return;
@@ -616,11 +818,13 @@ inl(uint16_t port)
     uint16_t ret16[2];
     uint8_t  ret8[4];
     int      found  = 0;
+    uint64_t prof;
 #ifdef ENABLE_IO_LOG
     int      qfound = 0;
 #endif
 
     io_port = port;
+    prof    = profile_start();
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
@@ -637,6 +841,12 @@ inl(uint16_t port)
         found = 4;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
+#endif
+    } else if ((p = io_direct[port].inl) != NULL) {
+        ret = p->inl(port, p->priv);
+        found = 4;
+#ifdef ENABLE_IO_LOG
+        qfound = 1;
 #endif
     } else {
         p = io[port];
@@ -714,6 +924,9 @@ inl(uint16_t port)
     if (!found)
         cycles -= io_delay;
 
+    if (prof)
+        io_profile_end(PROFILE_IO_IN, port, prof);
+
     io_log("[%04X:%08X] (%i, %i, %04i) in l(%04X) = %08X\n", CS, cpu_state.pc, in_smm, found, qfound, port, ret);
 
     return ret;
@@ -725,6 +938,7 @@ outl(uint16_t port, uint32_t val)
     io_t *p;
     io_t *q;
     int   found  = 0;
+    uint64_t prof;
 #ifdef ENABLE_IO_LOG
     int   qfound = 0;
 #endif
@@ -732,6 +946,7 @@ outl(uint16_t port, uint32_t val)
 
     io_port = port;
     io_val  = val;
+    prof    = profile_start();
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
@@ -748,6 +963,12 @@ outl(uint16_t port, uint32_t val)
         found = 4;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
+#endif
+    } else if ((p = io_direct[port].outl) != NULL) {
+        p->outl(port, val, p->priv);
+        found = 4;
+#ifdef ENABLE_IO_LOG
+        qfound = 1;
 #endif
     } else {
         p = io[port];
@@ -804,6 +1025,9 @@ outl(uint16_t port, uint32_t val)
 #endif
     }
 
+    if (prof)
+        io_profile_end(PROFILE_IO_OUT, port, prof);
+
     io_log("[%04X:%08X] (%i, %i, %04i) outl(%04X, %08X)\n", CS, cpu_state.pc, in_smm, found, qfound, port, val);
 
     return;
@@ -36,6 +36,7 @@
 #include <86box/io.h>
 #include <86box/mem.h>
 #include <86box/plat.h>
+#include <86box/profile.h>
 #include <86box/rom.h>
 #include <86box/gdbstub.h>
 #ifdef USE_DYNAREC
@@ -254,6 +255,7 @@ flushmmucache_nopc(void)
             writelookup[c]               = 0xffffffff;
         }
     }
+    mmuflush++;
 }
 
 void
@@ -664,6 +666,204 @@ getpccache(uint32_t a)
     return (uint8_t *) &ff_pccache;
 }
 
+/* Call a mapping's handlers for a CPU access, splitting the access if the
+   mapping has no handler of the right width. */
+static __inline uint8_t
+mem_dispatch_readb(mem_mapping_t *map, uint32_t addr)
+{
+    uint64_t prof;
+    uint8_t  ret;
+
+    if (!map || !map->read_b)
+        return 0xff;
+
+    prof = profile_start();
+
+    ret = map->read_b(addr, map->priv);
+
+    if (prof)
+        profile_end(PROFILE_MEM_READ, map, map->priv, prof);
+
+    return ret;
+}
+
+static __inline uint16_t
+mem_dispatch_readw(mem_mapping_t *map, uint32_t addr)
+{
+    uint64_t prof;
+    uint16_t ret;
+
+    if (!map || (!map->read_w && !map->read_b))
+        return 0xffff;
+
+    prof = profile_start();
+
+    if (map->read_w)
+        ret = map->read_w(addr, map->priv);
+    else
+        ret = map->read_b(addr, map->priv) | ((uint16_t) (map->read_b(addr + 1, map->priv)) << 8);
+
+    if (prof)
+        profile_end(PROFILE_MEM_READ, map, map->priv, prof);
+
+    return ret;
+}
+
+static __inline uint32_t
+mem_dispatch_readl(mem_mapping_t *map, uint32_t addr)
+{
+    uint64_t prof;
+    uint32_t ret;
+
+    if (!map || (!map->read_l && !map->read_w && !map->read_b))
+        return 0xffffffff;
+
+    prof = profile_start();
+
+    if (map->read_l)
+        ret = map->read_l(addr, map->priv);
+    else if (map->read_w)
+        ret = map->read_w(addr, map->priv) | ((uint32_t) (map->read_w(addr + 2, map->priv)) << 16);
+    else
+        ret = map->read_b(addr, map->priv) | ((uint32_t) (map->read_b(addr + 1, map->priv)) << 8) | ((uint32_t) (map->read_b(addr + 2, map->priv)) << 16) | ((uint32_t) (map->read_b(addr + 3, map->priv)) << 24);
+
+    if (prof)
+        profile_end(PROFILE_MEM_READ, map, map->priv, prof);
+
+    return ret;
+}
+
+static __inline uint64_t
+mem_dispatch_readq(mem_mapping_t *map, uint32_t addr)
+{
+    uint64_t prof;
+    uint64_t ret;
+
+    if (!map || (!map->read_l && !map->read_w && !map->read_b))
+        return 0xffffffffffffffffULL;
+
+    prof = profile_start();
+
+    if (map->read_l)
+        ret = map->read_l(addr, map->priv) |
+              ((uint64_t) map->read_l(addr + 4, map->priv) << 32);
+    else if (map->read_w)
+        ret = map->read_w(addr, map->priv) |
+              ((uint64_t) map->read_w(addr + 2, map->priv) << 16) |
+              ((uint64_t) map->read_w(addr + 4, map->priv) << 32) |
+              ((uint64_t) map->read_w(addr + 6, map->priv) << 48);
+    else
+        ret = map->read_b(addr, map->priv) |
+              ((uint64_t) map->read_b(addr + 1, map->priv) << 8) |
+              ((uint64_t) map->read_b(addr + 2, map->priv) << 16) |
+              ((uint64_t) map->read_b(addr + 3, map->priv) << 24) |
+              ((uint64_t) map->read_b(addr + 4, map->priv) << 32) |
+              ((uint64_t) map->read_b(addr + 5, map->priv) << 40) |
+              ((uint64_t) map->read_b(addr + 6, map->priv) << 48) |
+              ((uint64_t) map->read_b(addr + 7, map->priv) << 56);
+
+    if (prof)
+        profile_end(PROFILE_MEM_READ, map, map->priv, prof);
+
+    return ret;
+}
+
+static __inline void
+mem_dispatch_writeb(mem_mapping_t *map, uint32_t addr, uint8_t val)
+{
+    uint64_t prof;
+
+    if (!map || !map->write_b)
+        return;
+
+    prof = profile_start();
+
+    map->write_b(addr, val, map->priv);
+
+    if (prof)
+        profile_end(PROFILE_MEM_WRITE, map, map->priv, prof);
+}
+
+static __inline void
+mem_dispatch_writew(mem_mapping_t *map, uint32_t addr, uint16_t val)
+{
+    uint64_t prof;
+
+    if (!map || (!map->write_w && !map->write_b))
+        return;
+
+    prof = profile_start();
+
+    if (map->write_w)
+        map->write_w(addr, val, map->priv);
+    else {
+        map->write_b(addr, val, map->priv);
+        map->write_b(addr + 1, val >> 8, map->priv);
+    }
+
+    if (prof)
+        profile_end(PROFILE_MEM_WRITE, map, map->priv, prof);
+}
+
+static __inline void
+mem_dispatch_writel(mem_mapping_t *map, uint32_t addr, uint32_t val)
+{
+    uint64_t prof;
+
+    if (!map || (!map->write_l && !map->write_w && !map->write_b))
+        return;
+
+    prof = profile_start();
+
+    if (map->write_l)
+        map->write_l(addr, val, map->priv);
+    else if (map->write_w) {
+        map->write_w(addr, val, map->priv);
+        map->write_w(addr + 2, val >> 16, map->priv);
+    } else {
+        map->write_b(addr, val, map->priv);
+        map->write_b(addr + 1, val >> 8, map->priv);
+        map->write_b(addr + 2, val >> 16, map->priv);
+        map->write_b(addr + 3, val >> 24, map->priv);
+    }
+
+    if (prof)
+        profile_end(PROFILE_MEM_WRITE, map, map->priv, prof);
+}
+
+static __inline void
+mem_dispatch_writeq(mem_mapping_t *map, uint32_t addr, uint64_t val)
+{
+    uint64_t prof;
+
+    if (!map || (!map->write_l && !map->write_w && !map->write_b))
+        return;
+
+    prof = profile_start();
+
+    if (map->write_l) {
+        map->write_l(addr, val, map->priv);
+        map->write_l(addr + 4, val >> 32, map->priv);
+    } else if (map->write_w) {
+        map->write_w(addr, val, map->priv);
+        map->write_w(addr + 2, val >> 16, map->priv);
+        map->write_w(addr + 4, val >> 32, map->priv);
+        map->write_w(addr + 6, val >> 48, map->priv);
+    } else {
+        map->write_b(addr, val, map->priv);
+        map->write_b(addr + 1, val >> 8, map->priv);
+        map->write_b(addr + 2, val >> 16, map->priv);
+        map->write_b(addr + 3, val >> 24, map->priv);
+        map->write_b(addr + 4, val >> 32, map->priv);
+        map->write_b(addr + 5, val >> 40, map->priv);
+        map->write_b(addr + 6, val >> 48, map->priv);
+        map->write_b(addr + 7, val >> 56, map->priv);
+    }
+
+    if (prof)
+        profile_end(PROFILE_MEM_WRITE, map, map->priv, prof);
+}
+
 uint8_t
 read_mem_b(uint32_t addr)
 {
@@ -712,8 +912,7 @@ write_mem_b(uint32_t addr, uint8_t val)
     addr &= rammask;
 
     map = write_mapping[addr >> MEM_GRANULARITY_BITS];
-    if (map && map->write_b)
-        map->write_b(addr, val, map->priv);
+    mem_dispatch_writeb(map, addr, val);
 }
 
 void
@@ -766,10 +965,7 @@ readmembl(uint32_t addr)
     addr = (uint32_t) (addr64 & rammask);
 
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
-    if (map && map->read_b)
-        return map->read_b(addr, map->priv);
-
-    return 0xff;
+    return mem_dispatch_readb(map, addr);
 }
 
 void
@@ -803,8 +999,7 @@ writemembl(uint32_t addr, uint8_t val)
     addr = (uint32_t) (addr64 & rammask);
 
     map = write_mapping[addr >> MEM_GRANULARITY_BITS];
-    if (map && map->write_b)
-        map->write_b(addr, val, map->priv);
+    mem_dispatch_writeb(map, addr, val);
 }
 
 /* Read a byte from memory without MMU translation - result of previous MMU translation passed as value. */
@@ -826,10 +1021,7 @@ readmembl_no_mmut(uint32_t addr, uint32_t a64)
         addr &= rammask;
 
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
-    if (map && map->read_b)
-        return map->read_b(addr, map->priv);
-
-    return 0xff;
+    return mem_dispatch_readb(map, addr);
 }
 
 /* Write a byte to memory without MMU translation - result of previous MMU translation passed as value. */
@@ -856,8 +1048,7 @@ writemembl_no_mmut(uint32_t addr, uint32_t a64, uint8_t val)
         addr &= rammask;
 
     map = write_mapping[addr >> MEM_GRANULARITY_BITS];
-    if (map && map->write_b)
-        map->write_b(addr, val, map->priv);
+    mem_dispatch_writeb(map, addr, val);
 }
 
 uint16_t
@@ -910,14 +1101,7 @@ readmemwl(uint32_t addr)
 
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
-    if (map && map->read_w)
-        return map->read_w(addr, map->priv);
-
-    if (map && map->read_b) {
-        return map->read_b(addr, map->priv) | ((uint16_t) (map->read_b(addr + 1, map->priv)) << 8);
-    }
-
-    return 0xffff;
+    return mem_dispatch_readw(map, addr);
 }
 
 void
@@ -984,16 +1168,7 @@ writememwl(uint32_t addr, uint16_t val)
 
     map = write_mapping[addr >> MEM_GRANULARITY_BITS];
 
-    if (map && map->write_w) {
-        map->write_w(addr, val, map->priv);
-        return;
-    }
-
-    if (map && map->write_b) {
-        map->write_b(addr, val, map->priv);
-        map->write_b(addr + 1, val >> 8, map->priv);
-        return;
-    }
+    mem_dispatch_writew(map, addr, val);
 }
 
 /* Read a word from memory without MMU translation - results of previous MMU translation passed as array. */
@@ -1030,14 +1205,7 @@ readmemwl_no_mmut(uint32_t addr, uint32_t *a64)
 
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
-    if (map && map->read_w)
-        return map->read_w(addr, map->priv);
-
-    if (map && map->read_b) {
-        return map->read_b(addr, map->priv) | ((uint16_t) (map->read_b(addr + 1, map->priv)) << 8);
-    }
-
-    return 0xffff;
+    return mem_dispatch_readw(map, addr);
 }
 
 /* Write a word to memory without MMU translation - results of previous MMU translation passed as array. */
@@ -1083,16 +1251,7 @@ writememwl_no_mmut(uint32_t addr, uint32_t *a64, uint16_t val)
 
     map = write_mapping[addr >> MEM_GRANULARITY_BITS];
 
-    if (map && map->write_w) {
-        map->write_w(addr, val, map->priv);
-        return;
-    }
-
-    if (map && map->write_b) {
-        map->write_b(addr, val, map->priv);
-        map->write_b(addr + 1, val >> 8, map->priv);
-        return;
-    }
+    mem_dispatch_writew(map, addr, val);
 }
 
 uint32_t
@@ -1159,16 +1318,7 @@ readmemll(uint32_t addr)
 
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
-    if (map && map->read_l)
-        return map->read_l(addr, map->priv);
-
-    if (map && map->read_w)
-        return map->read_w(addr, map->priv) | ((uint32_t) (map->read_w(addr + 2, map->priv)) << 16);
-
-    if (map && map->read_b)
-        return map->read_b(addr, map->priv) | ((uint32_t) (map->read_b(addr + 1, map->priv)) << 8) | ((uint32_t) (map->read_b(addr + 2, map->priv)) << 16) | ((uint32_t) (map->read_b(addr + 3, map->priv)) << 24);
-
-    return 0xffffffff;
+    return mem_dispatch_readl(map, addr);
 }
 
 void
@@ -1248,22 +1398,7 @@ writememll(uint32_t addr, uint32_t val)
 
     map = write_mapping[addr >> MEM_GRANULARITY_BITS];
 
-    if (map && map->write_l) {
-        map->write_l(addr, val, map->priv);
-        return;
-    }
-    if (map && map->write_w) {
-        map->write_w(addr, val, map->priv);
-        map->write_w(addr + 2, val >> 16, map->priv);
-        return;
-    }
-    if (map && map->write_b) {
-        map->write_b(addr, val, map->priv);
-        map->write_b(addr + 1, val >> 8, map->priv);
-        map->write_b(addr + 2, val >> 16, map->priv);
-        map->write_b(addr + 3, val >> 24, map->priv);
-        return;
-    }
+    mem_dispatch_writel(map, addr, val);
 }
 
 /* Read a long from memory without MMU translation - results of previous MMU translation passed as array. */
@@ -1300,16 +1435,7 @@ readmemll_no_mmut(uint32_t addr, uint32_t *a64)
 
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
-    if (map && map->read_l)
-        return map->read_l(addr, map->priv);
-
-    if (map && map->read_w)
-        return map->read_w(addr, map->priv) | ((uint32_t) (map->read_w(addr + 2, map->priv)) << 16);
-
-    if (map && map->read_b)
-        return map->read_b(addr, map->priv) | ((uint32_t) (map->read_b(addr + 1, map->priv)) << 8) | ((uint32_t) (map->read_b(addr + 2, map->priv)) << 16) | ((uint32_t) (map->read_b(addr + 3, map->priv)) << 24);
-
-    return 0xffffffff;
+    return mem_dispatch_readl(map, addr);
 }
 
 /* Write a long to memory without MMU translation - results of previous MMU translation passed as array. */
@@ -1355,22 +1481,7 @@ writememll_no_mmut(uint32_t addr, uint32_t *a64, uint32_t val)
 
     map = write_mapping[addr >> MEM_GRANULARITY_BITS];
 
-    if (map && map->write_l) {
-        map->write_l(addr, val, map->priv);
-        return;
-    }
-    if (map && map->write_w) {
-        map->write_w(addr, val, map->priv);
-        map->write_w(addr + 2, val >> 16, map->priv);
-        return;
-    }
-    if (map && map->write_b) {
-        map->write_b(addr, val, map->priv);
-        map->write_b(addr + 1, val >> 8, map->priv);
-        map->write_b(addr + 2, val >> 16, map->priv);
-        map->write_b(addr + 3, val >> 24, map->priv);
-        return;
-    }
+    mem_dispatch_writel(map, addr, val);
 }
 
 uint64_t
@@ -1436,27 +1547,7 @@ readmemql(uint32_t addr)
 
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
-    if (map && map->read_l)
-        return map->read_l(addr, map->priv) |
-               ((uint64_t) map->read_l(addr + 4, map->priv) << 32);
-
-    if (map && map->read_w)
-        return map->read_w(addr, map->priv) |
-               ((uint64_t) map->read_w(addr + 2, map->priv) << 16) |
-               ((uint64_t) map->read_w(addr + 4, map->priv) << 32) |
-               ((uint64_t) map->read_w(addr + 6, map->priv) << 48);
-
-    if (map && map->read_b)
-        return map->read_b(addr, map->priv) |
-               ((uint64_t) map->read_b(addr + 1, map->priv) << 8) |
-               ((uint64_t) map->read_b(addr + 2, map->priv) << 16) |
-               ((uint64_t) map->read_b(addr + 3, map->priv) << 24) |
-               ((uint64_t) map->read_b(addr + 4, map->priv) << 32) |
-               ((uint64_t) map->read_b(addr + 5, map->priv) << 40) |
-               ((uint64_t) map->read_b(addr + 6, map->priv) << 48) |
-               ((uint64_t) map->read_b(addr + 7, map->priv) << 56);
-
-    return 0xffffffffffffffffULL;
+    return mem_dispatch_readq(map, addr);
 }
 
 void
@@ -1534,29 +1625,7 @@ writememql(uint32_t addr, uint64_t val)
 
     map = write_mapping[addr >> MEM_GRANULARITY_BITS];
 
-    if (map && map->write_l) {
-        map->write_l(addr, val, map->priv);
-        map->write_l(addr + 4, val >> 32, map->priv);
-        return;
-    }
-    if (map && map->write_w) {
-        map->write_w(addr, val, map->priv);
-        map->write_w(addr + 2, val >> 16, map->priv);
-        map->write_w(addr + 4, val >> 32, map->priv);
-        map->write_w(addr + 6, val >> 48, map->priv);
-        return;
-    }
-    if (map && map->write_b) {
-        map->write_b(addr, val, map->priv);
-        map->write_b(addr + 1, val >> 8, map->priv);
-        map->write_b(addr + 2, val >> 16, map->priv);
-        map->write_b(addr + 3, val >> 24, map->priv);
-        map->write_b(addr + 4, val >> 32, map->priv);
-        map->write_b(addr + 5, val >> 40, map->priv);
-        map->write_b(addr + 6, val >> 48, map->priv);
-        map->write_b(addr + 7, val >> 56, map->priv);
-        return;
-    }
+    mem_dispatch_writeq(map, addr, val);
 }
 
 void
@@ -1761,6 +1830,124 @@ mem_write_phys(void *src, uint32_t addr, int transfer_size)
     }
 }
 
+/* Only mappings served by the plain RAM handlers behave like the memory
+   their exec pointer points at; others, such as flash, pass their array as
+   exec but run every access through a state machine. */
+static int
+mem_mapping_is_plain_ram(const mem_mapping_t *map, int write)
+{
+    if (write)
+        return (map->write_b == mem_write_ram) && (map->write_w == mem_write_ramw) &&
+               (map->write_l == mem_write_raml);
+
+    return (map->read_b == mem_read_ram) && (map->read_w == mem_read_ramw) &&
+           (map->read_l == mem_read_raml);
+}
+
+/* Returns how many bytes from addr on, up to max, are backed directly by the
+   RAM of a single mapping, and points p at them. Returns 0 if addr is not
+   in such memory, or the CPU does not use the exec pointers, in which case
+   the access has to go through the handlers. */
+static uint32_t
+mem_phys_direct_span(mem_mapping_t **mappings, uint32_t addr, uint32_t max, uint8_t **p, int write)
+{
+    mem_mapping_t *map = mappings[addr >> MEM_GRANULARITY_BITS];
+    uint32_t       granule = (addr >> MEM_GRANULARITY_BITS) + 1;
+    uint32_t       offset;
+    uint32_t       span;
+
+    if (!cpu_use_exec || (map == NULL) || (map->exec == NULL) || !mem_mapping_is_plain_ram(map, write))
+        return 0;
+
+    offset = (addr - map->base) & map->mask;
+    span   = MEM_GRANULARITY_SIZE - (addr & MEM_GRANULARITY_MASK);
+
+    /* The following granules of the same mapping continue the span. */
+    while ((span < max) && (granule < MEM_MAPPINGS_NO) && (mappings[granule] == map)) {
+        span += MEM_GRANULARITY_SIZE;
+        granule++;
+    }
+
+    if (span > max)
+        span = max;
+
+    /* Stop where a mirrored mapping wraps around. */
+    if ((span - 1) > (map->mask - offset))
+        span = map->mask - offset + 1;
+
+    *p = &map->exec[offset];
+    return span;
+}
+
+/* Read len bytes of physical memory, for bus masters. Accesses are made in
+   units of transfer_size, as mem_read_phys() does, but spans of directly
+   backed memory are copied in one go rather than unit by unit. */
+void
+mem_read_phys_range(void *dest, uint32_t addr, uint32_t len, int transfer_size)
+{
+    uint8_t *d        = (uint8_t *) dest;
+    uint32_t n        = len & ~(transfer_size - 1);
+    uint32_t i        = 0;
+    uint32_t span;
+    uint8_t *p;
+    uint8_t  bytes[4] = { 0, 0, 0, 0 };
+
+    while (i < n) {
+        span = mem_phys_direct_span(read_mapping_bus, addr + i, n - i, &p, 0) & ~(transfer_size - 1);
+
+        if (span) {
+            memcpy(&d[i], p, span);
+            i += span;
+        } else {
+            mem_read_phys(&d[i], addr + i, transfer_size);
+            i += transfer_size;
+        }
+    }
+
+    mem_logical_addr = 0xffffffff;
+
+    /* Do the non-divisible block, if there is one. */
+    if (len > n) {
+        mem_read_phys(bytes, addr + n, transfer_size);
+        memcpy(&d[n], bytes, len - n);
+    }
+}
+
+/* Write len bytes of physical memory, for bus masters. Directly backed spans
+   are copied in one go and have the recompiled code in them invalidated. */
+void
+mem_write_phys_range(const void *src, uint32_t addr, uint32_t len, int transfer_size)
+{
+    const uint8_t *s        = (const uint8_t *) src;
+    uint32_t       n        = len & ~(transfer_size - 1);
+    uint32_t       i        = 0;
+    uint32_t       span;
+    uint8_t       *p;
+    uint8_t        bytes[4] = { 0, 0, 0, 0 };
+
+    while (i < n) {
+        span = mem_phys_direct_span(write_mapping_bus, addr + i, n - i, &p, 1) & ~(transfer_size - 1);
+
+        if (span) {
+            memcpy(p, &s[i], span);
+            mem_invalidate_range(addr + i, addr + i + span - 1);
+            i += span;
+        } else {
+            mem_write_phys((void *) &s[i], addr + i, transfer_size);
+            i += transfer_size;
+        }
+    }
+
+    mem_logical_addr = 0xffffffff;
+
+    /* Do the non-divisible block, if there is one. */
+    if (len > n) {
+        mem_read_phys(bytes, addr + n, transfer_size);
+        memcpy(bytes, &s[n], len - n);
+        mem_write_phys(bytes, addr + n, transfer_size);
+    }
+}
+
 uint8_t
 mem_read_ram(uint32_t addr, UNUSED(void *priv))
 {
@@ -142,6 +142,9 @@ net_cards_migrate[] = {
 netcard_conf_t net_cards_conf[NET_CARD_MAX];
 uint16_t       net_card_current = 0;
 
+static netcard_t *net_cards_attached[NET_CARD_MAX];
+int            net_queue_depth  = NET_QUEUE_DEPTH_DEF;
+
 /* Global variables. */
 network_devmap_t network_devmap = {0};
 int  network_ndev;
@@ -289,26 +292,103 @@ network_init(void)
 #endif
 }
 
-void
-network_queue_init(netqueue_t *queue)
+/*
+ * Each queue is a ring with a single producer and a single consumer, so
+ * neither side needs a lock: the producer only ever advances the head and
+ * the consumer only ever advances the tail. Every slot owns a frame buffer
+ * for the lifetime of the queue, and packets are handed over by swapping
+ * buffer pointers rather than copying frames.
+ */
+struct netqueue_t {
+    netpkt_t   *packets;
+    uint32_t    size;
+    uint32_t    mask;
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_uint drops;
+    atomic_uint peak;
+};
+
+static netqueue_t *
+network_queue_init(void)
 {
-    queue->head = queue->tail = 0;
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
+    netqueue_t *queue = calloc(1, sizeof(netqueue_t));
+    uint32_t    size  = NET_QUEUE_DEPTH_MIN;
+
+    while ((size < (uint32_t) net_queue_depth) && (size < NET_QUEUE_DEPTH_MAX))
+        size <<= 1;
+
+    queue->size    = size;
+    queue->mask    = size - 1;
+    queue->packets = calloc(size, sizeof(netpkt_t));
+    for (uint32_t i = 0; i < size; i++) {
         queue->packets[i].data = calloc(1, NET_MAX_FRAME);
         queue->packets[i].len  = 0;
     }
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->drops, 0);
+    atomic_init(&queue->peak, 0);
+
+    return queue;
 }
 
-static bool
-network_queue_full(netqueue_t *queue)
+/* Producer side: returns the slot to fill, or NULL if the queue is full.
+   Callers that discard the packet then count it with network_queue_drop(). */
+static inline netpkt_t *
+network_queue_head(netqueue_t *queue)
+{
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if ((head - tail) >= queue->size)
+        return NULL;
+
+    return &queue->packets[head & queue->mask];
+}
+
+static inline void
+network_queue_drop(netqueue_t *queue)
+{
+    atomic_fetch_add_explicit(&queue->drops, 1, memory_order_relaxed);
+}
+
+static inline void
+network_queue_push(netqueue_t *queue)
+{
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed) + 1;
+    uint32_t used = head - atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    if (used > atomic_load_explicit(&queue->peak, memory_order_relaxed))
+        atomic_store_explicit(&queue->peak, used, memory_order_relaxed);
+
+    atomic_store_explicit(&queue->head, head, memory_order_release);
+}
+
+/* Consumer side: returns the oldest packet, or NULL if the queue is empty. */
+static inline netpkt_t *
+network_queue_tail(netqueue_t *queue)
 {
-    return ((queue->head + 1) & NET_QUEUE_LEN_MASK) == queue->tail;
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    if (tail == atomic_load_explicit(&queue->head, memory_order_acquire))
+        return NULL;
+
+    return &queue->packets[tail & queue->mask];
+}
+
+static inline void
+network_queue_pop(netqueue_t *queue)
+{
+    atomic_store_explicit(&queue->tail, atomic_load_explicit(&queue->tail, memory_order_relaxed) + 1,
+                          memory_order_release);
 }
 
 static bool
 network_queue_empty(netqueue_t *queue)
 {
-    return (queue->head == queue->tail);
+    return atomic_load_explicit(&queue->head, memory_order_acquire) ==
+           atomic_load_explicit(&queue->tail, memory_order_acquire);
 }
 
 static inline void
@@ -319,24 +399,32 @@ network_swap_packet(netpkt_t *pkt1, netpkt_t *pkt2)
     *pkt1        = tmp;
 }
 
-int
+static int
 network_queue_put(netqueue_t *queue, uint8_t *data, int len)
 {
-    if (len == 0 || len > NET_MAX_FRAME || network_queue_full(queue)) {
+    netpkt_t *pkt;
+
+    if ((len == 0) || (len > NET_MAX_FRAME))
+        return 0;
+
+    if ((pkt = network_queue_head(queue)) == NULL) {
+        network_queue_drop(queue);
         return 0;
     }
 
-    netpkt_t *pkt = &queue->packets[queue->head];
     memcpy(pkt->data, data, len);
-    pkt->len    = len;
-    queue->head = (queue->head + 1) & NET_QUEUE_LEN_MASK;
+    pkt->len = len;
+    network_queue_push(queue);
     return 1;
 }
 
-int
+static int
 network_queue_put_swap(netqueue_t *queue, netpkt_t *src_pkt)
 {
-    if (src_pkt->len == 0 || src_pkt->len > NET_MAX_FRAME || network_queue_full(queue)) {
+    netpkt_t *dst_pkt = NULL;
+
+    if ((src_pkt->len == 0) || (src_pkt->len > NET_MAX_FRAME) ||
+        ((dst_pkt = network_queue_head(queue)) == NULL)) {
 #ifdef DEBUG
         if (src_pkt->len == 0) {
             network_log("Discarded zero length packet.\n");
@@ -346,56 +434,93 @@ network_queue_put_swap(netqueue_t *queue, netpkt_t *src_pkt)
             network_log("Discarded %d bytes packet because the queue is full.\n", src_pkt->len);
         }
 #endif
+        if ((src_pkt->len != 0) && (src_pkt->len <= NET_MAX_FRAME))
+            network_queue_drop(queue);
         return 0;
     }
 
-    netpkt_t *dst_pkt = &queue->packets[queue->head];
     network_swap_packet(src_pkt, dst_pkt);
-
-    queue->head = (queue->head + 1) & NET_QUEUE_LEN_MASK;
+    network_queue_push(queue);
     return 1;
 }
 
 static int
 network_queue_get_swap(netqueue_t *queue, netpkt_t *dst_pkt)
 {
-    if (network_queue_empty(queue))
+    netpkt_t *src_pkt = network_queue_tail(queue);
+
+    if (src_pkt == NULL)
         return 0;
 
-    netpkt_t *src_pkt = &queue->packets[queue->tail];
     network_swap_packet(src_pkt, dst_pkt);
-    queue->tail = (queue->tail + 1) & NET_QUEUE_LEN_MASK;
+    network_queue_pop(queue);
     return 1;
 }
 
 static int
 network_queue_move(netqueue_t *dst_q, netqueue_t *src_q)
 {
-    if (network_queue_empty(src_q))
-        return 0;
+    netpkt_t *src_pkt = network_queue_tail(src_q);
+    netpkt_t *dst_pkt;
 
-    if (network_queue_full(dst_q)) {
+    if (src_pkt == NULL)
         return 0;
-    }
 
-    netpkt_t *src_pkt = &src_q->packets[src_q->tail];
-    netpkt_t *dst_pkt = &dst_q->packets[dst_q->head];
+    if ((dst_pkt = network_queue_head(dst_q)) == NULL)
+        return 0;
 
     network_swap_packet(src_pkt, dst_pkt);
-    dst_q->head = (dst_q->head + 1) & NET_QUEUE_LEN_MASK;
-    src_q->tail = (src_q->tail + 1) & NET_QUEUE_LEN_MASK;
+    network_queue_push(dst_q);
+    network_queue_pop(src_q);
 
     return dst_pkt->len;
 }
 
-void
+static void
 network_queue_clear(netqueue_t *queue)
 {
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
+    if (queue == NULL)
+        return;
+
+    for (uint32_t i = 0; i < queue->size; i++)
         free(queue->packets[i].data);
-        queue->packets[i].len = 0;
+    free(queue->packets);
+    free(queue);
+}
+
+void
+network_queue_get_stats(netcard_t *card, int queue, netqueue_stats_t *stats)
+{
+    netqueue_t *q = card->queues[queue];
+
+    stats->depth = q->size;
+    stats->used  = atomic_load(&q->head) - atomic_load(&q->tail);
+    stats->peak  = atomic_load(&q->peak);
+    stats->drops = atomic_load(&q->drops);
+}
+
+/* Return the card attached as the given card number, or NULL if none is. */
+netcard_t *
+network_get_card(int card_num)
+{
+    return net_cards_attached[card_num];
+}
+
+static void
+network_log_stats(netcard_t *card)
+{
+#ifdef ENABLE_NETWORK_LOG
+    static const char *names[NET_QUEUE_COUNT] = { "RX", "TX (VM)", "TX (host)", "RX on TX" };
+    netqueue_stats_t   stats;
+
+    for (int i = 0; i < NET_QUEUE_COUNT; i++) {
+        network_queue_get_stats(card, i, &stats);
+        network_log("NETWORK: card %i %s queue: depth %u, peak %u, dropped %u\n",
+                    card->card_num, names[i], stats.depth, stats.peak, stats.drops);
     }
-    queue->tail = queue->head = 0;
+#else
+    (void) card;
+#endif
 }
 
 static void
@@ -411,12 +536,9 @@ network_rx_queue(void *priv)
     }
 
     uint32_t rx_bytes = 0;
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
+    for (uint32_t i = 0; i < card->queues[NET_QUEUE_RX]->size; i++) {
         if (card->queued_pkt.len == 0) {
-            thread_wait_mutex(card->rx_mutex);
-            int res = network_queue_get_swap(&card->queues[NET_QUEUE_RX], &card->queued_pkt);
-            thread_release_mutex(card->rx_mutex);
-            if (!res)
+            if (!network_queue_get_swap(card->queues[NET_QUEUE_RX], &card->queued_pkt))
                 break;
         }
 
@@ -430,15 +552,15 @@ network_rx_queue(void *priv)
 
     /* Transmission. */
     uint32_t tx_bytes = 0;
-    thread_wait_mutex(card->tx_mutex);
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
-        uint32_t bytes = network_queue_move(&card->queues[NET_QUEUE_TX_HOST], &card->queues[NET_QUEUE_TX_VM]);
+    for (uint32_t i = 0; i < card->queues[NET_QUEUE_TX_VM]->size; i++) {
+        uint32_t bytes = network_queue_move(card->queues[NET_QUEUE_TX_HOST], card->queues[NET_QUEUE_TX_VM]);
         if (!bytes)
             break;
         tx_bytes += bytes;
     }
-    thread_release_mutex(card->tx_mutex);
-    if (tx_bytes) {
+    /* The host drivers take at most NET_QUEUE_LEN packets per wakeup, so
+       keep poking them while anything is left over. */
+    if (tx_bytes || !network_queue_empty(card->queues[NET_QUEUE_TX_HOST])) {
         /* Notify host that a packet is available in the TX queue */
         card->host_drv.notify_in(card->host_drv.priv);
     }
@@ -476,7 +598,6 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
     card->card_drv        = card_drv;
     card->rx              = rx;
     card->set_link_state  = set_link_state;
-    card->tx_mutex        = thread_create_mutex();
     card->rx_mutex        = thread_create_mutex();
     card->card_num        = net_card_current;
     card->byte_period     = NET_PERIOD_10M;
@@ -485,7 +606,7 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
     wchar_t tempmsg[NET_DRV_ERRBUF_SIZE * 2];
 
     for (int i = 0; i < NET_QUEUE_COUNT; i++) {
-        network_queue_init(&card->queues[i]);
+        card->queues[i] = network_queue_init();
     }
 
     if ((!strcmp(network_card_get_internal_name(net_cards_conf[net_card_current].device_num), "modem") ||
@@ -548,10 +669,9 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
         // If null fails, something is very wrong
         // Clean up and fatal
         if(!card->host_drv.priv) {
-            thread_close_mutex(card->tx_mutex);
             thread_close_mutex(card->rx_mutex);
             for (int i = 0; i < NET_QUEUE_COUNT; i++) {
-                network_queue_clear(&card->queues[i]);
+                network_queue_clear(card->queues[i]);
             }
 
             free(card->queued_pkt.data);
@@ -566,6 +686,8 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
     timer_add(&card->timer, network_rx_queue, card, 0);
     timer_on_auto(&card->timer, 100);
 
+    net_cards_attached[card->card_num] = card;
+
     return card;
 }
 
@@ -575,10 +697,14 @@ netcard_close(netcard_t *card)
     timer_stop(&card->timer);
     card->host_drv.close(card->host_drv.priv);
 
-    thread_close_mutex(card->tx_mutex);
+    network_log_stats(card);
+
+    if (net_cards_attached[card->card_num] == card)
+        net_cards_attached[card->card_num] = NULL;
+
     thread_close_mutex(card->rx_mutex);
     for (int i = 0; i < NET_QUEUE_COUNT; i++) {
-        network_queue_clear(&card->queues[i]);
+        network_queue_clear(card->queues[i]);
     }
 
     free(card->queued_pkt.data);
@@ -631,19 +757,13 @@ network_reset(void)
 void
 network_tx(netcard_t *card, uint8_t *bufp, int len)
 {
-    network_queue_put(&card->queues[NET_QUEUE_TX_VM], bufp, len);
+    network_queue_put(card->queues[NET_QUEUE_TX_VM], bufp, len);
 }
 
 int
 network_tx_pop(netcard_t *card, netpkt_t *out_pkt)
 {
-    int ret = 0;
-
-    thread_wait_mutex(card->tx_mutex);
-    ret = network_queue_get_swap(&card->queues[NET_QUEUE_TX_HOST], out_pkt);
-    thread_release_mutex(card->tx_mutex);
-
-    return ret;
+    return network_queue_get_swap(card->queues[NET_QUEUE_TX_HOST], out_pkt);
 }
 
 int
@@ -651,8 +771,7 @@ network_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size)
 {
     int pkt_count = 0;
 
-    netqueue_t *queue = &card->queues[NET_QUEUE_TX_HOST];
-    thread_wait_mutex(card->tx_mutex);
+    netqueue_t *queue = card->queues[NET_QUEUE_TX_HOST];
     for (int i = 0; i < vec_size; i++) {
         if (!network_queue_get_swap(queue, pkt_vec))
             break;
@@ -660,18 +779,23 @@ network_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size)
         pkt_count++;
         pkt_vec++;
     }
-    thread_release_mutex(card->tx_mutex);
 
     return pkt_count;
 }
 
+/*
+ * The receive queue normally has the host driver thread as its only
+ * producer, but a card in loopback mode (RTL8139) also feeds it from the
+ * emulation thread, so producers still serialize on rx_mutex. The consumer
+ * side never takes it.
+ */
 int
 network_rx_put(netcard_t *card, uint8_t *bufp, int len)
 {
     int ret = 0;
 
     thread_wait_mutex(card->rx_mutex);
-    ret = network_queue_put(&card->queues[NET_QUEUE_RX], bufp, len);
+    ret = network_queue_put(card->queues[NET_QUEUE_RX], bufp, len);
     thread_release_mutex(card->rx_mutex);
 
     return ret;
@@ -682,7 +806,7 @@ network_rx_on_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size)
 {
     int pkt_count = 0;
 
-    netqueue_t *queue = &card->queues[NET_QUEUE_RX_ON_TX];
+    netqueue_t *queue = card->queues[NET_QUEUE_RX_ON_TX];
     for (int i = 0; i < vec_size; i++) {
         if (!network_queue_get_swap(queue, pkt_vec))
             break;
@@ -699,7 +823,7 @@ network_rx_on_tx_put(netcard_t *card, uint8_t *bufp, int len)
 {
     int ret = 0;
 
-    ret = network_queue_put(&card->queues[NET_QUEUE_RX_ON_TX], bufp, len);
+    ret = network_queue_put(card->queues[NET_QUEUE_RX_ON_TX], bufp, len);
 
     return ret;
 }
@@ -709,7 +833,7 @@ network_rx_on_tx_put_pkt(netcard_t *card, netpkt_t *pkt)
 {
     int ret = 0;
 
-    ret = network_queue_put_swap(&card->queues[NET_QUEUE_RX_ON_TX], pkt);
+    ret = network_queue_put_swap(card->queues[NET_QUEUE_RX_ON_TX], pkt);
 
     return ret;
 }
@@ -720,7 +844,7 @@ network_rx_put_pkt(netcard_t *card, netpkt_t *pkt)
     int ret = 0;
 
     thread_wait_mutex(card->rx_mutex);
-    ret = network_queue_put_swap(&card->queues[NET_QUEUE_RX], pkt);
+    ret = network_queue_put_swap(card->queues[NET_QUEUE_RX], pkt);
     thread_release_mutex(card->rx_mutex);
 
     return ret;
@@ -0,0 +1,234 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Main loop frame pacer.
+ *
+ *          The emulation runs in slices of 1 ms (or 10 ms) of guest
+ *          time. Rather than polling the host clock every millisecond,
+ *          the pacer keeps an absolute schedule of when each slice is
+ *          due and sleeps until the next deadline. Deadlines are taken
+ *          from a fixed base, so sleep overshoot does not accumulate.
+ *          When the host cannot wake us up accurately, several slices
+ *          are batched per wakeup instead.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <wchar.h>
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <errno.h>
+#    include <time.h>
+#endif
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/plat.h>
+#include <86box/pacing.h>
+
+#define PACING_NS 1000000000ULL
+
+static uint64_t pacing_base;     /* Host time slice 0 was due at. */
+static uint64_t pacing_done;     /* Slices run since pacing_base. */
+static uint64_t pacing_slice_ns; /* Length of a slice. */
+static int      pacing_batch = 1;
+
+static pacing_stats_t pacing_stats;
+
+#ifdef ENABLE_PACING_LOG
+int pacing_do_log = ENABLE_PACING_LOG;
+
+static void
+pacing_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (pacing_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define pacing_log(fmt, ...)
+#endif
+
+static uint64_t
+pacing_now(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq = { .QuadPart = 0 };
+    LARGE_INTEGER        count;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+
+    return ((count.QuadPart / freq.QuadPart) * PACING_NS) +
+           (((count.QuadPart % freq.QuadPart) * PACING_NS) / freq.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * PACING_NS) + ts.tv_nsec;
+#endif
+}
+
+/* Sleep until the given host time. */
+static void
+pacing_sleep_until(uint64_t target, uint64_t now)
+{
+#ifdef _WIN32
+    uint32_t ms = (uint32_t) ((target - now) / 1000000ULL);
+
+    /* Sleep() cannot do better than the system timer resolution anyway. */
+    plat_delay_ms(ms ? ms : 1);
+#elif defined(__APPLE__)
+    struct timespec ts;
+
+    ts.tv_sec  = (target - now) / PACING_NS;
+    ts.tv_nsec = (target - now) % PACING_NS;
+    while ((nanosleep(&ts, &ts) == -1) && (errno == EINTR))
+        ;
+#else
+    struct timespec ts;
+
+    (void) now;
+    ts.tv_sec  = target / PACING_NS;
+    ts.tv_nsec = target % PACING_NS;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+#endif
+}
+
+/* Update a running average, weighing the new sample by 1/16. */
+static void
+pacing_average(uint64_t *avg, uint64_t *max, uint64_t sample)
+{
+    *avg = *avg - (*avg >> 4) + (sample >> 4);
+    if (sample > *max)
+        *max = sample;
+}
+
+/* Restart the schedule from the current time, dropping any backlog. */
+void
+pacing_reset(void)
+{
+    pacing_slice_ns = force_10ms ? 10000000ULL : 1000000ULL;
+    pacing_base     = pacing_now();
+    pacing_done     = 0;
+}
+
+/* Return the number of slices that are due to run now. */
+int
+pacing_due(void)
+{
+    uint64_t now;
+    uint64_t due;
+    uint64_t behind;
+    uint64_t drift;
+
+    if ((pacing_base == 0) || (pacing_slice_ns != (force_10ms ? 10000000ULL : 1000000ULL)))
+        pacing_reset();
+
+    now = pacing_now();
+    due = (now - pacing_base) / pacing_slice_ns;
+    if (due <= pacing_done)
+        return 0;
+
+    behind = due - pacing_done;
+    if ((behind * pacing_slice_ns) > PACING_MAX_LAG_NS) {
+        /* The host could not keep up, do not try to catch up. */
+        pacing_log("PACING: %" PRIu64 " slices behind, resyncing\n", behind);
+        pacing_stats.resyncs++;
+        pacing_base = now - pacing_slice_ns;
+        pacing_done = 0;
+        behind      = 1;
+    }
+
+    drift = now - (pacing_base + ((pacing_done + 1) * pacing_slice_ns));
+    pacing_average(&pacing_stats.drift_avg_ns, &pacing_stats.drift_max_ns, drift);
+    if (drift > pacing_slice_ns)
+        pacing_stats.late++;
+    pacing_stats.wakeups++;
+
+    return (int) behind;
+}
+
+/* Account for one slice having been run. */
+void
+pacing_advance(void)
+{
+    pacing_done++;
+    pacing_stats.slices++;
+}
+
+/* Sleep until the next batch of slices is due. */
+void
+pacing_sleep(void)
+{
+    uint64_t now;
+    uint64_t target;
+    uint64_t over;
+
+    if (pacing_base == 0)
+        pacing_reset();
+
+    now    = pacing_now();
+    target = pacing_base + ((pacing_done + pacing_batch) * pacing_slice_ns);
+    if (target <= now)
+        return;
+
+    pacing_sleep_until(target, now);
+    pacing_stats.sleeps++;
+
+    now  = pacing_now();
+    over = (now > target) ? (now - target) : 0;
+    pacing_average(&pacing_stats.oversleep_avg_ns, &pacing_stats.oversleep_max_ns, over);
+
+    /* If the host keeps oversleeping by a large part of a slice, wake up
+       less often and run more slices at a time; go back to finer pacing
+       once the wakeups become accurate again. */
+    if ((pacing_stats.oversleep_avg_ns > (pacing_slice_ns >> 1)) && (pacing_batch < PACING_MAX_BATCH)) {
+        pacing_batch++;
+        pacing_log("PACING: Oversleeping by %" PRIu64 " ns, batch now %i\n",
+                   pacing_stats.oversleep_avg_ns, pacing_batch);
+    } else if ((pacing_stats.oversleep_avg_ns < (pacing_slice_ns >> 3)) && (pacing_batch > 1)) {
+        pacing_batch--;
+        pacing_log("PACING: Oversleeping by %" PRIu64 " ns, batch now %i\n",
+                   pacing_stats.oversleep_avg_ns, pacing_batch);
+    }
+}
+
+void
+pacing_get_stats(pacing_stats_t *stats)
+{
+    memcpy(stats, &pacing_stats, sizeof(pacing_stats_t));
+    stats->batch = pacing_batch;
+}
+
+void
+pacing_log_stats(void)
+{
+    pacing_log("PACING: %" PRIu64 " slices in %" PRIu64 " wakeups, %" PRIu64 " sleeps, "
+               "%" PRIu64 " late, %" PRIu64 " resyncs\n",
+               pacing_stats.slices, pacing_stats.wakeups, pacing_stats.sleeps,
+               pacing_stats.late, pacing_stats.resyncs);
+    pacing_log("PACING: Drift %" PRIu64 " ns average, %" PRIu64 " ns worst; "
+               "oversleep %" PRIu64 " ns average, %" PRIu64 " ns worst; batch %i\n",
+               pacing_stats.drift_avg_ns, pacing_stats.drift_max_ns,
+               pacing_stats.oversleep_avg_ns, pacing_stats.oversleep_max_ns, pacing_batch);
+}
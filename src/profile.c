@@ -0,0 +1,333 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Per-device host time profiler.
+ *
+ *          The timer, I/O, memory mapping, sound and dynarec dispatch
+ *          paths time every handler call while profiling is enabled,
+ *          and charge it to the handler and its private data. Handlers
+ *          are then attributed to the device owning that private data,
+ *          and a summary per device is logged periodically. When the
+ *          emulator is built with minitrace and a trace is running,
+ *          the coarser calls are also emitted as trace events.
+ *
+ *          All the dispatch paths run on the emulation thread, which
+ *          is the only one to touch the table.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <time.h>
+#endif
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/plat.h>
+#include <86box/profile.h>
+#ifdef MTR_ENABLED
+#    include <minitrace/minitrace.h>
+#endif
+
+#define PROFILE_NS      1000000000ULL
+#define PROFILE_SUMMARY 16 /* Devices listed in a summary. */
+
+int profile_on       = 0;
+int profile_interval = 10;
+
+const char *profile_kind_names[PROFILE_KINDS] = {
+    "timer", "io_in", "io_out", "mem_read", "mem_write",
+    "codegen_compile", "codegen_exec", "codegen_interp", "sound"
+};
+
+static profile_entry_t profile_table[PROFILE_MAX_ENTRIES];
+static int             profile_used;
+static volatile int    profile_clear_pending;
+static int             profile_seconds;
+
+#ifdef MTR_ENABLED
+/* Memory accesses and compiled blocks are far too frequent to trace. */
+static const uint8_t profile_traced[PROFILE_KINDS] = { 1, 1, 1, 0, 0, 1, 0, 1, 1 };
+#endif
+
+uint64_t
+profile_now(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq = { .QuadPart = 0 };
+    LARGE_INTEGER        count;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+
+    return ((count.QuadPart / freq.QuadPart) * PROFILE_NS) +
+           (((count.QuadPart % freq.QuadPart) * PROFILE_NS) / freq.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * PROFILE_NS) + ts.tv_nsec;
+#endif
+}
+
+static uint32_t
+profile_hash(int kind, const void *func, const void *priv)
+{
+    uint64_t v = ((uint64_t) (uintptr_t) func * 0x9e3779b97f4a7c15ULL) ^
+                 ((uint64_t) (uintptr_t) priv * 0xc2b2ae3d27d4eb4fULL) ^ kind;
+
+    return (uint32_t) (v ^ (v >> 29) ^ (v >> 47));
+}
+
+static void
+profile_name(profile_entry_t *entry)
+{
+    const device_t      *dev = device_get_by_priv(entry->priv);
+    const mem_mapping_t *map;
+
+    if (dev != NULL) {
+        snprintf(entry->name, PROFILE_NAME_LEN, "%s", dev->name);
+        return;
+    }
+
+    switch (entry->kind) {
+        case PROFILE_MEM_READ:
+        case PROFILE_MEM_WRITE:
+            map = (const mem_mapping_t *) entry->func;
+            snprintf(entry->name, PROFILE_NAME_LEN, "Mapping %08X-%08X",
+                     map->base, map->base + map->size - 1);
+            break;
+        case PROFILE_CODEGEN_COMPILE:
+        case PROFILE_CODEGEN_EXEC:
+        case PROFILE_CODEGEN_INTERP:
+            snprintf(entry->name, PROFILE_NAME_LEN, "CPU");
+            break;
+        default:
+            snprintf(entry->name, PROFILE_NAME_LEN, "Handler %p", entry->func);
+            break;
+    }
+}
+
+static void
+profile_clear(void)
+{
+    memset(profile_table, 0, sizeof(profile_table));
+    profile_used          = 0;
+    profile_seconds       = 0;
+    profile_clear_pending = 0;
+}
+
+static profile_entry_t *
+profile_find(int kind, const void *func, const void *priv)
+{
+    uint32_t         slot = profile_hash(kind, func, priv) & (PROFILE_MAX_ENTRIES - 1);
+    profile_entry_t *entry;
+
+    while (1) {
+        entry = &profile_table[slot];
+
+        if (entry->calls == 0) {
+            /* Keep a quarter of the table free so that probing stays short. */
+            if (profile_used >= ((PROFILE_MAX_ENTRIES * 3) / 4))
+                return NULL;
+
+            entry->kind = kind;
+            entry->func = func;
+            entry->priv = priv;
+            profile_name(entry);
+            profile_used++;
+            return entry;
+        }
+
+        if ((entry->func == func) && (entry->priv == priv) && (entry->kind == kind))
+            return entry;
+
+        slot = (slot + 1) & (PROFILE_MAX_ENTRIES - 1);
+    }
+}
+
+/* Charge a handler call started with profile_start() to its handler. For
+   memory mappings, func is the mapping itself. */
+void
+profile_end(int kind, const void *func, const void *priv, uint64_t start)
+{
+    profile_entry_t *entry;
+    uint64_t         ns = profile_now() - start;
+
+    if (profile_clear_pending)
+        profile_clear();
+
+    entry = profile_find(kind, func, priv);
+    if (entry == NULL)
+        return;
+
+    entry->calls++;
+    entry->ns += ns;
+    if (ns > entry->max_ns)
+        entry->max_ns = ns;
+
+#ifdef MTR_ENABLED
+    if (tracing_on && profile_traced[kind]) {
+        double ts = mtr_time_s() - ((double) ns / (double) PROFILE_NS);
+
+        internal_mtr_raw_event(profile_kind_names[kind], entry->name, 'X', &ts);
+    }
+#endif
+}
+
+/* Turn profiling on or off, may be called from any thread. The counters
+   are cleared when profiling is turned on. */
+void
+profile_set(int on)
+{
+    if (on && !profile_on)
+        profile_clear_pending = 1;
+
+    profile_on = !!on;
+}
+
+/* Forget all handlers, must be called whenever devices are closed, as their
+   private data may be reused by other devices. */
+void
+profile_reset(void)
+{
+    profile_clear();
+}
+
+static int
+profile_compare(const void *a, const void *b)
+{
+    const profile_entry_t *ea = (const profile_entry_t *) a;
+    const profile_entry_t *eb = (const profile_entry_t *) b;
+
+    if (ea->ns != eb->ns)
+        return (ea->ns < eb->ns) ? 1 : -1;
+
+    return 0;
+}
+
+/* Copy out up to max used entries, busiest first. Returns their number. */
+int
+profile_get_entries(profile_entry_t *entries, int max)
+{
+    profile_entry_t *sorted;
+    int              count = 0;
+
+    if ((profile_used == 0) || (max <= 0))
+        return 0;
+
+    sorted = malloc(profile_used * sizeof(profile_entry_t));
+    for (int c = 0; (c < PROFILE_MAX_ENTRIES) && (count < profile_used); c++) {
+        if (profile_table[c].calls != 0)
+            sorted[count++] = profile_table[c];
+    }
+
+    qsort(sorted, count, sizeof(profile_entry_t), profile_compare);
+
+    if (count > max)
+        count = max;
+    memcpy(entries, sorted, count * sizeof(profile_entry_t));
+    free(sorted);
+
+    return count;
+}
+
+/* Log the time spent in each device since profiling was last cleared, with
+   a breakdown by kind of handler. */
+void
+profile_dump(void)
+{
+    typedef struct {
+        const char *name;
+        uint64_t    ns;
+        uint64_t    kind_ns[PROFILE_KINDS];
+        uint64_t    calls;
+    } profile_dev_t;
+
+    profile_entry_t *entries;
+    profile_dev_t   *devs;
+    int              nr_entries;
+    int              nr_devs = 0;
+    int              d;
+    char             temp[512];
+    int              len;
+
+    if (profile_used == 0)
+        return;
+
+    entries    = malloc(profile_used * sizeof(profile_entry_t));
+    devs       = calloc(profile_used, sizeof(profile_dev_t));
+    nr_entries = profile_get_entries(entries, profile_used);
+
+    for (int c = 0; c < nr_entries; c++) {
+        for (d = 0; d < nr_devs; d++) {
+            if (!strcmp(devs[d].name, entries[c].name))
+                break;
+        }
+        if (d == nr_devs)
+            devs[nr_devs++].name = entries[c].name;
+
+        devs[d].ns += entries[c].ns;
+        devs[d].kind_ns[entries[c].kind] += entries[c].ns;
+        devs[d].calls += entries[c].calls;
+    }
+
+    for (int c = 0; c < nr_devs; c++) {
+        for (d = c + 1; d < nr_devs; d++) {
+            if (devs[d].ns > devs[c].ns) {
+                profile_dev_t t = devs[c];
+                devs[c]         = devs[d];
+                devs[d]         = t;
+            }
+        }
+    }
+
+    pclog("PROFILE: %i second(s), %i handlers\n", profile_seconds, profile_used);
+    for (int c = 0; (c < nr_devs) && (c < PROFILE_SUMMARY); c++) {
+        len = snprintf(temp, sizeof(temp), "PROFILE: %-40s %10" PRIu64 " us %12" PRIu64 " calls",
+                       devs[c].name, devs[c].ns / 1000, devs[c].calls);
+        for (int k = 0; k < PROFILE_KINDS; k++) {
+            if (devs[c].kind_ns[k] && (len < (int) sizeof(temp)))
+                len += snprintf(temp + len, sizeof(temp) - len, ", %s %" PRIu64 " us",
+                                profile_kind_names[k], devs[c].kind_ns[k] / 1000);
+        }
+        pclog("%s\n", temp);
+    }
+
+    free(devs);
+    free(entries);
+}
+
+/* Called by the main loop once per emulated second. */
+void
+profile_tick(void)
+{
+    if (!profile_on)
+        return;
+
+    if (profile_clear_pending)
+        profile_clear();
+
+    profile_seconds++;
+    if (profile_interval && !(profile_seconds % profile_interval))
+        profile_dump();
+}
@@ -96,6 +96,8 @@ extern "C" {
 #include <86box/keyboard.h>
 #include "cpu.h"
 #include <86box/timer.h>
+#include <86box/pacing.h>
+#include <86box/benchmark.h>
 #include <86box/nvr.h>
 extern int  qt_nvr_save(void);
 extern void exit_pause(void);
@@ -437,25 +439,32 @@ void
 main_thread_fn()
 {
     int frames;
+    int due;
 
     QThread::currentThread()->setPriority(QThread::HighestPriority);
     plat_set_thread_name(nullptr, "main_thread");
     framecountx = 0;
     // title_update = 1;
-    uint64_t old_time = elapsed_timer.elapsed();
-    int      drawits = frames = 0;
-    is_cpu_thread             = 1;
+    frames        = 0;
+    is_cpu_thread = 1;
+    pacing_reset();
+    if (benchmark_seconds) {
+        /* Run unpaced and with no sound output. */
+        fast_forward = true;
+        benchmark_start();
+    }
     while (!is_quit && cpu_thread_run) {
         /* See if it is time to run a frame of code. */
-        const uint64_t new_time = elapsed_timer.elapsed();
 #ifdef USE_GDBSTUB
-        if (gdbstub_next_asap && (drawits <= 0))
-            drawits = force_10ms ? 10 : 1;
-        else
+        if (gdbstub_next_asap || fast_forward)
+#else
+        if (fast_forward)
 #endif
-            drawits += static_cast<int>(new_time - old_time);
-        old_time = new_time;
-        if ((drawits > 0 || fast_forward) && !dopause) {
+            due = -1;
+        else
+            due = pacing_due();
+
+        if (due && !dopause) {
             /* Yes, so run frames now. */
             do {
 #ifdef USE_INSTRUMENT
@@ -473,21 +482,27 @@ main_thread_fn()
                         break;
                 }
 #endif
+                if (benchmark_seconds && benchmark_done()) {
+                    benchmark_report();
+                    cpu_thread_run = 0;
+                    break;
+                }
+
                 /* Every 2 emulated seconds we save the machine status. */
                 if (++frames >= (force_10ms ? 200 : 2000) && nvr_dosave) {
                     qt_nvr_save();
                     nvr_dosave = 0;
                     frames     = 0;
                 }
-                
-                drawits -= force_10ms ? 10 : 1;
-                if (drawits > 50 || fast_forward)
-                    drawits = 0;
 
-            } while (drawits > 0);
+                if (due < 0) {
+                    /* Not pacing, do not build up a backlog. */
+                    pacing_reset();
+                    break;
+                }
+                pacing_advance();
+            } while (--due && !dopause && !is_quit);
         } else {
-            /* Just so we dont overload the host OS. */
-
             /* Trigger a hard reset if one is pending. */
             if (hard_reset_pending) {
                 hard_reset_pending = 0;
@@ -495,13 +510,17 @@ main_thread_fn()
                 pc_reset_hard_init();
             }
 
-            if (dopause)
+            if (dopause) {
                 ack_pause();
-
-            plat_delay_ms(1);
+                pacing_reset();
+                plat_delay_ms(1);
+            } else /* Sleep until the next frame is due. */
+                pacing_sleep();
         }
     }
 
+    pacing_log_stats();
+
     cpu_thread_running = false;
     is_quit            = 1;
     for (uint8_t i = 1; i < GFXCARD_MAX; i++) {
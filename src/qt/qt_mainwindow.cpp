@@ -49,6 +49,7 @@ extern "C" {
 #include <86box/vid_ega.h>
 #include <86box/version.h>
 #include <86box/timer.h>
+#include <86box/profile.h>
 #include <86box/apm.h>
 #include <86box/nvr.h>
 #include <86box/acpi.h>
@@ -445,6 +446,7 @@ MainWindow::MainWindow(QWidget *parent)
     ui->actionHide_tool_bar->setChecked(hide_tool_bar);
     ui->actionShow_non_primary_monitors->setChecked(show_second_monitors);
     ui->actionUpdate_status_bar_icons->setChecked(update_icons);
+    ui->actionDevice_profiling->setChecked(profile_on);
     ui->actionEnable_Discord_integration->setChecked(enable_discord);
     ui->actionApply_fullscreen_stretch_mode_when_maximized->setChecked(video_fullscreen_scale_maximized);
 
@@ -750,8 +752,10 @@ MainWindow::MainWindow(QWidget *parent)
         static auto init_trace = [&] {
             mtr_init("trace.json");
             mtr_start();
+            tracing_on = 1;
         };
         static auto shutdown_trace = [&] {
+            tracing_on = 0;
             mtr_stop();
             mtr_shutdown();
         };
@@ -2113,6 +2117,13 @@ MainWindow::on_actionUpdate_status_bar_icons_triggered()
     status->clearActivity();
 }
 
+void
+MainWindow::on_actionDevice_profiling_triggered()
+{
+    profile_set(!profile_on);
+    ui->actionDevice_profiling->setChecked(profile_on);
+}
+
 void
 MainWindow::toggleFullscreenUI()
 {
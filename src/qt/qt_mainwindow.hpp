@@ -121,6 +121,7 @@ private slots:
     void on_actionHide_status_bar_triggered();
     void on_actionHide_tool_bar_triggered();
     void on_actionUpdate_status_bar_icons_triggered();
+    void on_actionDevice_profiling_triggered();
     void on_actionTake_screenshot_triggered();
     void on_actionTake_raw_screenshot_triggered();
     void on_actionCopy_screenshot_triggered();
@@ -1152,10 +1152,12 @@ OpenGLRenderer::finalize()
 extern void take_screenshot_clipboard_monitor(int sx, int sy, int sw, int sh, int i);
 
 void
-OpenGLRenderer::onBlit(int buf_idx, int x, int y, int w, int h)
+OpenGLRenderer::onBlit(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h)
 {
-    if (notReady())
+    if (notReady()) {
+        uploadAll = true;
         return;
+    }
 
     context->makeCurrent(this);
 
@@ -1163,15 +1165,25 @@ OpenGLRenderer::onBlit(int buf_idx, int x, int y, int w, int h)
         glw.glBindTexture(GL_TEXTURE_2D, scene_texture.id);
         glw.glTexImage2D(GL_TEXTURE_2D, 0, (GLenum) QOpenGLTexture::RGB8_UNorm, w, h, 0, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, NULL);
         glw.glBindTexture(GL_TEXTURE_2D, 0);
+        uploadAll = true;
     }
 
     source.setRect(x, y, w, h);
 
-    glw.glBindTexture(GL_TEXTURE_2D, scene_texture.id);
-    glw.glPixelStorei(GL_UNPACK_ROW_LENGTH, 2048);
-    glw.glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, (const void *) ((uintptr_t) imagebufs[buf_idx].get() + (uintptr_t) (2048 * 4 * y + x * 4)));
-    glw.glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glw.glBindTexture(GL_TEXTURE_2D, 0);
+    /* Only upload the band of lines that changed since the last frame. */
+    if (uploadAll) {
+        dirty_y   = 0;
+        dirty_h   = h;
+        uploadAll = false;
+    }
+
+    if (dirty_h > 0) {
+        glw.glBindTexture(GL_TEXTURE_2D, scene_texture.id);
+        glw.glPixelStorei(GL_UNPACK_ROW_LENGTH, 2048);
+        glw.glTexSubImage2D(GL_TEXTURE_2D, 0, 0, dirty_y, w, dirty_h, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, (const void *) ((uintptr_t) imagebufs[buf_idx].get() + (uintptr_t) (2048 * 4 * (y + dirty_y) + x * 4)));
+        glw.glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glw.glBindTexture(GL_TEXTURE_2D, 0);
+    }
 
     buf_usage[buf_idx].clear();
     source.setRect(x, y, w, h);
@@ -74,7 +74,7 @@ signals:
     void errorInitializing();
 
 public slots:
-    void onBlit(int buf_idx, int x, int y, int w, int h);
+    void onBlit(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h);
 
 protected:
     void exposeEvent(QExposeEvent *event) override;
@@ -90,6 +90,7 @@ private:
 
     bool isInitialized = false;
     bool isFinalized   = false;
+    bool uploadAll     = true; /* The texture does not hold the last frame. */
 
     int max_texture_size = 65536;
     int frameCounter     = 0;
@@ -464,6 +464,7 @@ RendererStack::createRenderer(Renderer renderer)
     rendererWindow->r_monitor_index = m_monitor_index;
 
     currentBuf = 0;
+    imagebufDirty.clear();
 
     if (renderer != Renderer::OpenGL3 && renderer != Renderer::Vulkan) {
         imagebufs        = rendererWindow->getBuffers();
@@ -502,26 +503,56 @@ take_screenshot_clipboard_monitor(int sx, int sy, int sw, int sh, int i)
 void
 RendererStack::blit(int x, int y, int w, int h)
 {
-    if ((x < 0) || (y < 0) || (w <= 0) || (h <= 0) || (w > 2048) || (h > 2048) || ((w + y) > 2048) || ((h + x) > 2048) || (switchInProgress) || (monitors[m_monitor_index].target_buffer == NULL) || imagebufs.empty() || std::get<std::atomic_flag *>(imagebufs[currentBuf])->test_and_set()) {
+    static_assert(std::tuple_size<DirtyMask>::value == VIDEO_DIRTY_WORDS, "Dirty mask size mismatch");
+
+    /* Keep the damage of frames that get dropped for the next one. */
+    video_blit_add_dirty_monitor(pendingDirty.data(), m_monitor_index);
+
+    if ((x < 0) || (y < 0) || (w <= 0) || (h <= 0) || (w > 2048) || (h > 2048) || ((w + y) > 2048) || ((h + x) > 2048) || (switchInProgress) || (monitors[m_monitor_index].blit_buffer == NULL) || imagebufs.empty() || std::get<std::atomic_flag *>(imagebufs[currentBuf])->test_and_set()) {
         video_blit_complete_monitor(m_monitor_index);
         return;
     }
+
+    /* A buffer only needs the lines that changed since it was last filled,
+       unless the renderer or the blit area has changed in between. */
+    if ((imagebufDirty.size() != imagebufs.size()) || (x != sx) || (y != sy) || (w != sw) || (h != sh)) {
+        pendingDirty.fill(0xffffffff);
+        imagebufDirty.assign(imagebufs.size(), pendingDirty);
+    } else {
+        for (auto &dirty : imagebufDirty) {
+            for (size_t i = 0; i < dirty.size(); i++)
+                dirty[i] |= pendingDirty[i];
+        }
+    }
+
     sx = x;
     sy = y;
     sw = this->w = w;
     sh = this->h       = h;
-    uint8_t *imagebits = std::get<uint8_t *>(imagebufs[currentBuf]);
+    uint8_t   *imagebits = std::get<uint8_t *>(imagebufs[currentBuf]);
+    DirtyMask &bufDirty  = imagebufDirty[currentBuf];
+    int        firstLine = -1;
+    int        lastLine  = -1;
     for (int y1 = y; y1 < (y + h); y1++) {
-        auto scanline = imagebits + (y1 * rendererWindow->getBytesPerRow()) + (x * 4);
-        video_copy(scanline, &(monitors[m_monitor_index].target_buffer->line[y1][x]), w * 4);
+        if (bufDirty[y1 >> 5] & (1U << (y1 & 31))) {
+            auto scanline = imagebits + (y1 * rendererWindow->getBytesPerRow()) + (x * 4);
+            video_copy(scanline, &(monitors[m_monitor_index].blit_buffer->line[y1][x]), w * 4);
+        }
+        if (pendingDirty[y1 >> 5] & (1U << (y1 & 31))) {
+            if (firstLine == -1)
+                firstLine = y1 - y;
+            lastLine = y1 - y;
+        }
     }
+    bufDirty.fill(0);
+    pendingDirty.fill(0);
 
     if (monitors[m_monitor_index].mon_screenshots_raw) {
         video_screenshot_monitor((uint32_t *) imagebits, x, y, 2048, m_monitor_index);
     }
     video_blit_complete_monitor(m_monitor_index);
     screenshot_buf = (uint32_t *) imagebits;
-    emit blitToRenderer(currentBuf, sx, sy, sw, sh);
+    emit blitToRenderer(currentBuf, sx, sy, sw, sh, (firstLine == -1) ? 0 : firstLine, (firstLine == -1) ? 0 : (lastLine - firstLine + 1));
     currentBuf = (currentBuf + 1) % imagebufs.size();
 }
 
@@ -10,6 +10,7 @@
 #include <QCursor>
 #include <QScreen>
 
+#include <array>
 #include <atomic>
 #include <memory>
 #include <tuple>
@@ -108,7 +109,7 @@ public:
     void (*mouse_exit_func)() = nullptr;
 
 signals:
-    void blitToRenderer(int buf_idx, int x, int y, int w, int h);
+    void blitToRenderer(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h);
     void rendererChanged();
 
 public slots:
@@ -136,6 +137,12 @@ private:
 
     std::vector<std::tuple<uint8_t *, std::atomic_flag *>> imagebufs;
 
+    /* One bit per line of the target buffer, see VIDEO_DIRTY_WORDS. */
+    using DirtyMask = std::array<uint32_t, 2048 / 32>;
+
+    DirtyMask              pendingDirty {}; /* Changed since the last emitted frame. */
+    std::vector<DirtyMask> imagebufDirty;   /* Changed since each buffer was last filled. */
+
     RendererCommon          *rendererWindow { nullptr };
     std::unique_ptr<QWidget> current;
 
@@ -66,6 +66,7 @@ const uint8_t scsi_disk_command_flags[0x100] = {
     [0x2a ... 0x2b] = IMPLEMENTED | CHECK_READY,
     [0x2e]          = IMPLEMENTED | CHECK_READY,
     [0x2f]          = IMPLEMENTED | CHECK_READY | SCSI_ONLY,
+    [0x35]          = IMPLEMENTED | CHECK_READY,
     [0x41]          = IMPLEMENTED | CHECK_READY,
     [0x55]          = IMPLEMENTED,
     [0x5a]          = IMPLEMENTED,
@@ -1128,6 +1129,9 @@ scsi_disk_command(scsi_common_t *sc, const uint8_t *cdb)
                 dev->drv->seek_pos = dev->sector_pos;
                 dev->drv->seek_len = dev->sector_len;
 
+                /* Fetch the whole transfer in one request rather than per block. */
+                hdd_image_prefetch(dev->id, dev->sector_pos, dev->sector_len);
+
                 const int ret = scsi_disk_blocks(dev, &alloc_length, 0);
                 alloc_length  = dev->requested_blocks * 512;
 
@@ -1471,6 +1475,14 @@ atapi_out:
             scsi_disk_command_complete(dev);
             break;
 
+        case GPCMD_SYNCHRONIZE_CACHE:
+            /* Writes out anything the image is holding back. */
+            hdd_image_sync(dev->id);
+
+            scsi_disk_set_phase(dev, SCSI_PHASE_STATUS);
+            scsi_disk_command_complete(dev);
+            break;
+
         case GPCMD_SEEK_6:
         case GPCMD_SEEK_10:
             switch (cdb[0]) {
@@ -57,6 +57,8 @@ static int         midi_freq     = 44100;
 static int         midi_buf_size = 4410;
 static int         initialized   = 0;
 static int         sources       = 2;
+static int         last_muted    = -1;
+static int         last_gain     = 0;
 static ALCcontext *Context;
 static ALCdevice  *Device;
 
@@ -311,6 +313,7 @@ inital(void)
         free(hdd_buf_int16);
     }
 
+    last_muted  = -1;
     initialized = 1;
 }
 
@@ -333,8 +336,14 @@ givealbuffer_common(const void *buf, const uint8_t src, const int size, const in
 
     alGetSourcei(source[src], AL_BUFFERS_PROCESSED, &processed);
     if (processed >= 1) {
-        const double gain = (sound_muted) ? 0.0 : pow(10.0, (double) sound_gain / 20.0);
-        alListenerf(AL_GAIN, (float) gain);
+        /* The listener gain is shared by all the sources, only update it
+           when the gain setting changes. */
+        if ((sound_muted != last_muted) || (sound_gain != last_gain)) {
+            const double gain = (sound_muted) ? 0.0 : pow(10.0, (double) sound_gain / 20.0);
+            alListenerf(AL_GAIN, (float) gain);
+            last_muted = sound_muted;
+            last_gain  = sound_gain;
+        }
 
         alSourceUnqueueBuffers(source[src], 1, &buffer);
 
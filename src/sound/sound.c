@@ -31,6 +31,7 @@
 #include <86box/machine.h>
 #include <86box/midi.h>
 #include <86box/plat.h>
+#include <86box/profile.h>
 #include <86box/thread.h>
 #include <86box/snd_ac97.h>
 #include <86box/timer.h>
@@ -39,6 +40,13 @@
 #include <86box/fdd_audio.h>
 #include <86box/hdd_audio.h>
 
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__)) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    define USE_SSE2
+#    include <emmintrin.h>
+#endif
+
+#define SOUND_HANDLERS_MAX 8
+
 typedef struct {
     const device_t *device;
 } SOUND_CARD;
@@ -46,35 +54,42 @@ typedef struct {
 typedef struct {
     void (*get_buffer)(int32_t *buffer, int len, void *priv);
     void *priv;
+    float gain;
 } sound_handler_t;
 
+/* One mixing bus. Handlers at unity gain add their output straight into the
+   integer buffer, as they always have; if any handler has a different gain,
+   the bus is mixed in float32, with each of those handlers rendered into the
+   scratch buffer and accumulated with its gain. */
+typedef struct {
+    sound_handler_t handlers[SOUND_HANDLERS_MAX];
+    int             handlers_num;
+    int             gain_num;  /* Handlers with a gain other than 1.0. */
+    int             len;       /* Samples per channel per period. */
+    int32_t        *buffer;
+    int32_t        *scratch;
+    float          *mix;
+    float          *out;
+    int16_t        *out_int16;
+    void          (*give)(const void *buf);
+} sound_bus_t;
+
 int sound_card_current[SOUND_CARD_MAX] = { 0, 0, 0, 0 };
+int sound_card_gain[SOUND_CARD_MAX]    = { 0, 0, 0, 0 };
 int sound_pos_global                   = 0;
 int music_pos_global                   = 0;
 int wavetable_pos_global               = 0;
 int sound_gain                         = 0;
 
-static sound_handler_t sound_handlers[8];
-static sound_handler_t music_handlers[8];
-static sound_handler_t wavetable_handlers[8];
+static sound_bus_t sound_bus     = { .len = SOUNDBUFLEN, .give = givealbuffer };
+static sound_bus_t music_bus     = { .len = MUSICBUFLEN, .give = givealbuffer_music };
+static sound_bus_t wavetable_bus = { .len = WTBUFLEN, .give = givealbuffer_wt };
 
 static double     cd_audio_volume_lut[256];
 
 static thread_t  *sound_cd_thread_h;
 static event_t   *sound_cd_event;
 static event_t   *sound_cd_start_event;
-static int32_t   *outbuffer;
-static float     *outbuffer_ex;
-static int16_t   *outbuffer_ex_int16;
-static int32_t   *outbuffer_m;
-static float     *outbuffer_m_ex;
-static int16_t   *outbuffer_m_ex_int16;
-static int32_t   *outbuffer_w;
-static float     *outbuffer_w_ex;
-static int16_t   *outbuffer_w_ex_int16;
-static int        sound_handlers_num;
-static int        music_handlers_num;
-static int        wavetable_handlers_num;
 static pc_timer_t sound_poll_timer;
 static uint64_t   sound_poll_latch;
 static pc_timer_t music_poll_timer;
@@ -270,12 +285,39 @@ sound_card_get_from_internal_name(const char *s)
     return 0;
 }
 
+/* Apply a gain, in dB, to the handlers a bus gained from index first on. */
+static void
+sound_bus_set_gain(sound_bus_t *bus, int first, int gain)
+{
+    const float g = (float) pow(10.0, (double) gain / 20.0);
+
+    for (int c = first; c < bus->handlers_num; c++) {
+        if (bus->handlers[c].gain != 1.0f)
+            bus->gain_num--;
+        bus->handlers[c].gain = g;
+        if (bus->handlers[c].gain != 1.0f)
+            bus->gain_num++;
+    }
+}
+
 void
 sound_card_init(void)
 {
-    for (uint8_t i = 0; i < SOUND_CARD_MAX; i++)
-        if ((sound_card_current[i] > SOUND_INTERNAL) && (sound_cards[sound_card_current[i]].device))
+    for (uint8_t i = 0; i < SOUND_CARD_MAX; i++) {
+        if ((sound_card_current[i] > SOUND_INTERNAL) && (sound_cards[sound_card_current[i]].device)) {
+            const int sound_first     = sound_bus.handlers_num;
+            const int music_first     = music_bus.handlers_num;
+            const int wavetable_first = wavetable_bus.handlers_num;
+
             device_add_inst(sound_cards[sound_card_current[i]].device, i + 1);
+
+            if (sound_card_gain[i] != 0) {
+                sound_bus_set_gain(&sound_bus, sound_first, sound_card_gain[i]);
+                sound_bus_set_gain(&music_bus, music_first, sound_card_gain[i]);
+                sound_bus_set_gain(&wavetable_bus, wavetable_first, sound_card_gain[i]);
+            }
+        }
+    }
 }
 
 void
@@ -411,97 +453,228 @@ sound_cd_thread(UNUSED(void *param))
     }
 }
 
+/* Mixing kernels. The buffers hold interleaved stereo samples, n is the
+   total number of samples. */
 static void
-sound_realloc_buffers(void)
+sound_mix_int32_to_float(float *dst, const int32_t *src, float scale, int n)
 {
-    if (outbuffer_ex != NULL) {
-        free(outbuffer_ex);
-        outbuffer_ex = NULL;
+    int c = 0;
+
+#ifdef USE_SSE2
+    const __m128 vscale = _mm_set1_ps(scale);
+
+    for (; c <= (n - 8); c += 8) {
+        __m128 a = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) &src[c]));
+        __m128 b = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) &src[c + 4]));
+
+        _mm_storeu_ps(&dst[c], _mm_mul_ps(a, vscale));
+        _mm_storeu_ps(&dst[c + 4], _mm_mul_ps(b, vscale));
     }
+#endif
+
+    for (; c < n; c++)
+        dst[c] = ((float) src[c]) * scale;
+}
+
+/* Saturates to the int16 range. */
+static void
+sound_mix_int32_to_int16(int16_t *dst, const int32_t *src, int n)
+{
+    int c = 0;
 
-    if (outbuffer_ex_int16 != NULL) {
-        free(outbuffer_ex_int16);
-        outbuffer_ex_int16 = NULL;
+#ifdef USE_SSE2
+    for (; c <= (n - 8); c += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *) &src[c]);
+        __m128i b = _mm_loadu_si128((const __m128i *) &src[c + 4]);
+
+        _mm_storeu_si128((__m128i *) &dst[c], _mm_packs_epi32(a, b));
     }
+#endif
 
-    if (sound_is_float) {
-        outbuffer_ex = calloc(SOUNDBUFLEN * 2, sizeof(float));
-        memset(outbuffer_ex, 0x00, SOUNDBUFLEN * 2 * sizeof(float));
-    } else {
-        outbuffer_ex_int16 = calloc(SOUNDBUFLEN * 2, sizeof(int16_t));
-        memset(outbuffer_ex_int16, 0x00, SOUNDBUFLEN * 2 * sizeof(int16_t));
+    for (; c < n; c++) {
+        int32_t v = src[c];
+
+        if (v > 32767)
+            v = 32767;
+        if (v < -32768)
+            v = -32768;
+
+        dst[c] = (int16_t) v;
     }
 }
 
 static void
-music_realloc_buffers(void)
+sound_mix_accumulate(float *dst, const int32_t *src, float gain, int n)
 {
-    if (outbuffer_m_ex != NULL) {
-        free(outbuffer_m_ex);
-        outbuffer_m_ex = NULL;
+    int c = 0;
+
+#ifdef USE_SSE2
+    const __m128 vgain = _mm_set1_ps(gain);
+
+    for (; c <= (n - 4); c += 4) {
+        __m128 v = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) &src[c]));
+
+        _mm_storeu_ps(&dst[c], _mm_add_ps(_mm_loadu_ps(&dst[c]), _mm_mul_ps(v, vgain)));
     }
+#endif
+
+    for (; c < n; c++)
+        dst[c] += ((float) src[c]) * gain;
+}
+
+static void
+sound_mix_scale(float *dst, const float *src, float scale, int n)
+{
+    int c = 0;
+
+#ifdef USE_SSE2
+    const __m128 vscale = _mm_set1_ps(scale);
+
+    for (; c <= (n - 4); c += 4)
+        _mm_storeu_ps(&dst[c], _mm_mul_ps(_mm_loadu_ps(&src[c]), vscale));
+#endif
 
-    if (outbuffer_m_ex_int16 != NULL) {
-        free(outbuffer_m_ex_int16);
-        outbuffer_m_ex_int16 = NULL;
+    for (; c < n; c++)
+        dst[c] = src[c] * scale;
+}
+
+/* Clamps and truncates to int16, like the integer path does. */
+static void
+sound_mix_float_to_int16(int16_t *dst, const float *src, int n)
+{
+    int c = 0;
+
+#ifdef USE_SSE2
+    const __m128 vmax = _mm_set1_ps(32767.0f);
+    const __m128 vmin = _mm_set1_ps(-32768.0f);
+
+    for (; c <= (n - 8); c += 8) {
+        __m128i a = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[c]), vmin), vmax));
+        __m128i b = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[c + 4]), vmin), vmax));
+
+        _mm_storeu_si128((__m128i *) &dst[c], _mm_packs_epi32(a, b));
     }
+#endif
+
+    for (; c < n; c++) {
+        float v = src[c];
 
-    if (sound_is_float) {
-        outbuffer_m_ex = calloc(MUSICBUFLEN * 2, sizeof(float));
-        memset(outbuffer_m_ex, 0x00, MUSICBUFLEN * 2 * sizeof(float));
-    } else {
-        outbuffer_m_ex_int16 = calloc(MUSICBUFLEN * 2, sizeof(int16_t));
-        memset(outbuffer_m_ex_int16, 0x00, MUSICBUFLEN * 2 * sizeof(int16_t));
+        if (v > 32767.0f)
+            v = 32767.0f;
+        if (v < -32768.0f)
+            v = -32768.0f;
+
+        dst[c] = (int16_t) v;
     }
 }
 
 static void
-wavetable_realloc_buffers(void)
+sound_bus_realloc_buffers(sound_bus_t *bus)
 {
-    if (outbuffer_w_ex != NULL) {
-        free(outbuffer_w_ex);
-        outbuffer_w_ex = NULL;
+    if (bus->out != NULL) {
+        free(bus->out);
+        bus->out = NULL;
     }
 
-    if (outbuffer_w_ex_int16 != NULL) {
-        free(outbuffer_w_ex_int16);
-        outbuffer_w_ex_int16 = NULL;
+    if (bus->out_int16 != NULL) {
+        free(bus->out_int16);
+        bus->out_int16 = NULL;
     }
 
-    if (sound_is_float) {
-        outbuffer_w_ex = calloc(WTBUFLEN * 2, sizeof(float));
-        memset(outbuffer_w_ex, 0x00, WTBUFLEN * 2 * sizeof(float));
-    } else {
-        outbuffer_w_ex_int16 = calloc(WTBUFLEN * 2, sizeof(int16_t));
-        memset(outbuffer_w_ex_int16, 0x00, WTBUFLEN * 2 * sizeof(int16_t));
-    }
+    if (sound_is_float)
+        bus->out = calloc(bus->len * 2, sizeof(float));
+    else
+        bus->out_int16 = calloc(bus->len * 2, sizeof(int16_t));
 }
 
-void
-sound_init(void)
+static void
+sound_bus_init(sound_bus_t *bus)
 {
-    int available_cdrom_drives = 0;
+    bus->out       = NULL;
+    bus->out_int16 = NULL;
+
+    bus->buffer  = calloc(bus->len * 2, sizeof(int32_t));
+    bus->scratch = calloc(bus->len * 2, sizeof(int32_t));
+    bus->mix     = calloc(bus->len * 2, sizeof(float));
+}
+
+static void
+sound_bus_reset(sound_bus_t *bus)
+{
+    bus->handlers_num = 0;
+    bus->gain_num     = 0;
+    memset(bus->handlers, 0x00, SOUND_HANDLERS_MAX * sizeof(sound_handler_t));
+}
+
+static void
+sound_bus_add_handler(sound_bus_t *bus, void (*get_buffer)(int32_t *buffer, int len, void *priv), void *priv)
+{
+    bus->handlers[bus->handlers_num].get_buffer = get_buffer;
+    bus->handlers[bus->handlers_num].priv       = priv;
+    bus->handlers[bus->handlers_num].gain       = 1.0f;
+    bus->handlers_num++;
+}
+
+static void
+sound_bus_get_buffer(sound_handler_t *handler, int32_t *buffer, int len)
+{
+    uint64_t prof = profile_start();
+
+    handler->get_buffer(buffer, len, handler->priv);
+
+    if (prof)
+        profile_end(PROFILE_SOUND, (const void *) handler->get_buffer, handler->priv, prof);
+}
+
+/* Run all the handlers of a bus for one period and hand the result to the
+   sound backend. */
+static void
+sound_bus_poll(sound_bus_t *bus)
+{
+    const int n = bus->len * 2;
 
-    outbuffer_ex       = NULL;
-    outbuffer_ex_int16 = NULL;
+    memset(bus->buffer, 0x00, n * sizeof(int32_t));
+
+    for (int c = 0; c < bus->handlers_num; c++) {
+        if (bus->handlers[c].gain == 1.0f)
+            sound_bus_get_buffer(&bus->handlers[c], bus->buffer, bus->len);
+    }
 
-    outbuffer_m_ex       = NULL;
-    outbuffer_m_ex_int16 = NULL;
+    if (bus->gain_num) {
+        sound_mix_int32_to_float(bus->mix, bus->buffer, 1.0f, n);
 
-    outbuffer_w_ex       = NULL;
-    outbuffer_w_ex_int16 = NULL;
+        for (int c = 0; c < bus->handlers_num; c++) {
+            if (bus->handlers[c].gain == 1.0f)
+                continue;
 
-    outbuffer = NULL;
-    outbuffer = calloc(SOUNDBUFLEN * 2, sizeof(int32_t));
-    memset(outbuffer, 0x00, SOUNDBUFLEN * 2 * sizeof(int32_t));
+            memset(bus->scratch, 0x00, n * sizeof(int32_t));
+            sound_bus_get_buffer(&bus->handlers[c], bus->scratch, bus->len);
+            sound_mix_accumulate(bus->mix, bus->scratch, bus->handlers[c].gain, n);
+        }
 
-    outbuffer_m = NULL;
-    outbuffer_m = calloc(MUSICBUFLEN * 2, sizeof(int32_t));
-    memset(outbuffer_m, 0x00, MUSICBUFLEN * 2 * sizeof(int32_t));
+        if (sound_is_float)
+            sound_mix_scale(bus->out, bus->mix, 1.0f / 32768.0f, n);
+        else
+            sound_mix_float_to_int16(bus->out_int16, bus->mix, n);
+    } else if (sound_is_float)
+        sound_mix_int32_to_float(bus->out, bus->buffer, 1.0f / 32768.0f, n);
+    else
+        sound_mix_int32_to_int16(bus->out_int16, bus->buffer, n);
 
-    outbuffer_w = NULL;
-    outbuffer_w = calloc(WTBUFLEN * 2, sizeof(int32_t));
-    memset(outbuffer_w, 0x00, WTBUFLEN * 2 * sizeof(int32_t));
+    if (sound_is_float)
+        bus->give(bus->out);
+    else
+        bus->give(bus->out_int16);
+}
+
+void
+sound_init(void)
+{
+    int available_cdrom_drives = 0;
+
+    sound_bus_init(&sound_bus);
+    sound_bus_init(&music_bus);
+    sound_bus_init(&wavetable_bus);
 
     for (uint16_t i = 0; i < 256; i++) {
         double di = (double) i;
@@ -542,25 +715,19 @@ sound_init(void)
 void
 sound_add_handler(void (*get_buffer)(int32_t *buffer, int len, void *priv), void *priv)
 {
-    sound_handlers[sound_handlers_num].get_buffer = get_buffer;
-    sound_handlers[sound_handlers_num].priv       = priv;
-    sound_handlers_num++;
+    sound_bus_add_handler(&sound_bus, get_buffer, priv);
 }
 
 void
 music_add_handler(void (*get_buffer)(int32_t *buffer, int len, void *priv), void *priv)
 {
-    music_handlers[music_handlers_num].get_buffer = get_buffer;
-    music_handlers[music_handlers_num].priv       = priv;
-    music_handlers_num++;
+    sound_bus_add_handler(&music_bus, get_buffer, priv);
 }
 
 void
 wavetable_add_handler(void (*get_buffer)(int32_t *buffer, int len, void *priv), void *priv)
 {
-    wavetable_handlers[wavetable_handlers_num].get_buffer = get_buffer;
-    wavetable_handlers[wavetable_handlers_num].priv       = priv;
-    wavetable_handlers_num++;
+    sound_bus_add_handler(&wavetable_bus, get_buffer, priv);
 }
 
 void
@@ -590,30 +757,7 @@ sound_poll(UNUSED(void *priv))
 
     sound_pos_global++;
     if (sound_pos_global == SOUNDBUFLEN) {
-        int c;
-
-        memset(outbuffer, 0x00, SOUNDBUFLEN * 2 * sizeof(int32_t));
-
-        for (c = 0; c < sound_handlers_num; c++)
-            sound_handlers[c].get_buffer(outbuffer, SOUNDBUFLEN, sound_handlers[c].priv);
-
-        for (c = 0; c < SOUNDBUFLEN * 2; c++) {
-            if (sound_is_float)
-                outbuffer_ex[c] = ((float) outbuffer[c]) / (float) 32768.0;
-            else {
-                if (outbuffer[c] > 32767)
-                    outbuffer[c] = 32767;
-                if (outbuffer[c] < -32768)
-                    outbuffer[c] = -32768;
-
-                outbuffer_ex_int16[c] = (int16_t) outbuffer[c];
-            }
-        }
-
-        if (sound_is_float)
-            givealbuffer(outbuffer_ex);
-        else
-            givealbuffer(outbuffer_ex_int16);
+        sound_bus_poll(&sound_bus);
 
         if (cd_thread_enable) {
             cd_buf_update--;
@@ -641,30 +785,7 @@ music_poll(UNUSED(void *priv))
 
     music_pos_global++;
     if (music_pos_global == MUSICBUFLEN) {
-        int c;
-
-        memset(outbuffer_m, 0x00, MUSICBUFLEN * 2 * sizeof(int32_t));
-
-        for (c = 0; c < music_handlers_num; c++)
-            music_handlers[c].get_buffer(outbuffer_m, MUSICBUFLEN, music_handlers[c].priv);
-
-        for (c = 0; c < MUSICBUFLEN * 2; c++) {
-            if (sound_is_float)
-                outbuffer_m_ex[c] = ((float) outbuffer_m[c]) / (float) 32768.0;
-            else {
-                if (outbuffer_m[c] > 32767)
-                    outbuffer_m[c] = 32767;
-                if (outbuffer_m[c] < -32768)
-                    outbuffer_m[c] = -32768;
-
-                outbuffer_m_ex_int16[c] = (int16_t) outbuffer_m[c];
-            }
-        }
-
-        if (sound_is_float)
-            givealbuffer_music(outbuffer_m_ex);
-        else
-            givealbuffer_music(outbuffer_m_ex_int16);
+        sound_bus_poll(&music_bus);
 
         music_pos_global = 0;
     }
@@ -677,30 +798,7 @@ wavetable_poll(UNUSED(void *priv))
 
     wavetable_pos_global++;
     if (wavetable_pos_global == WTBUFLEN) {
-        int c;
-
-        memset(outbuffer_w, 0x00, WTBUFLEN * 2 * sizeof(int32_t));
-
-        for (c = 0; c < wavetable_handlers_num; c++)
-            wavetable_handlers[c].get_buffer(outbuffer_w, WTBUFLEN, wavetable_handlers[c].priv);
-
-        for (c = 0; c < WTBUFLEN * 2; c++) {
-            if (sound_is_float)
-                outbuffer_w_ex[c] = ((float) outbuffer_w[c]) / (float) 32768.0;
-            else {
-                if (outbuffer_w[c] > 32767)
-                    outbuffer_w[c] = 32767;
-                if (outbuffer_w[c] < -32768)
-                    outbuffer_w[c] = -32768;
-
-                outbuffer_w_ex_int16[c] = (int16_t) outbuffer_w[c];
-            }
-        }
-
-        if (sound_is_float)
-            givealbuffer_wt(outbuffer_w_ex);
-        else
-            givealbuffer_wt(outbuffer_w_ex_int16);
+        sound_bus_poll(&wavetable_bus);
 
         wavetable_pos_global = 0;
     }
@@ -719,11 +817,9 @@ sound_speed_changed(void)
 void
 sound_reset(void)
 {
-    sound_realloc_buffers();
-
-    music_realloc_buffers();
-
-    wavetable_realloc_buffers();
+    sound_bus_realloc_buffers(&sound_bus);
+    sound_bus_realloc_buffers(&music_bus);
+    sound_bus_realloc_buffers(&wavetable_bus);
 
     midi_out_device_init();
     midi_in_device_init();
@@ -731,16 +827,13 @@ sound_reset(void)
     inital();
 
     timer_add(&sound_poll_timer, sound_poll, NULL, 1);
-    sound_handlers_num = 0;
-    memset(sound_handlers, 0x00, 8 * sizeof(sound_handler_t));
+    sound_bus_reset(&sound_bus);
 
     timer_add(&music_poll_timer, music_poll, NULL, 1);
-    music_handlers_num = 0;
-    memset(music_handlers, 0x00, 8 * sizeof(sound_handler_t));
+    sound_bus_reset(&music_bus);
 
     timer_add(&wavetable_poll_timer, wavetable_poll, NULL, 1);
-    wavetable_handlers_num = 0;
-    memset(wavetable_handlers, 0x00, 8 * sizeof(sound_handler_t));
+    sound_bus_reset(&wavetable_bus);
 
     filter_cd_audio   = NULL;
     filter_cd_audio_p = NULL;
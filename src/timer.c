@@ -1,10 +1,12 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #include <86box/86box.h>
 #include "cpu.h"
 #include <86box/timer.h>
+#include <86box/profile.h>
 #include <86box/nv/vid_nv_rivatimer.h>
 
 uint64_t TIMER_USEC;
@@ -14,11 +16,124 @@ uint64_t timer_target;
   the head.*/
 pc_timer_t *timer_head = NULL;
 
+/*When the heap scheduler is in use, enabled timers are instead stored in a
+  binary min-heap, with the first timer to expire at timer_heap[0]. Timers that
+  expire at the same integer timestamp are ordered most recently enabled first,
+  matching the order the sorted list produces.*/
+static pc_timer_t **timer_heap      = NULL;
+static uint32_t     timer_heap_size = 0;
+static uint32_t     timer_heap_len  = 0;
+static uint64_t     timer_heap_seq  = 0;
+
+/* Scheduler requested by the configuration, and the one currently in use. */
+static int timer_sched = TIMER_SCHED_LIST;
+
 /* Are we initialized? */
 int timer_inited = 0;
 
 static void timer_advance_ex(pc_timer_t *timer, int start);
 
+/*True if timer a has to fire before timer b*/
+static __inline int
+timer_heap_before(pc_timer_t *a, pc_timer_t *b)
+{
+    int64_t diff = (int64_t) (a->ts_integer - b->ts_integer);
+
+    if (diff)
+        return diff < 0;
+
+    return a->heap_seq > b->heap_seq;
+}
+
+static __inline void
+timer_heap_place(pc_timer_t *timer, uint32_t idx)
+{
+    timer_heap[idx] = timer;
+    timer->heap_idx = idx;
+}
+
+static void
+timer_heap_sift_up(uint32_t idx)
+{
+    pc_timer_t *timer = timer_heap[idx];
+
+    while (idx > 0) {
+        uint32_t parent = (idx - 1) >> 1;
+
+        if (!timer_heap_before(timer, timer_heap[parent]))
+            break;
+
+        timer_heap_place(timer_heap[parent], idx);
+        idx = parent;
+    }
+
+    timer_heap_place(timer, idx);
+}
+
+static void
+timer_heap_sift_down(uint32_t idx)
+{
+    pc_timer_t *timer = timer_heap[idx];
+
+    while (1) {
+        uint32_t child = (idx << 1) + 1;
+
+        if (child >= timer_heap_len)
+            break;
+
+        if (((child + 1) < timer_heap_len) && timer_heap_before(timer_heap[child + 1], timer_heap[child]))
+            child++;
+
+        if (!timer_heap_before(timer_heap[child], timer))
+            break;
+
+        timer_heap_place(timer_heap[child], idx);
+        idx = child;
+    }
+
+    timer_heap_place(timer, idx);
+}
+
+static void
+timer_heap_insert(pc_timer_t *timer)
+{
+    if (timer_heap_len == timer_heap_size) {
+        uint32_t     new_size = timer_heap_size ? (timer_heap_size << 1) : 64;
+        pc_timer_t **new_heap = realloc(timer_heap, new_size * sizeof(pc_timer_t *));
+
+        if (new_heap == NULL)
+            fatal("timer_heap_insert(): Unable to grow the timer heap to %u entries\n", new_size);
+
+        timer_heap      = new_heap;
+        timer_heap_size = new_size;
+    }
+
+    timer->heap_seq = ++timer_heap_seq;
+    timer_heap_place(timer, timer_heap_len++);
+    timer_heap_sift_up(timer->heap_idx);
+
+    timer_target = timer_heap[0]->ts_integer;
+}
+
+static void
+timer_heap_remove(pc_timer_t *timer)
+{
+    uint32_t    idx = timer->heap_idx;
+    pc_timer_t *last;
+
+    if ((idx >= timer_heap_len) || (timer_heap[idx] != timer))
+        fatal("timer_heap_remove(): Timer marked as enabled is not in the heap\n");
+
+    last = timer_heap[--timer_heap_len];
+    if (last != timer) {
+        timer_heap_place(last, idx);
+        if ((idx > 0) && timer_heap_before(last, timer_heap[(idx - 1) >> 1]))
+            timer_heap_sift_up(idx);
+        else
+            timer_heap_sift_down(idx);
+    }
+}
+
 void
 timer_enable(pc_timer_t *timer)
 {
@@ -32,6 +147,11 @@ timer_enable(pc_timer_t *timer)
 
     timer->flags |= TIMER_ENABLED;
 
+    if (timer_sched == TIMER_SCHED_HEAP) {
+        timer_heap_insert(timer);
+        return;
+    }
+
     /*List currently empty - add to head*/
     if (!timer_head) {
         timer_head = timer;
@@ -80,6 +200,13 @@ timer_disable(pc_timer_t *timer)
     if (!timer_inited || (timer == NULL) || !(timer->flags & TIMER_ENABLED))
         return;
 
+    if (timer_sched == TIMER_SCHED_HEAP) {
+        timer->flags &= ~TIMER_ENABLED;
+        timer->in_callback = 0;
+        timer_heap_remove(timer);
+        return;
+    }
+
     if (!timer->next && !timer->prev && timer != timer_head) {
         uint32_t *p = NULL;
         *p = 5;    /* Crash deliberately. */
@@ -102,7 +229,11 @@ timer_disable(pc_timer_t *timer)
 static void
 timer_remove_head(void)
 {
-    if (timer_head) {
+    if (timer_sched == TIMER_SCHED_HEAP) {
+        pc_timer_t *timer = timer_heap[0];
+        timer_heap_remove(timer);
+        timer->flags &= ~TIMER_ENABLED;
+    } else if (timer_head) {
         pc_timer_t *timer = timer_head;
         timer_head = timer->next;
         timer_head->prev = NULL;
@@ -111,14 +242,26 @@ timer_remove_head(void)
     }
 }
 
+static __inline pc_timer_t *
+timer_first(void)
+{
+    if (timer_sched == TIMER_SCHED_HEAP)
+        return timer_heap_len ? timer_heap[0] : NULL;
+
+    return timer_head;
+}
+
 void
 timer_process(void)
 {
-    if (!timer_head)
+    if (!timer_first())
         return;
 
     while (1) {
-        pc_timer_t *timer = timer_head;
+        pc_timer_t *timer = timer_first();
+
+        if (timer == NULL)
+            return;
 
         if (!TIMER_LESS_THAN_VAL(timer, (uint64_t) tsc))
             break;
@@ -134,13 +277,18 @@ timer_process(void)
                have a NULL callback when no operation
                is needed.
              */
+            uint64_t prof = profile_start();
+
             timer->in_callback = 1;
             timer->callback(timer->priv);
             timer->in_callback = 0;
+
+            if (prof)
+                profile_end(PROFILE_TIMER, (const void *) timer->callback, timer->priv, prof);
         }
     }
 
-    timer_target = timer_head->ts_integer;
+    timer_target = timer_first()->ts_integer;
 }
 
 void
@@ -160,6 +308,12 @@ timer_close(void)
 
     timer_head = NULL;
 
+    /* Likewise, mark all timers still in the heap as disabled. */
+    for (uint32_t i = 0; i < timer_heap_len; i++)
+        timer_heap[i]->flags &= ~TIMER_ENABLED;
+
+    timer_heap_len = 0;
+
     timer_inited = 0;
 }
 
@@ -169,6 +323,10 @@ timer_init(void)
     timer_target = 0ULL;
     tsc          = 0;
 
+    /* The queue implementation can only be switched while it is empty. */
+    timer_sched    = (timer_scheduler == TIMER_SCHED_HEAP) ? TIMER_SCHED_HEAP : TIMER_SCHED_LIST;
+    timer_heap_seq = 0;
+
     /* Initialise the CPU-independent timer */
     rivatimer_init();
 
@@ -269,13 +427,25 @@ timer_set_new_tsc(uint64_t new_tsc)
         update_tsc();
 #endif
 
-    if (!timer_head) {
+    if (!timer_first()) {
+        tsc = new_tsc;
+        return;
+    }
+
+    timer_target = new_tsc + (int64_t)(timer_get_ts_int(timer_first()) - (uint64_t)tsc);
+
+    /* Every timer is moved by the same offset, so the heap order is kept. */
+    if (timer_sched == TIMER_SCHED_HEAP) {
+        for (uint32_t i = 0; i < timer_heap_len; i++) {
+            timer = timer_heap[i];
+            timer->ts_integer = new_tsc + (int64_t)(timer_get_ts_int(timer) - (uint64_t)tsc);
+        }
+
         tsc = new_tsc;
         return;
     }
 
     timer = timer_head;
-    timer_target = new_tsc + (int64_t)(timer_get_ts_int(timer_head) - (uint64_t)tsc);
 
     while (timer) {
         int64_t offset_from_current_tsc = (int64_t)(timer_get_ts_int(timer) - (uint64_t)tsc);
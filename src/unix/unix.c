@@ -59,6 +59,8 @@
 #include <86box/unix_osd.h>
 #include "cpu.h"
 #include <86box/timer.h>
+#include <86box/pacing.h>
+#include <86box/benchmark.h>
 #include <86box/nvr.h>
 #include <86box/version.h>
 #include <86box/video.h>
@@ -657,49 +659,66 @@ volatile int cpu_thread_run = 1;
 void
 main_thread(UNUSED(void *param))
 {
-    uint32_t old_time;
-    uint32_t new_time;
-    int      drawits;
-    int      frames;
+    int due;
+    int frames;
 
     SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
     framecountx = 0;
     // title_update = 1;
-    old_time = SDL_GetTicks();
-    drawits = frames = 0;
+    frames = 0;
+    pacing_reset();
+    if (benchmark_seconds) {
+        /* Run unpaced and with no sound output. */
+        fast_forward = true;
+        benchmark_start();
+    }
     while (!is_quit && cpu_thread_run)
     {
         /* See if it is time to run a frame of code. */
-        new_time = SDL_GetTicks();
-
 #ifdef USE_GDBSTUB
-        if (gdbstub_next_asap && (drawits <= 0))
-            drawits = 10;
-        else
-            drawits += (new_time - old_time);
+        if (gdbstub_next_asap || fast_forward)
 #else
-        drawits += (new_time - old_time);
+        if (fast_forward)
 #endif
+            due = -1;
+        else
+            due = pacing_due();
+
+        if (due && !dopause) {
+            /* Yes, so run the frames that are due now. */
+            do {
+                /* Run a block of code. */
+                pc_run();
+
+                if (benchmark_seconds && benchmark_done()) {
+                    benchmark_report();
+                    benchmark_seconds = 0;
+
+                    /* Stay paused until the UI thread has shut us down. */
+                    dopause = 1;
+                    do_stop();
+                    break;
+                }
 
-        old_time = new_time;
-        if ((drawits > 0 || fast_forward) && !dopause) {
-            /* Yes, so do one frame now. */
-            drawits -= force_10ms ? 10 : 1;
-            if (drawits > 50 || fast_forward)
-                drawits = 0;
-
-            /* Run a block of code. */
-            pc_run();
-
-            /* Every 200 frames we save the machine status. */
-            if (++frames >= (force_10ms ? 200 : 2000) && nvr_dosave) {
-                nvr_save();
-                nvr_dosave = 0;
-                frames     = 0;
-            }
-        }
-        else /* Just so we dont overload the host OS. */
+                /* Every 200 frames we save the machine status. */
+                if (++frames >= (force_10ms ? 200 : 2000) && nvr_dosave) {
+                    nvr_save();
+                    nvr_dosave = 0;
+                    frames     = 0;
+                }
+
+                if (due < 0) {
+                    /* Not pacing, do not build up a backlog. */
+                    pacing_reset();
+                    break;
+                }
+                pacing_advance();
+            } while (--due && !dopause && !is_quit);
+        } else if (dopause) {
+            pacing_reset();
             SDL_Delay(1);
+        } else /* Sleep until the next frame is due. */
+            pacing_sleep();
 
         /* If needed, handle a screen resize. */
         if (atomic_load(&doresize_monitors[0]) && !video_fullscreen && !is_quit) {
@@ -713,6 +732,8 @@ main_thread(UNUSED(void *param))
         }
     }
 
+    pacing_log_stats();
+
     is_quit = 1;
 }
 
@@ -1481,9 +1502,10 @@ main(int argc, char **argv)
     } else
         fprintf(stderr, "libedit not found, line editing will be limited.\n");
     mousemutex = SDL_CreateMutex();
-    sdl_initho();
+    if (!benchmark_seconds)
+        sdl_initho();
 
-    if (start_in_fullscreen) {
+    if (start_in_fullscreen && !benchmark_seconds) {
         video_fullscreen = 1;
         sdl_set_fs(1);
     }
@@ -1497,7 +1519,8 @@ main(int argc, char **argv)
     do_start();
 
 #ifndef USE_CLI
-    thread_create(monitor_thread, NULL);
+    if (!benchmark_seconds)
+        thread_create(monitor_thread, NULL);
 #endif
 
     SDL_AddTimer(1000, timer_onesec, NULL);
@@ -253,6 +253,7 @@ ati28800k_out(uint16_t addr, uint8_t val, void *priv)
             if (ati28800->get_korean_font_enabled) {
                 if ((ati28800->get_korean_font_base & 0x7F) > 0x20 && (ati28800->get_korean_font_base & 0x7F) < 0x7F) {
                     fontdatksc5601_user[(ati28800->get_korean_font_kind & 4) * 24 + (ati28800->get_korean_font_base & 0x7F) - 0x20].chr[ati28800->get_korean_font_index] = val;
+                    svga->fullchange = svga->monitor->mon_changeframecount;
                 }
                 ati28800->get_korean_font_index++;
                 ati28800->get_korean_font_index &= 0x1F;
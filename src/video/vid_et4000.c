@@ -435,6 +435,7 @@ et4000k_out(uint16_t addr, uint8_t val, void *priv)
                             default:
                                 break;
                         }
+                        dev->svga.fullchange = dev->svga.monitor->mon_changeframecount;
                         dev->get_korean_font_index++;
                     }
                     break;
@@ -529,6 +530,8 @@ et4000_kasan_out(uint16_t addr, uint8_t val, void *priv)
                 case 6:
                 case 7:
                     et4000->svga.ksc5601_udc_area_msb[et4000->kasan_cfg_index - 0xF6] = val;
+                    et4000->svga.fullchange = et4000->svga.monitor->mon_changeframecount;
+                    fallthrough;
                 default:
                     et4000->kasan_cfg_regs[et4000->kasan_cfg_index - 0xF0] = val;
                     svga_recalctimings(&et4000->svga);
@@ -43,8 +43,9 @@
 #include <86box/vid_svga_render.h>
 #include <86box/vid_xga_device.h>
 
-void svga_doblit(int wx, int wy, svga_t *svga);
-void svga_poll(void *priv);
+void        svga_doblit(int wx, int wy, svga_t *svga);
+static void svga_doblit_common(int wx, int wy, svga_t *svga, int dirty);
+void        svga_poll(void *priv);
 
 svga_t *svga_8514;
 
@@ -318,6 +319,8 @@ svga_out(uint16_t addr, uint8_t val, void *priv)
                     svga->writemask = val & 0xf;
                     break;
                 case 3:
+                    if (o != val)
+                        svga->fullchange = svga->monitor->mon_changeframecount;
                     svga->charsetb = (((val >> 2) & 3) * 0x10000) + 2;
                     svga->charseta = ((val & 3) * 0x10000) + 2;
                     if (val & 0x10)
@@ -338,6 +341,8 @@ svga_out(uint16_t addr, uint8_t val, void *priv)
             }
             break;
         case 0x3c6:
+            if (svga->dac_mask != val)
+                svga->fullchange = svga->monitor->mon_changeframecount;
             svga->dac_mask = val;
             break;
         case 0x3c7:
@@ -1287,39 +1292,70 @@ svga_recalctimings(svga_t *svga)
     }
 }
 
+static void
+svga_mark_dirty(svga_t *svga, int line)
+{
+    line &= 2047;
+    svga->monitor->mon_dirty[line >> 5] |= (1U << (line & 31));
+}
+
 static void
 svga_do_render(svga_t *svga)
 {
+    int lastline_draw;
+
+    if (!svga->override)
+        video_sync_line_monitor(svga->displine + svga->y_add, svga->monitor_index);
+
     /* Always render a blank screen and nothing else while in DPMS mode. */
     if (svga->dpms) {
         svga_render_blank(svga);
+        svga_mark_dirty(svga, svga->displine + svga->y_add);
         return;
     }
 
     if (!svga->override) {
+        /* The renderers only update lastline_draw when they actually draw
+           the line, use that to tell the frontend which lines changed. */
+        lastline_draw       = svga->lastline_draw;
+        svga->lastline_draw = -1;
+
         svga->render_line_offset = svga->start_retrace_latch - svga->crtc[0x4];
         svga->render(svga);
+
+        if ((svga->lastline_draw != -1) || svga->render_override)
+            svga_mark_dirty(svga, svga->displine + svga->y_add);
+        else
+            svga->lastline_draw = lastline_draw;
     }
 
     if (svga->overlay_on) {
-        if (!svga->override && svga->overlay_draw)
+        if (!svga->override && svga->overlay_draw) {
             svga->overlay_draw(svga, svga->displine + svga->y_add);
+            svga_mark_dirty(svga, svga->displine + svga->y_add);
+        }
         svga->overlay_on--;
         if (svga->overlay_on && svga->interlace)
             svga->overlay_on--;
     }
 
     if (svga->dac_hwcursor_on) {
-        if (!svga->override && svga->dac_hwcursor_draw)
+        if (!svga->override && svga->dac_hwcursor_draw) {
+            video_sync_line_monitor(svga->displine + svga->y_add + ((svga->dac_hwcursor_latch.y >= 0) ? 0 : svga->dac_hwcursor_latch.y), svga->monitor_index);
             svga->dac_hwcursor_draw(svga, (svga->displine + svga->y_add + ((svga->dac_hwcursor_latch.y >= 0) ? 0 : svga->dac_hwcursor_latch.y)) & 2047);
+            svga_mark_dirty(svga, svga->displine + svga->y_add + ((svga->dac_hwcursor_latch.y >= 0) ? 0 : svga->dac_hwcursor_latch.y));
+        }
         svga->dac_hwcursor_on--;
         if (svga->dac_hwcursor_on && svga->interlace)
             svga->dac_hwcursor_on--;
     }
 
     if (svga->hwcursor_on) {
-        if (!svga->override && svga->hwcursor_draw)
+        if (!svga->override && svga->hwcursor_draw) {
+            video_sync_line_monitor(svga->displine + svga->y_add + ((svga->hwcursor_latch.y >= 0) ? 0 : svga->hwcursor_latch.y), svga->monitor_index);
             svga->hwcursor_draw(svga, (svga->displine + svga->y_add + ((svga->hwcursor_latch.y >= 0) ? 0 : svga->hwcursor_latch.y)) & 2047);
+            svga_mark_dirty(svga, svga->displine + svga->y_add + ((svga->hwcursor_latch.y >= 0) ? 0 : svga->hwcursor_latch.y));
+        }
 
         svga->hwcursor_on--;
         if (svga->hwcursor_on && svga->interlace)
@@ -1344,6 +1380,7 @@ svga_poll(void *priv)
     int        wy;
     int        ret;
     int        old_ma;
+    uint32_t   old_ca;
 
     svga_log("SVGA Poll.\n");
     if (!svga->linepos) {
@@ -1387,7 +1424,10 @@ svga_poll(void *priv)
             svga->memaddr &= svga->vram_display_mask;
             if (svga->firstline == 2000) {
                 svga->firstline = svga->displine;
-                video_wait_for_buffer_monitor(svga->monitor_index);
+                if (svga->override)
+                    video_wait_for_buffer_monitor(svga->monitor_index);
+                else
+                    video_wait_for_buffer_dirty_monitor(svga->monitor_index);
             }
 
             if (svga->hwcursor_on || svga->dac_hwcursor_on || svga->overlay_on)
@@ -1553,6 +1593,8 @@ svga_poll(void *priv)
 
             if (svga->fullchange)
                 svga->fullchange--;
+            if (svga->cursorchange)
+                svga->cursorchange--;
         }
         if (svga->vc == svga->vsyncstart) {
             svga->dispon = 0;
@@ -1570,11 +1612,11 @@ svga_poll(void *priv)
                 if (svga->vertical_linedbl) {
                     wy = (svga->lastline - svga->firstline) << 1;
                     svga->vdisp = wy + 1;
-                    svga_doblit(wx, wy, svga);
+                    svga_doblit_common(wx, wy, svga, 1);
                 } else {
                     wy = svga->lastline - svga->firstline;
                     svga->vdisp = wy + 1;
-                    svga_doblit(wx, wy, svga);
+                    svga_doblit_common(wx, wy, svga, 1);
                 }
             }
 
@@ -1594,6 +1636,7 @@ svga_poll(void *priv)
             else
                 svga->memaddr = svga->memaddr_backup = svga->memaddr_latch + svga->hblank_sub;
 
+            old_ca               = svga->cursoraddr;
             svga->cursoraddr     = ((svga->crtc[0xe] << 8) | svga->crtc[0xf]) + ((svga->crtc[0xb] & 0x60) >> 5) + svga->ca_adj;
             if (!(svga->adv_flags & FLAG_NO_SHIFT3)) {
                 svga->memaddr     = (svga->memaddr << 2);
@@ -1601,6 +1644,14 @@ svga_poll(void *priv)
             }
             svga->cursoraddr     = (svga->cursoraddr << 2);
 
+            /* The text renderers only draw the lines that changed, make them
+               draw the lines the cursor moved from and to as well. */
+            if ((svga->cursoraddr != old_ca) || (svga->cursorshape != ((svga->crtc[0xa] << 8) | svga->crtc[0xb]))) {
+                svga->cursoraddr_prev = old_ca;
+                svga->cursorshape     = (svga->crtc[0xa] << 8) | svga->crtc[0xb];
+                svga->cursorchange    = svga->monitor->mon_changeframecount;
+            }
+
             if (svga->vsync_callback)
                 svga->vsync_callback(svga);
 
@@ -1712,6 +1763,8 @@ svga_init(const device_t *info, svga_t *svga, void *priv, int memsize,
     svga->conv_16to32                         = svga_conv_16to32;
     svga->render                              = svga_render_blank;
 
+    svga_render_simd_init();
+
     svga->hwcursor.cur_xsize = svga->hwcursor.cur_ysize = 32;
 
     svga->dac_hwcursor.cur_xsize = svga->dac_hwcursor.cur_ysize = 32;
@@ -1846,9 +1899,6 @@ svga_write_common(uint32_t addr, uint8_t val, uint8_t linear, void *priv)
         }
     }
 
-    if (!(svga->gdcreg[6] & 1))
-        svga->fullchange = 2;
-
     if ((svga->adv_flags & FLAG_ADDR_BY16) && (svga->writemode == 4 || svga->writemode == 5))
         addr <<= 4;
     else if ((svga->adv_flags & FLAG_ADDR_BY8) && (svga->writemode < 4))
@@ -1868,6 +1918,12 @@ svga_write_common(uint32_t addr, uint8_t val, uint8_t linear, void *priv)
     } else
         addr <<= 2;
 
+    /* In text modes, the character and attribute planes are tracked through
+       changedvram like everything else, but the font planes are shared by
+       every line on the screen. */
+    if (!(svga->gdcreg[6] & 1) && ((writemask2 & ~0x03) || (svga->writemode >= 4)))
+        svga->fullchange = 2;
+
     addr &= svga->decode_mask;
 
     if (svga->translate_address)
@@ -2130,8 +2186,10 @@ svga_read_linear(uint32_t addr, void *priv)
     return svga_read_common(addr, 1, priv);
 }
 
-void
-svga_doblit(int wx, int wy, svga_t *svga)
+/* If dirty is set, only the lines marked by svga_do_render() are sent to
+   the frontend, unless something affecting the whole frame has changed. */
+static void
+svga_doblit_common(int wx, int wy, svga_t *svga, int dirty)
 {
     int       y_add;
     int       x_add;
@@ -2198,11 +2256,22 @@ svga_doblit(int wx, int wy, svga_t *svga)
 
         if (video_force_resize_get_monitor(svga->monitor_index))
             video_force_resize_set_monitor(0, svga->monitor_index);
+
+        dirty = 0;
+    }
+
+    /* The overscan area is not tracked line by line. */
+    if ((svga->overscan_color != svga->blit_overscan_color) || (svga->dpms != svga->blit_dpms) || (svga->y_add != svga->blit_y_add)) {
+        svga->blit_overscan_color = svga->overscan_color;
+        svga->blit_dpms           = svga->dpms;
+        svga->blit_y_add          = svga->y_add;
+        dirty                     = 0;
     }
 
     if ((wx >= 160) && ((wy + 1) >= 120)) {
         /* Draw (overscan_size - scroll size) lines of overscan on top and bottom. */
         for (i = 0; i < svga->y_add; i++) {
+            video_sync_line_monitor(i, svga->monitor_index);
             p = &svga->monitor->target_buffer->line[i & 0x7ff][0];
 
             for (j = 0; j < (svga->monitor->mon_xsize + x_add); j++)
@@ -2210,6 +2279,7 @@ svga_doblit(int wx, int wy, svga_t *svga)
         }
 
         for (i = 0; i < bottom; i++) {
+            video_sync_line_monitor(svga->monitor->mon_ysize + svga->y_add + i, svga->monitor_index);
             p = &svga->monitor->target_buffer->line[(svga->monitor->mon_ysize + svga->y_add + i) & 0x7ff][0];
 
             for (j = 0; j < (svga->monitor->mon_xsize + x_add); j++)
@@ -2217,12 +2287,21 @@ svga_doblit(int wx, int wy, svga_t *svga)
         }
     }
 
-    video_blit_memtoscreen_monitor(x_start, y_start, svga->monitor->mon_xsize + x_add, svga->monitor->mon_ysize + y_add, svga->monitor_index);
+    if (dirty)
+        video_blit_memtoscreen_dirty_monitor(x_start, y_start, svga->monitor->mon_xsize + x_add, svga->monitor->mon_ysize + y_add, svga->monitor_index);
+    else
+        video_blit_memtoscreen_monitor(x_start, y_start, svga->monitor->mon_xsize + x_add, svga->monitor->mon_ysize + y_add, svga->monitor_index);
 
     if (svga->vertical_linedbl)
         svga->vertical_linedbl >>= 1;
 }
 
+void
+svga_doblit(int wx, int wy, svga_t *svga)
+{
+    svga_doblit_common(wx, wy, svga, 0);
+}
+
 void
 svga_writeb_linear(uint32_t addr, uint8_t val, void *priv)
 {
@@ -132,6 +132,34 @@ svga_render_overscan_right(svga_t *svga)
     }
 }
 
+/* Text lines only need to be drawn again when their characters or attributes
+   were written, or when the cursor moved to or away from them. Font, palette
+   and blink changes set fullchange instead. */
+static int
+svga_text_line_changed(svga_t *svga, int xinc)
+{
+    uint32_t len = ((svga->hdisp + svga->scrollcache + xinc - 1) / xinc) << 2;
+    uint32_t first;
+    uint32_t last;
+
+    if (svga->fullchange)
+        return 1;
+
+    if (svga->cursorchange && (((svga->cursoraddr - svga->memaddr) < len) ||
+                               ((svga->cursoraddr_prev - svga->memaddr) < len)))
+        return 1;
+
+    if (svga->force_old_addr) {
+        first = (svga->memaddr << 1) & svga->vram_display_mask;
+        last  = ((svga->memaddr + len - 4) << 1) & svga->vram_display_mask;
+    } else {
+        first = svga->remap_func(svga, svga->memaddr) & svga->vram_display_mask;
+        last  = svga->remap_func(svga, svga->memaddr + len - 4) & svga->vram_display_mask;
+    }
+
+    return svga->changedvram[first >> 12] || svga->changedvram[last >> 12];
+}
+
 void
 svga_render_text_40(svga_t *svga)
 {
@@ -155,13 +183,14 @@ svga_render_text_40(svga_t *svga)
     if ((svga->displine + svga->y_add) < 0)
         return;
 
-    if (svga->firstline_draw == 2000)
-        svga->firstline_draw = svga->displine;
-    svga->lastline_draw = svga->displine;
+    xinc = (svga->seqregs[1] & 1) ? 16 : 18;
+
+    if (svga_text_line_changed(svga, xinc)) {
+        if (svga->firstline_draw == 2000)
+            svga->firstline_draw = svga->displine;
+        svga->lastline_draw = svga->displine;
 
-    if (svga->fullchange) {
         p    = &svga->monitor->target_buffer->line[(svga->displine + svga->y_add) & 2047][(svga->x_add) & 2047];
-        xinc = (svga->seqregs[1] & 1) ? 16 : 18;
 
         for (int x = 0; x < (svga->hdisp + svga->scrollcache); x += xinc) {
             if (!svga->force_old_addr)
@@ -238,13 +267,14 @@ svga_render_text_80(svga_t *svga)
     if ((svga->displine + svga->y_add) < 0)
         return;
 
-    if (svga->firstline_draw == 2000)
-        svga->firstline_draw = svga->displine;
-    svga->lastline_draw = svga->displine;
+    xinc = (svga->seqregs[1] & 1) ? 8 : 9;
+
+    if (svga_text_line_changed(svga, xinc)) {
+        if (svga->firstline_draw == 2000)
+            svga->firstline_draw = svga->displine;
+        svga->lastline_draw = svga->displine;
 
-    if (svga->fullchange) {
         p    = &svga->monitor->target_buffer->line[(svga->displine + svga->y_add) & 2047][(svga->x_add) & 2047];
-        xinc = (svga->seqregs[1] & 1) ? 8 : 9;
 
         static uint32_t col = 0x00000000;
 
@@ -359,14 +389,14 @@ svga_render_text_80_ksc5601(svga_t *svga)
     if ((svga->displine + svga->y_add) < 0)
         return;
 
-    if (svga->firstline_draw == 2000)
-        svga->firstline_draw = svga->displine;
-    svga->lastline_draw = svga->displine;
+    xinc = (svga->seqregs[1] & 1) ? 8 : 9;
 
-    if (svga->fullchange) {
-        p = &svga->monitor->target_buffer->line[svga->displine + svga->y_add][svga->x_add];
+    if (svga_text_line_changed(svga, xinc)) {
+        if (svga->firstline_draw == 2000)
+            svga->firstline_draw = svga->displine;
+        svga->lastline_draw = svga->displine;
 
-        xinc = (svga->seqregs[1] & 1) ? 8 : 9;
+        p = &svga->monitor->target_buffer->line[svga->displine + svga->y_add][svga->x_add];
 
         for (int x = 0; x < (svga->hdisp + svga->scrollcache); x += xinc) {
             uint32_t addr = svga->remap_func(svga, svga->memaddr) & svga->vram_display_mask;
@@ -725,10 +755,11 @@ svga_render_2bpp_headland_highres(svga_t *svga)
 static void
 svga_render_indexed_gfx(svga_t *svga, bool highres, bool combine8bits)
 {
-    int       x;
-    uint32_t  addr;
-    uint32_t *p;
-    uint32_t  changed_offset;
+    int            x;
+    uint32_t       addr;
+    uint32_t      *p;
+    uint32_t       changed_offset;
+    const uint8_t *src = NULL;
 
     const bool blinked   = !!(svga->blink & 0x10);
     const bool attrblink = (!svga->disable_blink) && ((svga->attrregs[0x10] & 0x08) != 0);
@@ -812,6 +843,21 @@ svga_render_indexed_gfx(svga_t *svga, bool highres, bool combine8bits)
     uint32_t edat         = 0;
     static uint32_t col          = 0;
     static uint32_t col2         = 0;
+
+    /* Packed 8bpp without blinking is a plain palette lookup per byte. */
+    if (combine8bits && highres && highres8bpp && !svga->ati_4color && !svga->packed_4bpp && !svga->half_pixel && !svga->force_old_addr && !svga->remap_required && (svga->render_line_offset >= 0) && (incevery == 1) && (loadevery == 1) && !blinkmask) {
+        x   = (((svga->hdisp + svga->scrollcache) / charwidth) + 1) * charwidth;
+        src = svga_render_linear_src(svga, x);
+    }
+
+    if (src) {
+        svga_render_line_8to32(p, src, svga->map8, (svga->plane_mask * 0x11) & svga->dac_mask, x);
+        col = p[x - 1];
+        svga->memaddr += x;
+        svga->memaddr &= svga->vram_display_mask;
+        return;
+    }
+
     for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += charwidth) {
         if (load_counter == 0) {
             /* Find our address */
@@ -1568,11 +1614,12 @@ svga_render_15bpp_lowres(svga_t *svga)
 void
 svga_render_15bpp_highres(svga_t *svga)
 {
-    int       x;
-    uint32_t *p;
-    uint32_t  dat;
-    uint32_t  changed_addr;
-    uint32_t  addr;
+    int            x;
+    uint32_t      *p;
+    const uint8_t *src;
+    uint32_t       dat;
+    uint32_t       changed_addr;
+    uint32_t       addr;
 
     if ((svga->displine + svga->y_add) < 0)
         return;
@@ -1615,7 +1662,11 @@ svga_render_15bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            if (!svga->remap_required) {
+            x = ((svga->hdisp + svga->scrollcache) & ~7) + 8;
+            if (!svga->remap_required && (svga->conv_16to32 == svga_conv_16to32) && (src = svga_render_linear_src(svga, x << 1))) {
+                svga_render_line_15to32(p, src, x);
+                svga->memaddr += x << 1;
+            } else if (!svga->remap_required) {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
                     dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
                     *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
@@ -1800,11 +1851,12 @@ svga_render_16bpp_lowres(svga_t *svga)
 void
 svga_render_16bpp_highres(svga_t *svga)
 {
-    int       x;
-    uint32_t *p;
-    uint32_t  dat;
-    uint32_t  changed_addr;
-    uint32_t  addr;
+    int            x;
+    uint32_t      *p;
+    const uint8_t *src;
+    uint32_t       dat;
+    uint32_t       changed_addr;
+    uint32_t       addr;
 
     if ((svga->displine + svga->y_add) < 0)
         return;
@@ -1847,7 +1899,11 @@ svga_render_16bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            if (!svga->remap_required) {
+            x = ((svga->hdisp + svga->scrollcache) & ~7) + 8;
+            if (!svga->remap_required && (svga->conv_16to32 == svga_conv_16to32) && (src = svga_render_linear_src(svga, x << 1))) {
+                svga_render_line_16to32(p, src, x);
+                svga->memaddr += x << 1;
+            } else if (!svga->remap_required) {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
                     dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
                     *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
@@ -1961,14 +2017,15 @@ svga_render_24bpp_lowres(svga_t *svga)
 void
 svga_render_24bpp_highres(svga_t *svga)
 {
-    int       x;
-    uint32_t *p;
-    uint32_t  changed_addr;
-    uint8_t   addr;
-    uint32_t  dat0;
-    uint32_t  dat1;
-    uint32_t  dat2;
-    uint32_t  dat;
+    int            x;
+    uint32_t      *p;
+    const uint8_t *src;
+    uint32_t       changed_addr;
+    uint8_t        addr;
+    uint32_t       dat0;
+    uint32_t       dat1;
+    uint32_t       dat2;
+    uint32_t       dat;
 
     if ((svga->displine + svga->y_add) < 0)
         return;
@@ -2008,7 +2065,11 @@ svga_render_24bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            if (!svga->remap_required) {
+            x = ((svga->hdisp + svga->scrollcache) & ~3) + 4;
+            if (!svga->remap_required && !svga->lut_map && (src = svga_render_linear_src(svga, x * 3))) {
+                svga_render_line_24to32(p, src, x);
+                svga->memaddr += x * 3;
+            } else if (!svga->remap_required) {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
                     dat0 = *(uint32_t *) (&svga->vram[svga->memaddr & svga->vram_display_mask]);
                     dat1 = *(uint32_t *) (&svga->vram[(svga->memaddr + 4) & svga->vram_display_mask]);
@@ -2102,11 +2163,12 @@ svga_render_32bpp_lowres(svga_t *svga)
 void
 svga_render_32bpp_highres(svga_t *svga)
 {
-    int       x;
-    uint32_t *p;
-    uint32_t  dat;
-    uint32_t  changed_addr;
-    uint32_t  addr;
+    int            x;
+    uint32_t      *p;
+    const uint8_t *src;
+    uint32_t       dat;
+    uint32_t       changed_addr;
+    uint32_t       addr;
 
     if ((svga->displine + svga->y_add) < 0)
         return;
@@ -2136,7 +2198,11 @@ svga_render_32bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            if (!svga->remap_required) {
+            x = svga->hdisp + svga->scrollcache + 1;
+            if (!svga->remap_required && !svga->lut_map && (src = svga_render_linear_src(svga, x << 2))) {
+                svga_render_line_32to32(p, src, x);
+                svga->memaddr += (x * 4);
+            } else if (!svga->remap_required) {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x++) {
                     dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 2)) & svga->vram_display_mask]);
                     *p++ = lookup_lut(dat & 0xffffff);
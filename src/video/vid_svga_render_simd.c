@@ -0,0 +1,467 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Vectorized scanline conversions for the SVGA renderers.
+ *
+ *          The high and true color renderers spend most of their time
+ *          converting runs of contiguous VRAM into 32-bit pixels. The
+ *          kernels in here do that on several pixels at a time, using
+ *          SSE2 or AVX2 (selected at run time) on x86 and NEON on ARM64,
+ *          with a plain C fallback. Their output is identical to that of
+ *          the scalar renderers; the 5 and 6-bit channel expansions use
+ *          multiply constants that reproduce calc_15to32() and
+ *          calc_16to32() exactly for every input.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/timer.h>
+#include <86box/video.h>
+#include <86box/vid_svga.h>
+#include <86box/vid_svga_render.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__)) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    define USE_SSE2
+#    include <emmintrin.h>
+#    if defined(__GNUC__) || defined(__clang__)
+#        define USE_AVX2
+#        define TARGET_AVX2 __attribute__((target("avx2")))
+#        include <immintrin.h>
+#    elif defined(_MSC_VER)
+#        define USE_AVX2
+#        define TARGET_AVX2
+#        include <immintrin.h>
+#        include <intrin.h>
+#    endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define USE_NEON
+#    include <arm_neon.h>
+#endif
+
+/* floor(v * 255 / 31) for 5-bit v is mulhi(v << 4, 33693), and
+   floor(v * 255 / 63) for 6-bit v is mulhi(v << 3, 33159). */
+#define MUL_5TO8 33693
+#define MUL_6TO8 33159
+
+static void (*line_15to32)(uint32_t *p, const uint8_t *src, int count);
+static void (*line_16to32)(uint32_t *p, const uint8_t *src, int count);
+static void (*line_24to32)(uint32_t *p, const uint8_t *src, int count);
+static void (*line_32to32)(uint32_t *p, const uint8_t *src, int count);
+static void (*line_8to32)(uint32_t *p, const uint8_t *src, const uint32_t *pal, uint8_t mask, int count);
+
+/* Plain C versions, also used for the tails of the vector loops. */
+static void
+line_15to32_c(uint32_t *p, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        p[x] = video_15to32[src[x << 1] | (src[(x << 1) + 1] << 8)];
+}
+
+static void
+line_16to32_c(uint32_t *p, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        p[x] = video_16to32[src[x << 1] | (src[(x << 1) + 1] << 8)];
+}
+
+static void
+line_24to32_c(uint32_t *p, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        p[x] = src[x * 3] | (src[(x * 3) + 1] << 8) | (src[(x * 3) + 2] << 16);
+}
+
+static void
+line_32to32_c(uint32_t *p, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        p[x] = src[x << 2] | (src[(x << 2) + 1] << 8) | (src[(x << 2) + 2] << 16);
+}
+
+static void
+line_8to32_c(uint32_t *p, const uint8_t *src, const uint32_t *pal, uint8_t mask, int count)
+{
+    for (int x = 0; x < count; x++)
+        p[x] = pal[src[x] & mask];
+}
+
+#ifdef USE_SSE2
+/* Takes 8 16-bit pixels, returns the blue | green << 8 and red | 0xff00
+   halves of the 32-bit pixels. */
+static __inline void
+sse2_expand_16(__m128i dat, int bpp, __m128i *bg, __m128i *ra)
+{
+    const __m128i mask = _mm_set1_epi16(0x1f0);
+    __m128i       b;
+    __m128i       g;
+    __m128i       r;
+
+    b = _mm_mulhi_epu16(_mm_and_si128(_mm_slli_epi16(dat, 4), mask), _mm_set1_epi16((short) MUL_5TO8));
+    if (bpp == 15) {
+        g = _mm_mulhi_epu16(_mm_and_si128(_mm_srli_epi16(dat, 1), mask), _mm_set1_epi16((short) MUL_5TO8));
+        r = _mm_mulhi_epu16(_mm_and_si128(_mm_srli_epi16(dat, 6), mask), _mm_set1_epi16((short) MUL_5TO8));
+    } else {
+        g = _mm_mulhi_epu16(_mm_and_si128(_mm_srli_epi16(dat, 2), _mm_set1_epi16(0x1f8)), _mm_set1_epi16((short) MUL_6TO8));
+        r = _mm_mulhi_epu16(_mm_srli_epi16(_mm_and_si128(dat, _mm_set1_epi16((short) 0xf800)), 7), _mm_set1_epi16((short) MUL_5TO8));
+    }
+
+    *bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+    *ra = _mm_or_si128(r, _mm_set1_epi16((short) 0xff00));
+}
+
+static void
+line_15to32_sse2(uint32_t *p, const uint8_t *src, int count)
+{
+    __m128i bg;
+    __m128i ra;
+    int     x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        sse2_expand_16(_mm_loadu_si128((const __m128i *) &src[x << 1]), 15, &bg, &ra);
+        _mm_storeu_si128((__m128i *) &p[x], _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128((__m128i *) &p[x + 4], _mm_unpackhi_epi16(bg, ra));
+    }
+
+    line_15to32_c(&p[x], &src[x << 1], count - x);
+}
+
+static void
+line_16to32_sse2(uint32_t *p, const uint8_t *src, int count)
+{
+    __m128i bg;
+    __m128i ra;
+    int     x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        sse2_expand_16(_mm_loadu_si128((const __m128i *) &src[x << 1]), 16, &bg, &ra);
+        _mm_storeu_si128((__m128i *) &p[x], _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128((__m128i *) &p[x + 4], _mm_unpackhi_epi16(bg, ra));
+    }
+
+    line_16to32_c(&p[x], &src[x << 1], count - x);
+}
+
+static void
+line_32to32_sse2(uint32_t *p, const uint8_t *src, int count)
+{
+    const __m128i mask = _mm_set1_epi32(0x00ffffff);
+    int           x;
+
+    for (x = 0; x <= (count - 4); x += 4)
+        _mm_storeu_si128((__m128i *) &p[x], _mm_and_si128(_mm_loadu_si128((const __m128i *) &src[x << 2]), mask));
+
+    line_32to32_c(&p[x], &src[x << 2], count - x);
+}
+#endif
+
+#ifdef USE_AVX2
+static __inline TARGET_AVX2 void
+avx2_expand_16(__m256i dat, int bpp, __m256i *lo, __m256i *hi)
+{
+    const __m256i mask = _mm256_set1_epi16(0x1f0);
+    __m256i       b;
+    __m256i       g;
+    __m256i       r;
+    __m256i       bg;
+    __m256i       ra;
+    __m256i       t0;
+    __m256i       t1;
+
+    b = _mm256_mulhi_epu16(_mm256_and_si256(_mm256_slli_epi16(dat, 4), mask), _mm256_set1_epi16((short) MUL_5TO8));
+    if (bpp == 15) {
+        g = _mm256_mulhi_epu16(_mm256_and_si256(_mm256_srli_epi16(dat, 1), mask), _mm256_set1_epi16((short) MUL_5TO8));
+        r = _mm256_mulhi_epu16(_mm256_and_si256(_mm256_srli_epi16(dat, 6), mask), _mm256_set1_epi16((short) MUL_5TO8));
+    } else {
+        g = _mm256_mulhi_epu16(_mm256_and_si256(_mm256_srli_epi16(dat, 2), _mm256_set1_epi16(0x1f8)), _mm256_set1_epi16((short) MUL_6TO8));
+        r = _mm256_mulhi_epu16(_mm256_srli_epi16(_mm256_and_si256(dat, _mm256_set1_epi16((short) 0xf800)), 7), _mm256_set1_epi16((short) MUL_5TO8));
+    }
+
+    bg = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+    ra = _mm256_or_si256(r, _mm256_set1_epi16((short) 0xff00));
+
+    /* The unpacks work within 128-bit lanes, put the pixels back in order. */
+    t0  = _mm256_unpacklo_epi16(bg, ra);
+    t1  = _mm256_unpackhi_epi16(bg, ra);
+    *lo = _mm256_permute2x128_si256(t0, t1, 0x20);
+    *hi = _mm256_permute2x128_si256(t0, t1, 0x31);
+}
+
+static TARGET_AVX2 void
+line_15to32_avx2(uint32_t *p, const uint8_t *src, int count)
+{
+    __m256i lo;
+    __m256i hi;
+    int     x;
+
+    for (x = 0; x <= (count - 16); x += 16) {
+        avx2_expand_16(_mm256_loadu_si256((const __m256i *) &src[x << 1]), 15, &lo, &hi);
+        _mm256_storeu_si256((__m256i *) &p[x], lo);
+        _mm256_storeu_si256((__m256i *) &p[x + 8], hi);
+    }
+
+    line_15to32_c(&p[x], &src[x << 1], count - x);
+}
+
+static TARGET_AVX2 void
+line_16to32_avx2(uint32_t *p, const uint8_t *src, int count)
+{
+    __m256i lo;
+    __m256i hi;
+    int     x;
+
+    for (x = 0; x <= (count - 16); x += 16) {
+        avx2_expand_16(_mm256_loadu_si256((const __m256i *) &src[x << 1]), 16, &lo, &hi);
+        _mm256_storeu_si256((__m256i *) &p[x], lo);
+        _mm256_storeu_si256((__m256i *) &p[x + 8], hi);
+    }
+
+    line_16to32_c(&p[x], &src[x << 1], count - x);
+}
+
+static TARGET_AVX2 void
+line_24to32_avx2(uint32_t *p, const uint8_t *src, int count)
+{
+    /* Each 128-bit lane gets 4 pixels, loaded from 12 bytes apart. */
+    const __m256i shuf = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                          0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m256i       dat;
+    int           x;
+
+    /* Stop early enough for the 16-byte loads not to read past the run. */
+    for (x = 0; x <= (count - 10); x += 8) {
+        dat = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) &src[x * 3])),
+                                      _mm_loadu_si128((const __m128i *) &src[(x * 3) + 12]), 1);
+        _mm256_storeu_si256((__m256i *) &p[x], _mm256_shuffle_epi8(dat, shuf));
+    }
+
+    line_24to32_c(&p[x], &src[x * 3], count - x);
+}
+
+static TARGET_AVX2 void
+line_32to32_avx2(uint32_t *p, const uint8_t *src, int count)
+{
+    const __m256i mask = _mm256_set1_epi32(0x00ffffff);
+    int           x;
+
+    for (x = 0; x <= (count - 8); x += 8)
+        _mm256_storeu_si256((__m256i *) &p[x], _mm256_and_si256(_mm256_loadu_si256((const __m256i *) &src[x << 2]), mask));
+
+    line_32to32_c(&p[x], &src[x << 2], count - x);
+}
+
+static TARGET_AVX2 void
+line_8to32_avx2(uint32_t *p, const uint8_t *src, const uint32_t *pal, uint8_t mask, int count)
+{
+    const __m256i vmask = _mm256_set1_epi32(mask);
+    __m256i       idx;
+    int           x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        idx = _mm256_and_si256(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) &src[x])), vmask);
+        _mm256_storeu_si256((__m256i *) &p[x], _mm256_i32gather_epi32((const int *) pal, idx, 4));
+    }
+
+    line_8to32_c(&p[x], &src[x], pal, mask, count - x);
+}
+
+static int
+cpu_has_avx2(void)
+{
+#    ifdef _MSC_VER
+    int regs[4];
+
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+        return 0;
+
+    /* The OS has to save the YMM registers as well. */
+    __cpuid(regs, 1);
+    if (!(regs[2] & (1 << 27)) || ((_xgetbv(0) & 6) != 6))
+        return 0;
+
+    __cpuidex(regs, 7, 0);
+    return !!(regs[1] & (1 << 5));
+#    else
+    __builtin_cpu_init();
+    return !!__builtin_cpu_supports("avx2");
+#    endif
+}
+#endif
+
+#ifdef USE_NEON
+static __inline uint16x8_t
+neon_mulhi_u16(uint16x8_t a, uint16_t b)
+{
+    uint32x4_t lo = vmull_n_u16(vget_low_u16(a), b);
+    uint32x4_t hi = vmull_n_u16(vget_high_u16(a), b);
+
+    return vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+}
+
+static __inline void
+neon_expand_16(uint32_t *p, uint16x8_t dat, int bpp)
+{
+    const uint16x8_t mask = vdupq_n_u16(0x1f0);
+    uint16x8_t       b;
+    uint16x8_t       g;
+    uint16x8_t       r;
+    uint16x8x2_t     out;
+
+    b = neon_mulhi_u16(vandq_u16(vshlq_n_u16(dat, 4), mask), MUL_5TO8);
+    if (bpp == 15) {
+        g = neon_mulhi_u16(vandq_u16(vshrq_n_u16(dat, 1), mask), MUL_5TO8);
+        r = neon_mulhi_u16(vandq_u16(vshrq_n_u16(dat, 6), mask), MUL_5TO8);
+    } else {
+        g = neon_mulhi_u16(vandq_u16(vshrq_n_u16(dat, 2), vdupq_n_u16(0x1f8)), MUL_6TO8);
+        r = neon_mulhi_u16(vshrq_n_u16(vandq_u16(dat, vdupq_n_u16(0xf800)), 7), MUL_5TO8);
+    }
+
+    out = vzipq_u16(vorrq_u16(b, vshlq_n_u16(g, 8)), vorrq_u16(r, vdupq_n_u16(0xff00)));
+    vst1q_u32(p, vreinterpretq_u32_u16(out.val[0]));
+    vst1q_u32(p + 4, vreinterpretq_u32_u16(out.val[1]));
+}
+
+static void
+line_15to32_neon(uint32_t *p, const uint8_t *src, int count)
+{
+    int x;
+
+    for (x = 0; x <= (count - 8); x += 8)
+        neon_expand_16(&p[x], vld1q_u16((const uint16_t *) &src[x << 1]), 15);
+
+    line_15to32_c(&p[x], &src[x << 1], count - x);
+}
+
+static void
+line_16to32_neon(uint32_t *p, const uint8_t *src, int count)
+{
+    int x;
+
+    for (x = 0; x <= (count - 8); x += 8)
+        neon_expand_16(&p[x], vld1q_u16((const uint16_t *) &src[x << 1]), 16);
+
+    line_16to32_c(&p[x], &src[x << 1], count - x);
+}
+
+static void
+line_24to32_neon(uint32_t *p, const uint8_t *src, int count)
+{
+    uint8x16x3_t dat;
+    uint8x16x4_t out;
+    int          x;
+
+    out.val[3] = vdupq_n_u8(0);
+    for (x = 0; x <= (count - 16); x += 16) {
+        dat        = vld3q_u8(&src[x * 3]);
+        out.val[0] = dat.val[0];
+        out.val[1] = dat.val[1];
+        out.val[2] = dat.val[2];
+        vst4q_u8((uint8_t *) &p[x], out);
+    }
+
+    line_24to32_c(&p[x], &src[x * 3], count - x);
+}
+
+static void
+line_32to32_neon(uint32_t *p, const uint8_t *src, int count)
+{
+    const uint32x4_t mask = vdupq_n_u32(0x00ffffff);
+    int              x;
+
+    for (x = 0; x <= (count - 4); x += 4)
+        vst1q_u32(&p[x], vandq_u32(vld1q_u32((const uint32_t *) &src[x << 2]), mask));
+
+    line_32to32_c(&p[x], &src[x << 2], count - x);
+}
+#endif
+
+void
+svga_render_simd_init(void)
+{
+    if (line_15to32)
+        return;
+
+    line_15to32 = line_15to32_c;
+    line_16to32 = line_16to32_c;
+    line_24to32 = line_24to32_c;
+    line_32to32 = line_32to32_c;
+    line_8to32  = line_8to32_c;
+
+#ifdef USE_SSE2
+    line_15to32 = line_15to32_sse2;
+    line_16to32 = line_16to32_sse2;
+    line_32to32 = line_32to32_sse2;
+#endif
+#ifdef USE_AVX2
+    if (cpu_has_avx2()) {
+        line_15to32 = line_15to32_avx2;
+        line_16to32 = line_16to32_avx2;
+        line_24to32 = line_24to32_avx2;
+        line_32to32 = line_32to32_avx2;
+        line_8to32  = line_8to32_avx2;
+    }
+#endif
+#ifdef USE_NEON
+    line_15to32 = line_15to32_neon;
+    line_16to32 = line_16to32_neon;
+    line_24to32 = line_24to32_neon;
+    line_32to32 = line_32to32_neon;
+#endif
+}
+
+/* Return the VRAM for the next bytes of the scanline if they can be read in
+   one go, or NULL if the display address wraps around within them. */
+const uint8_t *
+svga_render_linear_src(svga_t *svga, uint32_t bytes)
+{
+    uint32_t addr = svga->memaddr & svga->vram_display_mask;
+
+    if ((svga->vram_display_mask & (svga->vram_display_mask + 1)) || ((addr + bytes) > (svga->vram_display_mask + 1)))
+        return NULL;
+
+    return &svga->vram[addr];
+}
+
+void
+svga_render_line_15to32(uint32_t *p, const uint8_t *src, int count)
+{
+    line_15to32(p, src, count);
+}
+
+void
+svga_render_line_16to32(uint32_t *p, const uint8_t *src, int count)
+{
+    line_16to32(p, src, count);
+}
+
+void
+svga_render_line_24to32(uint32_t *p, const uint8_t *src, int count)
+{
+    line_24to32(p, src, count);
+}
+
+void
+svga_render_line_32to32(uint32_t *p, const uint8_t *src, int count)
+{
+    line_32to32(p, src, count);
+}
+
+void
+svga_render_line_8to32(uint32_t *p, const uint8_t *src, const uint32_t *pal, uint8_t mask, int count)
+{
+    line_8to32(p, src, pal, mask, count);
+}
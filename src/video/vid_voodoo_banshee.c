@@ -3809,10 +3809,31 @@ static const device_config_t voodoo_sgram_config[] = {
         .file_filter    = NULL,
         .spinner        = { 0 },
         .selection      = {
-            { .description = "1", .value = 1 },
-            { .description = "2", .value = 2 },
-            { .description = "4", .value = 4 },
-            { .description = ""              }
+            { .description = "1",  .value =  1 },
+            { .description = "2",  .value =  2 },
+            { .description = "4",  .value =  4 },
+            { .description = "6",  .value =  6 },
+            { .description = "8",  .value =  8 },
+            { .description = "12", .value = 12 },
+            { .description = "16", .value = 16 },
+            { .description = ""                }
+        },
+        .bios           = { { 0 } }
+    },
+    {
+        .name           = "texture_cache_size",
+        .description    = "Texture cache size",
+        .type           = CONFIG_SELECTION,
+        .default_string = NULL,
+        .default_int    = 64,
+        .file_filter    = NULL,
+        .spinner        = { 0 },
+        .selection      = {
+            { .description = "64 textures",   .value =  64 },
+            { .description = "128 textures",  .value = 128 },
+            { .description = "256 textures",  .value = 256 },
+            { .description = "512 textures",  .value = 512 },
+            { .description = ""                              }
         },
         .bios           = { { 0 } }
     },
@@ -3828,6 +3849,24 @@ static const device_config_t voodoo_sgram_config[] = {
         .selection      = { { 0 } },
         .bios           = { { 0 } }
     },
+    {
+        .name           = "jit_cache_size",
+        .description    = "Recompiler cache size",
+        .type           = CONFIG_SELECTION,
+        .default_string = NULL,
+        .default_int    = 256,
+        .file_filter    = NULL,
+        .spinner        = { 0 },
+        .selection      = {
+            { .description = "64 pipelines",   .value =   64 },
+            { .description = "128 pipelines",  .value =  128 },
+            { .description = "256 pipelines",  .value =  256 },
+            { .description = "512 pipelines",  .value =  512 },
+            { .description = "1024 pipelines", .value = 1024 },
+            { .description = ""                                }
+        },
+        .bios           = { { 0 } }
+    },
 #endif
     { .name = "", .description = "", .type = CONFIG_END }
 };
@@ -3943,10 +3982,31 @@ static const device_config_t voodoo_banshee_pci_config[] = {
         .file_filter    = NULL,
         .spinner        = { 0 },
         .selection      = {
-            { .description = "1", .value = 1 },
-            { .description = "2", .value = 2 },
-            { .description = "4", .value = 4 },
-            { .description = ""              }
+            { .description = "1",  .value =  1 },
+            { .description = "2",  .value =  2 },
+            { .description = "4",  .value =  4 },
+            { .description = "6",  .value =  6 },
+            { .description = "8",  .value =  8 },
+            { .description = "12", .value = 12 },
+            { .description = "16", .value = 16 },
+            { .description = ""                }
+        },
+        .bios           = { { 0 } }
+    },
+    {
+        .name           = "texture_cache_size",
+        .description    = "Texture cache size",
+        .type           = CONFIG_SELECTION,
+        .default_string = NULL,
+        .default_int    = 64,
+        .file_filter    = NULL,
+        .spinner        = { 0 },
+        .selection      = {
+            { .description = "64 textures",   .value =  64 },
+            { .description = "128 textures",  .value = 128 },
+            { .description = "256 textures",  .value = 256 },
+            { .description = "512 textures",  .value = 512 },
+            { .description = ""                              }
         },
         .bios           = { { 0 } }
     },
@@ -3962,6 +4022,24 @@ static const device_config_t voodoo_banshee_pci_config[] = {
         .selection      = { { 0 } },
         .bios           = { { 0 } }
     },
+    {
+        .name           = "jit_cache_size",
+        .description    = "Recompiler cache size",
+        .type           = CONFIG_SELECTION,
+        .default_string = NULL,
+        .default_int    = 256,
+        .file_filter    = NULL,
+        .spinner        = { 0 },
+        .selection      = {
+            { .description = "64 pipelines",   .value =   64 },
+            { .description = "128 pipelines",  .value =  128 },
+            { .description = "256 pipelines",  .value =  256 },
+            { .description = "512 pipelines",  .value =  512 },
+            { .description = "1024 pipelines", .value = 1024 },
+            { .description = ""                                }
+        },
+        .bios           = { { 0 } }
+    },
 #endif
     { .name = "", .description = "", .type = CONFIG_END }
 };
@@ -4020,10 +4098,31 @@ static const device_config_t voodoo_nomem_config[] = {
         .file_filter    = NULL,
         .spinner        = { 0 },
         .selection      = {
-            { .description = "1", .value = 1 },
-            { .description = "2", .value = 2 },
-            { .description = "4", .value = 4 },
-            { .description = ""              }
+            { .description = "1",  .value =  1 },
+            { .description = "2",  .value =  2 },
+            { .description = "4",  .value =  4 },
+            { .description = "6",  .value =  6 },
+            { .description = "8",  .value =  8 },
+            { .description = "12", .value = 12 },
+            { .description = "16", .value = 16 },
+            { .description = ""                }
+        },
+        .bios           = { { 0 } }
+    },
+    {
+        .name           = "texture_cache_size",
+        .description    = "Texture cache size",
+        .type           = CONFIG_SELECTION,
+        .default_string = NULL,
+        .default_int    = 64,
+        .file_filter    = NULL,
+        .spinner        = { 0 },
+        .selection      = {
+            { .description = "64 textures",   .value =  64 },
+            { .description = "128 textures",  .value = 128 },
+            { .description = "256 textures",  .value = 256 },
+            { .description = "512 textures",  .value = 512 },
+            { .description = ""                              }
         },
         .bios           = { { 0 } }
     },
@@ -4039,6 +4138,24 @@ static const device_config_t voodoo_nomem_config[] = {
         .selection      = { { 0 } },
         .bios           = { { 0 } }
     },
+    {
+        .name           = "jit_cache_size",
+        .description    = "Recompiler cache size",
+        .type           = CONFIG_SELECTION,
+        .default_string = NULL,
+        .default_int    = 256,
+        .file_filter    = NULL,
+        .spinner        = { 0 },
+        .selection      = {
+            { .description = "64 pipelines",   .value =   64 },
+            { .description = "128 pipelines",  .value =  128 },
+            { .description = "256 pipelines",  .value =  256 },
+            { .description = "512 pipelines",  .value =  512 },
+            { .description = "1024 pipelines", .value = 1024 },
+            { .description = ""                                }
+        },
+        .bios           = { { 0 } }
+    },
 #endif
     { .name = "", .description = "", .type = CONFIG_END }
 };
@@ -4159,10 +4276,31 @@ static const device_config_t voodoo_3_3500_agp_config[] = {
         .file_filter    = NULL,
         .spinner        = { 0 },
         .selection      = {
-            { .description = "1", .value = 1 },
-            { .description = "2", .value = 2 },
-            { .description = "4", .value = 4 },
-            { .description = ""              }
+            { .description = "1",  .value =  1 },
+            { .description = "2",  .value =  2 },
+            { .description = "4",  .value =  4 },
+            { .description = "6",  .value =  6 },
+            { .description = "8",  .value =  8 },
+            { .description = "12", .value = 12 },
+            { .description = "16", .value = 16 },
+            { .description = ""                }
+        },
+        .bios           = { { 0 } }
+    },
+    {
+        .name           = "texture_cache_size",
+        .description    = "Texture cache size",
+        .type           = CONFIG_SELECTION,
+        .default_string = NULL,
+        .default_int    = 64,
+        .file_filter    = NULL,
+        .spinner        = { 0 },
+        .selection      = {
+            { .description = "64 textures",   .value =  64 },
+            { .description = "128 textures",  .value = 128 },
+            { .description = "256 textures",  .value = 256 },
+            { .description = "512 textures",  .value = 512 },
+            { .description = ""                              }
         },
         .bios           = { { 0 } }
     },
@@ -4178,6 +4316,24 @@ static const device_config_t voodoo_3_3500_agp_config[] = {
         .selection      = { { 0 } },
         .bios           = { { 0 } }
     },
+    {
+        .name           = "jit_cache_size",
+        .description    = "Recompiler cache size",
+        .type           = CONFIG_SELECTION,
+        .default_string = NULL,
+        .default_int    = 256,
+        .file_filter    = NULL,
+        .spinner        = { 0 },
+        .selection      = {
+            { .description = "64 pipelines",   .value =   64 },
+            { .description = "128 pipelines",  .value =  128 },
+            { .description = "256 pipelines",  .value =  256 },
+            { .description = "512 pipelines",  .value =  512 },
+            { .description = "1024 pipelines", .value = 1024 },
+            { .description = ""                                }
+        },
+        .bios           = { { 0 } }
+    },
 #endif
     { .name = "", .description = "", .type = CONFIG_END }
 };
@@ -0,0 +1,304 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Voodoo compiled pipeline cache.
+ *
+ *          The codegen backends compile one pixel pipeline per distinct
+ *          combination of rendering state. The compiled blocks are kept
+ *          in a hash table keyed on the full state, shared by all render
+ *          threads of a card, and recycled in least recently used order.
+ *          The backends only provide the code memory and the compiler.
+ *
+ * Authors: agent, <agent@local>
+ *
+ *          Copyright 2026 agent.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/timer.h>
+#include <86box/thread.h>
+#include <86box/video.h>
+#include <86box/vid_svga.h>
+#include <86box/vid_voodoo_common.h>
+#include <86box/vid_voodoo_regs.h>
+#include <86box/vid_voodoo_jit.h>
+
+#ifdef ENABLE_VOODOO_JIT_LOG
+int voodoo_jit_do_log = ENABLE_VOODOO_JIT_LOG;
+
+static void
+voodoo_jit_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (voodoo_jit_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define voodoo_jit_log(fmt, ...)
+#endif
+
+static voodoo_jit_cache_t *voodoo_jit_caches;
+
+static uint32_t
+voodoo_jit_hash(const voodoo_jit_key_t *key)
+{
+    const uint32_t *p    = (const uint32_t *) key;
+    uint32_t        hash = 0x811c9dc5;
+
+    for (size_t c = 0; c < (sizeof(voodoo_jit_key_t) / sizeof(uint32_t)); c++) {
+        hash ^= p[c];
+        hash *= 0x01000193;
+        hash ^= hash >> 15;
+    }
+
+    return hash;
+}
+
+static void
+voodoo_jit_lru_unlink(voodoo_jit_cache_t *cache, voodoo_jit_block_t *block)
+{
+    if (block->lru_prev)
+        block->lru_prev->lru_next = block->lru_next;
+    else
+        cache->lru_head = block->lru_next;
+
+    if (block->lru_next)
+        block->lru_next->lru_prev = block->lru_prev;
+    else
+        cache->lru_tail = block->lru_prev;
+}
+
+static void
+voodoo_jit_lru_push(voodoo_jit_cache_t *cache, voodoo_jit_block_t *block)
+{
+    block->lru_prev = NULL;
+    block->lru_next = cache->lru_head;
+    if (cache->lru_head)
+        cache->lru_head->lru_prev = block;
+    else
+        cache->lru_tail = block;
+    cache->lru_head = block;
+}
+
+static void
+voodoo_jit_hash_unlink(voodoo_jit_cache_t *cache, voodoo_jit_block_t *block)
+{
+    voodoo_jit_block_t **p = &cache->hash[block->hash & cache->hash_mask];
+
+    while (*p) {
+        if (*p == block) {
+            *p = block->hash_next;
+            break;
+        }
+        p = &(*p)->hash_next;
+    }
+    block->hash_next = NULL;
+}
+
+voodoo_jit_cache_t *
+voodoo_jit_init(int nr_blocks)
+{
+    voodoo_jit_cache_t *cache;
+    uint32_t            hash_size = 1;
+
+    /* Every render thread can pin one block, make sure there is always
+       one more to compile into. */
+    if (nr_blocks <= VOODOO_MAX_RENDER_THREADS) {
+        pclog("Voodoo JIT: cache size of %i blocks is too small, using %i\n",
+              nr_blocks, VOODOO_MAX_RENDER_THREADS + 1);
+        nr_blocks = VOODOO_MAX_RENDER_THREADS + 1;
+    }
+
+    while (hash_size < (uint32_t) (nr_blocks * 2))
+        hash_size <<= 1;
+
+    cache            = calloc(1, sizeof(voodoo_jit_cache_t));
+    cache->blocks    = calloc(nr_blocks, sizeof(voodoo_jit_block_t));
+    cache->hash      = calloc(hash_size, sizeof(voodoo_jit_block_t *));
+    cache->nr_blocks = nr_blocks;
+    cache->hash_mask = hash_size - 1;
+    cache->lock      = thread_create_mutex();
+
+    for (int c = 0; c < nr_blocks; c++)
+        voodoo_jit_lru_push(cache, &cache->blocks[c]);
+
+    cache->next       = voodoo_jit_caches;
+    voodoo_jit_caches = cache;
+
+    return cache;
+}
+
+void
+voodoo_jit_close(voodoo_jit_cache_t *cache)
+{
+    voodoo_jit_stats_t stats;
+
+    if (!cache)
+        return;
+
+    voodoo_jit_get_stats(cache, &stats);
+    voodoo_jit_log("Voodoo JIT: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " recompiles, "
+                   "%" PRIu64 " evictions, %" PRIu64 " rejects, %i/%i blocks used\n",
+                   stats.hits, stats.misses, stats.recompiles, stats.evictions, stats.rejects,
+                   stats.used, stats.blocks);
+
+    for (voodoo_jit_cache_t **p = &voodoo_jit_caches; *p; p = &(*p)->next) {
+        if (*p == cache) {
+            *p = cache->next;
+            break;
+        }
+    }
+
+    thread_close_mutex(cache->lock);
+    free(cache->hash);
+    free(cache->blocks);
+    free(cache);
+}
+
+/* Find the block for the given state and make it the thread's current one.
+   If the state has not been seen yet, a block is reserved for it and
+   *compile is set; the caller must then generate the code, without the lock
+   held, and call voodoo_jit_compiled(). Other threads find the reserved
+   block meanwhile and use the interpreter until it is published. The
+   backends' emitters keep all their state local to the block or thread, so
+   several blocks can be compiled at once. Returns NULL if no block could be
+   allocated. */
+voodoo_jit_block_t *
+voodoo_jit_lookup(voodoo_jit_cache_t *cache, int thread, const voodoo_jit_key_t *key, int *compile)
+{
+    voodoo_jit_block_t *block;
+    uint32_t            hash = voodoo_jit_hash(key);
+
+    *compile = 0;
+
+    thread_wait_mutex(cache->lock);
+
+    cache->hits += ATOMIC_LOAD(cache->current_hits[thread]);
+    ATOMIC_STORE(cache->current_hits[thread], 0);
+
+    if (cache->current[thread]) {
+        cache->current[thread]->refcount--;
+        cache->current[thread] = NULL;
+    }
+
+    for (block = cache->hash[hash & cache->hash_mask]; block; block = block->hash_next) {
+        if ((block->hash == hash) && !memcmp(&block->key, key, sizeof(voodoo_jit_key_t)))
+            break;
+    }
+
+    if (block) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+
+        /* Recycle the least recently used block nobody is drawing with. */
+        for (block = cache->lru_tail; block; block = block->lru_prev) {
+            if (!block->refcount)
+                break;
+        }
+        if (!block) {
+            thread_release_mutex(cache->lock);
+            return NULL;
+        }
+
+        if (ATOMIC_LOAD(block->state) != VOODOO_JIT_EMPTY) {
+            voodoo_jit_hash_unlink(cache, block);
+            cache->evictions++;
+        } else
+            cache->used++;
+
+        block->key       = *key;
+        block->hash      = hash;
+        block->hash_next = cache->hash[hash & cache->hash_mask];
+        ATOMIC_STORE(block->state, VOODOO_JIT_COMPILING);
+        cache->hash[hash & cache->hash_mask] = block;
+
+        *compile = 1;
+    }
+
+    voodoo_jit_lru_unlink(cache, block);
+    voodoo_jit_lru_push(cache, block);
+
+    block->refcount++;
+    cache->current[thread] = block;
+
+    thread_release_mutex(cache->lock);
+
+    return block;
+}
+
+/* Publish the code generated for a block reserved by voodoo_jit_lookup(). */
+void
+voodoo_jit_compiled(voodoo_jit_cache_t *cache, voodoo_jit_block_t *block, int ok)
+{
+    thread_wait_mutex(cache->lock);
+
+    if (ok) {
+        ATOMIC_STORE(block->state, VOODOO_JIT_VALID);
+        cache->recompiles++;
+    } else {
+        ATOMIC_STORE(block->state, VOODOO_JIT_REJECTED);
+        cache->rejects++;
+    }
+
+    thread_release_mutex(cache->lock);
+}
+
+void
+voodoo_jit_get_stats(voodoo_jit_cache_t *cache, voodoo_jit_stats_t *stats)
+{
+    memset(stats, 0, sizeof(voodoo_jit_stats_t));
+
+    if (!cache)
+        return;
+
+    thread_wait_mutex(cache->lock);
+    stats->hits       = cache->hits;
+    stats->misses     = cache->misses;
+    stats->recompiles = cache->recompiles;
+    stats->evictions  = cache->evictions;
+    stats->rejects    = cache->rejects;
+    stats->blocks     = cache->nr_blocks;
+    stats->used       = cache->used;
+    for (int c = 0; c < VOODOO_MAX_RENDER_THREADS; c++)
+        stats->hits += ATOMIC_LOAD(cache->current_hits[c]);
+    thread_release_mutex(cache->lock);
+}
+
+/* Sum up the statistics of the caches of all cards. */
+void
+voodoo_jit_get_total_stats(voodoo_jit_stats_t *stats)
+{
+    voodoo_jit_stats_t cache_stats;
+
+    memset(stats, 0, sizeof(voodoo_jit_stats_t));
+
+    for (voodoo_jit_cache_t *cache = voodoo_jit_caches; cache; cache = cache->next) {
+        voodoo_jit_get_stats(cache, &cache_stats);
+        stats->hits += cache_stats.hits;
+        stats->misses += cache_stats.misses;
+        stats->recompiles += cache_stats.recompiles;
+        stats->evictions += cache_stats.evictions;
+        stats->rejects += cache_stats.rejects;
+        stats->blocks += cache_stats.blocks;
+        stats->used += cache_stats.used;
+    }
+}
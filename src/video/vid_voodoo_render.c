@@ -20,6 +20,7 @@
 #include <stddef.h>
 #include <wchar.h>
 #include <math.h>
+#include <stdatomic.h>
 #if defined(_M_ARM64) && defined(_MSC_VER)
 #    include <intrin.h>
 #endif
@@ -38,6 +39,7 @@
 #include <86box/vid_voodoo_common.h>
 #include <86box/vid_voodoo_dither.h>
 #include <86box/vid_voodoo_regs.h>
+#include <86box/vid_voodoo_jit.h>
 #include <86box/vid_voodoo_render.h>
 #include <86box/vid_voodoo_texture.h>
 
@@ -667,6 +669,17 @@ voodoo_tmu_fetch_and_blend(voodoo_t *voodoo, voodoo_params_t *params, voodoo_sta
 int voodoo_recomp = 0;
 #endif
 
+/* Render thread that draws the given screen line. Lines are interleaved
+   between the threads; with SLI, each card only draws every other line. */
+static __inline int
+voodoo_render_thread_for_line(voodoo_t *voodoo, int real_y)
+{
+    if (SLI_ENABLED)
+        real_y >>= 1;
+
+    return (int) ((unsigned int) real_y % (unsigned int) voodoo->render_threads);
+}
+
 static void
 voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int ystart, int yend, int odd_even)
 {
@@ -833,13 +846,8 @@ voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *
         else
             real_y >>= 4;
 
-        if (SLI_ENABLED) {
-            if (((real_y >> 1) & voodoo->odd_even_mask) != odd_even)
-                goto next_line;
-        } else {
-            if ((real_y & voodoo->odd_even_mask) != odd_even)
-                goto next_line;
-        }
+        if (voodoo_render_thread_for_line(voodoo, real_y) != odd_even)
+            goto next_line;
 
         start_x = x;
 
@@ -1595,37 +1603,54 @@ voodoo_render_log("voodoo_triangle %i %i %i : vA %f, %f  vB %f, %f  vC %f, %f f
     voodoo_half_triangle(voodoo, params, &state, vertexAy_adjusted, vertexCy_adjusted, odd_even);
 }
 
+/* A triangle that has none of this thread's lines still holds a reference
+   to its textures, drop it without rendering anything. */
 static void
-render_thread(void *param, int odd_even)
+voodoo_triangle_skip(voodoo_t *voodoo, voodoo_params_t *params, int odd_even)
 {
-    voodoo_t *voodoo = (voodoo_t *) param;
+    voodoo->texture_cache[0][params->tex_entry[0]].refcount_r[odd_even]++;
+    voodoo->texture_cache[1][params->tex_entry[1]].refcount_r[odd_even]++;
+}
+
+void
+voodoo_render_thread(void *param)
+{
+    voodoo_t *voodoo   = ((voodoo_render_thread_param_t *) param)->voodoo;
+    int       odd_even = ((voodoo_render_thread_param_t *) param)->index;
 
     while (voodoo->render_thread_run[odd_even]) {
         thread_set_event(voodoo->render_not_full_event[odd_even]);
         thread_wait_event(voodoo->wake_render_thread[odd_even], -1);
         thread_reset_event(voodoo->wake_render_thread[odd_even]);
-#if (defined __aarch64__ || defined _M_ARM64)
-    process_work:
-#endif
+process_work:
         RENDER_VOODOO_BUSY(voodoo, odd_even) = 1;
 
         while (!PARAM_EMPTY(odd_even)) {
-            uint64_t         start_time = plat_timer_read();
-            uint64_t         end_time;
-            voodoo_params_t *params = &voodoo->params_buffer[PARAMS_READ_IDX(voodoo, odd_even) & PARAM_MASK];
+            int              idx    = PARAMS_READ_IDX(voodoo, odd_even) & PARAM_MASK;
+            voodoo_params_t *params = &voodoo->params_buffer[idx];
+
+            if (voodoo->params_threads[idx] & (1 << odd_even)) {
+                uint64_t start_time = plat_timer_read();
 
-            voodoo_triangle(voodoo, params, odd_even);
+                voodoo_triangle(voodoo, params, odd_even);
+
+                voodoo->render_time[odd_even] += plat_timer_read() - start_time;
+            } else
+                voodoo_triangle_skip(voodoo, params, odd_even);
 
             PARAMS_READ_IDX(voodoo, odd_even)++;
 
             if (PARAM_ENTRIES(odd_even) > (PARAM_SIZE - 10))
                 thread_set_event(voodoo->render_not_full_event[odd_even]);
-
-            end_time = plat_timer_read();
-            voodoo->render_time[odd_even] += end_time - start_time;
         }
 
         RENDER_VOODOO_BUSY(voodoo, odd_even) = 0;
+
+        /* Pairs with the fence in voodoo_queue_triangle(): either we see the
+           triangle queued meanwhile, or the queue sees us idle and wakes us. */
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!PARAM_EMPTY(odd_even))
+            goto process_work;
 #if (defined __aarch64__ || defined _M_ARM64)
         /* Spin briefly before sleeping to absorb burst triangle submissions
            from the JIT without expensive context-switch overhead. */
@@ -1643,47 +1668,99 @@ render_thread(void *param, int odd_even)
 }
 
 void
-voodoo_render_thread_1(void *param)
-{
-    render_thread(param, 0);
-}
-void
-voodoo_render_thread_2(void *param)
+voodoo_render_threads_start(voodoo_t *voodoo)
 {
-    render_thread(param, 1);
+    if (voodoo->render_threads < 1)
+        voodoo->render_threads = 1;
+    else if (voodoo->render_threads > VOODOO_MAX_RENDER_THREADS)
+        voodoo->render_threads = VOODOO_MAX_RENDER_THREADS;
+
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        voodoo->wake_render_thread[c]    = thread_create_event();
+        voodoo->render_not_full_event[c] = thread_create_event();
+    }
+
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        voodoo->render_thread_param[c].voodoo = voodoo;
+        voodoo->render_thread_param[c].index  = c;
+        voodoo->render_thread_run[c]          = 1;
+        voodoo->render_thread[c]              = thread_create(voodoo_render_thread, &voodoo->render_thread_param[c]);
+    }
 }
+
 void
-voodoo_render_thread_3(void *param)
+voodoo_render_threads_stop(voodoo_t *voodoo)
 {
-    render_thread(param, 2);
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        voodoo->render_thread_run[c] = 0;
+        thread_set_event(voodoo->wake_render_thread[c]);
+        thread_wait(voodoo->render_thread[c]);
+    }
+
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        thread_destroy_event(voodoo->wake_render_thread[c]);
+        thread_destroy_event(voodoo->render_not_full_event[c]);
+    }
 }
-void
-voodoo_render_thread_4(void *param)
+
+/* Work out which render threads own at least one scanline of a triangle.
+   This is conservative: a thread may be given a triangle that ends up not
+   drawing anything, but never the other way around. */
+static uint32_t
+voodoo_triangle_threads(voodoo_t *voodoo, voodoo_params_t *params)
 {
-    render_thread(param, 3);
+    uint32_t all = (1 << voodoo->render_threads) - 1;
+    uint32_t mask = 0;
+    int      ystart;
+    int      yend;
+    int      y_origin;
+
+    if (voodoo->render_threads == 1)
+        return 1;
+
+    ystart = ((int16_t) params->vertexAy + 7) >> 4;
+    yend   = ((int16_t) params->vertexCy + 7) >> 4;
+
+    if (params->fbzMode & 1) {
+        if (ystart < params->clipLowY)
+            ystart = params->clipLowY;
+        if (yend > params->clipHighY)
+            yend = params->clipHighY;
+    }
+
+    /* Nothing to draw, let the first thread drop it. */
+    if (yend <= ystart)
+        return 1;
+
+    /* Tall triangles cover every thread anyway. */
+    if ((yend - ystart) >= (voodoo->render_threads << (SLI_ENABLED ? 1 : 0)))
+        return all;
+
+    y_origin = (voodoo->type >= VOODOO_BANSHEE) ? voodoo->y_origin_swap : (voodoo->v_disp - 1);
+
+    for (int y = ystart; y < yend; y++)
+        mask |= 1 << voodoo_render_thread_for_line(voodoo, (params->fbzMode & (1 << 17)) ? (y_origin - y) : y);
+
+    return mask;
 }
 
 void
 voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
 {
-    voodoo_params_t *params_new = &voodoo->params_buffer[PARAMS_WRITE_IDX(voodoo) & PARAM_MASK];
-
-    while (PARAM_FULL(0) || (voodoo->render_threads >= 2 && PARAM_FULL(1)) || (voodoo->render_threads == 4 && (PARAM_FULL(2) || PARAM_FULL(3)))) {
-        thread_reset_event(voodoo->render_not_full_event[0]);
-        if (voodoo->render_threads >= 2)
-            thread_reset_event(voodoo->render_not_full_event[1]);
-        if (voodoo->render_threads == 4) {
-            thread_reset_event(voodoo->render_not_full_event[2]);
-            thread_reset_event(voodoo->render_not_full_event[3]);
+    int              idx        = PARAMS_WRITE_IDX(voodoo) & PARAM_MASK;
+    voodoo_params_t *params_new = &voodoo->params_buffer[idx];
+    uint32_t         threads;
+
+    /* Every thread has to have moved past the slot before it can be reused;
+       a thread that owns none of the queued triangles only has to skip them,
+       so make sure it is awake. */
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        while (PARAM_FULL(c)) {
+            thread_reset_event(voodoo->render_not_full_event[c]);
+            thread_set_event(voodoo->wake_render_thread[c]);
+            if (PARAM_FULL(c))
+                thread_wait_event(voodoo->render_not_full_event[c], -1); /*Wait for room in ringbuffer*/
         }
-        if (PARAM_FULL(0))
-            thread_wait_event(voodoo->render_not_full_event[0], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads >= 2 && PARAM_FULL(1))
-            thread_wait_event(voodoo->render_not_full_event[1], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads == 4 && PARAM_FULL(2))
-            thread_wait_event(voodoo->render_not_full_event[2], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads == 4 && PARAM_FULL(3))
-            thread_wait_event(voodoo->render_not_full_event[3], -1); /*Wait for room in ringbuffer*/
     }
 
     voodoo_use_texture(voodoo, params, 0);
@@ -1691,9 +1768,18 @@ voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
         voodoo_use_texture(voodoo, params, 1);
 
     memcpy(params_new, params, sizeof(voodoo_params_t));
+    threads                     = voodoo_triangle_threads(voodoo, params);
+    voodoo->params_threads[idx] = threads;
 
     PARAMS_WRITE_IDX(voodoo)++;
-
-    if (PARAM_ENTRIES(0) < 4 || (voodoo->render_threads >= 2 && PARAM_ENTRIES(1) < 4) || (voodoo->render_threads == 4 && (PARAM_ENTRIES(2) < 4 || PARAM_ENTRIES(3) < 4)))
-        voodoo_wake_render_thread(voodoo);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    /* Only wake up the threads that have something to draw, plus any thread
+       that has fallen far enough behind to hold up the ring. */
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        if (RENDER_VOODOO_BUSY(voodoo, c))
+            continue;
+        if ((threads & (1 << c)) || (PARAM_ENTRIES(c) >= (PARAM_SIZE / 2)))
+            thread_set_event(voodoo->wake_render_thread[c]); /*Wake up render thread if moving from idle*/
+    }
 }
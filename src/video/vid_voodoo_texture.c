@@ -56,6 +56,150 @@ voodoo_texture_log(const char *fmt, ...)
 #    define voodoo_texture_log(fmt, ...)
 #endif
 
+/* True once every render thread is done with all queued uses of a texture. */
+static int
+voodoo_texture_unused(voodoo_t *voodoo, texture_t *tex)
+{
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        if (tex->refcount != tex->refcount_r[c])
+            return 0;
+    }
+
+    return 1;
+}
+
+static int
+voodoo_texture_hash(uint32_t base, uint32_t tLOD, uint32_t palette_checksum)
+{
+    uint32_t hash = (base >> 3) ^ (tLOD * 0x9e3779b1) ^ (palette_checksum * 0x85ebca6b);
+
+    return (hash ^ (hash >> 16)) & (TEX_HASH_SIZE - 1);
+}
+
+static void
+voodoo_texture_hash_remove(voodoo_t *voodoo, int tmu, int c)
+{
+    texture_t *tex = &voodoo->texture_cache[tmu][c];
+    int       *p   = &voodoo->texture_hash[tmu][voodoo_texture_hash(tex->base, tex->tLOD, tex->palette_checksum)];
+
+    while (*p != -1) {
+        if (*p == c) {
+            *p = tex->hash_next;
+            break;
+        }
+        p = &voodoo->texture_cache[tmu][*p].hash_next;
+    }
+    tex->hash_next = -1;
+}
+
+/* Add a texture to, or remove it from, the index of the texture memory it
+   was decoded from. If region is not -1, only that 64 kB block is updated. */
+static void
+voodoo_texture_update_index(voodoo_t *voodoo, int tmu, int c, int add, int region)
+{
+    const texture_t *tex = &voodoo->texture_cache[tmu][c];
+    uint64_t         bit = 1ULL << (c & 63);
+
+    for (uint8_t d = 0; d < 4; d++) {
+        uint32_t addr     = tex->addr_start[d] & ~((1 << TEX_DIRTY_SHIFT) - 1);
+        uint32_t addr_end = tex->addr_end[d];
+
+        if (addr_end == 0)
+            continue;
+
+        for (; addr <= addr_end; addr += (1 << TEX_DIRTY_SHIFT)) {
+            uint32_t page = (addr & voodoo->texture_mask) >> TEX_DIRTY_SHIFT;
+            int      r    = page >> (TEX_INDEX_SHIFT - TEX_DIRTY_SHIFT);
+
+            if ((region != -1) && (r != region))
+                continue;
+
+            if (add) {
+                voodoo->texture_present[tmu][page] = 1;
+                voodoo->texture_index[tmu][r][c >> 6] |= bit;
+            } else
+                voodoo->texture_index[tmu][r][c >> 6] &= ~bit;
+        }
+    }
+}
+
+static void
+voodoo_texture_invalidate(voodoo_t *voodoo, int tmu, int c)
+{
+    texture_t *tex = &voodoo->texture_cache[tmu][c];
+
+    voodoo_texture_hash_remove(voodoo, tmu, c);
+    voodoo_texture_update_index(voodoo, tmu, c, 0, -1);
+    tex->base      = -1;
+    tex->last_used = 0;
+}
+
+/* Returns -1 if the decoded texture buffer could not be allocated. */
+static int
+voodoo_texture_new_entry(voodoo_t *voodoo, int tmu)
+{
+    int       c    = voodoo->texture_cache_count[tmu];
+    uint32_t *data = calloc(1, (256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2) * 4);
+
+    if (data == NULL) {
+        if (c == 0)
+            fatal("Voodoo: Out of memory allocating the texture cache\n");
+        return -1;
+    }
+
+    voodoo->texture_cache[tmu][c].data = data;
+    voodoo->texture_cache_count[tmu]++;
+
+    return c;
+}
+
+/* Find an entry to decode a new texture into. The pool grows up to the
+   configured size, after which the least recently used texture that no
+   render thread still has queued is recycled. Should every texture still
+   be queued, up to TEX_CACHE_SPARE more entries are allocated, and only
+   then does it wait for the render threads as before. */
+static int
+voodoo_texture_alloc(voodoo_t *voodoo, int tmu)
+{
+    int      victim;
+    uint64_t oldest;
+
+    if (voodoo->texture_cache_count[tmu] < voodoo->texture_cache_size) {
+        victim = voodoo_texture_new_entry(voodoo, tmu);
+        if (victim != -1)
+            return victim;
+    }
+
+    while (1) {
+        victim = -1;
+        oldest = UINT64_MAX;
+
+        for (int c = 0; c < voodoo->texture_cache_count[tmu]; c++) {
+            texture_t *tex = &voodoo->texture_cache[tmu][c];
+
+            if ((tex->last_used < oldest) && voodoo_texture_unused(voodoo, tex)) {
+                victim = c;
+                oldest = tex->last_used;
+            }
+        }
+
+        if (victim != -1)
+            break;
+        if (voodoo->texture_cache_count[tmu] < (voodoo->texture_cache_size + TEX_CACHE_SPARE)) {
+            victim = voodoo_texture_new_entry(voodoo, tmu);
+            if (victim != -1)
+                return victim;
+        }
+
+        voodoo_wait_for_render_thread_idle(voodoo);
+    }
+
+    if (voodoo->texture_cache[tmu][victim].base != -1)
+        voodoo_texture_invalidate(voodoo, tmu, victim);
+
+    return victim;
+}
+
 void
 voodoo_recalc_tex12(voodoo_t *voodoo, int tmu)
 {
@@ -243,8 +387,8 @@ voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
     int      c;
     int      lod_min;
     int      lod_max;
+    int      hash;
     uint32_t addr = 0;
-    uint32_t addr_end;
     uint32_t palette_checksum;
 
     lod_min = (params->tLOD[tmu] >> 2) & 15;
@@ -270,35 +414,24 @@ voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
         addr = params->texBaseAddr[tmu];
 
     /*Try to find texture in cache*/
-    for (c = 0; c < TEX_CACHE_MAX; c++) {
+    hash = voodoo_texture_hash(addr, params->tLOD[tmu] & 0xf00fff, palette_checksum);
+    for (c = voodoo->texture_hash[tmu][hash]; c != -1; c = voodoo->texture_cache[tmu][c].hash_next) {
         if (voodoo->texture_cache[tmu][c].base == addr && voodoo->texture_cache[tmu][c].tLOD == (params->tLOD[tmu] & 0xf00fff) && voodoo->texture_cache[tmu][c].palette_checksum == palette_checksum) {
             params->tex_entry[tmu] = c;
+            voodoo->texture_cache[tmu][c].last_used = ++voodoo->texture_generation;
             voodoo->texture_cache[tmu][c].refcount++;
             return;
         }
     }
 
-    /*Texture not found, search for unused texture*/
-    do {
-        for (c = 0; c < TEX_CACHE_MAX; c++) {
-            voodoo->texture_last_removed++;
-            voodoo->texture_last_removed &= (TEX_CACHE_MAX - 1);
-            if (voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[0] && (voodoo->render_threads == 1 || voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[1]))
-                break;
-        }
-        if (c == TEX_CACHE_MAX)
-            voodoo_wait_for_render_thread_idle(voodoo);
-    } while (c == TEX_CACHE_MAX);
-    if (c == TEX_CACHE_MAX)
-        fatal("Texture cache full!\n");
+    /*Texture not found, recycle the oldest unused texture*/
+    c = voodoo_texture_alloc(voodoo, tmu);
 
-    c = voodoo->texture_last_removed;
-
-    if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
-        voodoo->texture_cache[tmu][c].base = params->texBaseAddr1[tmu];
-    else
-        voodoo->texture_cache[tmu][c].base = params->texBaseAddr[tmu];
-    voodoo->texture_cache[tmu][c].tLOD = params->tLOD[tmu] & 0xf00fff;
+    voodoo->texture_cache[tmu][c].base             = addr;
+    voodoo->texture_cache[tmu][c].tLOD             = params->tLOD[tmu] & 0xf00fff;
+    voodoo->texture_cache[tmu][c].palette_checksum = palette_checksum;
+    voodoo->texture_cache[tmu][c].hash_next        = voodoo->texture_hash[tmu][hash];
+    voodoo->texture_hash[tmu][hash]                = c;
 
     lod_min = (params->tLOD[tmu] >> 2) & 15;
     lod_max = (params->tLOD[tmu] >> 8) & 15;
@@ -505,11 +638,6 @@ voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
 
     voodoo->texture_cache[tmu][c].is16 = voodoo->params.tformat[tmu] & 8;
 
-    if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88)
-        voodoo->texture_cache[tmu][c].palette_checksum = palette_checksum;
-    else
-        voodoo->texture_cache[tmu][c].palette_checksum = 0;
-
     if (lod_min == 0) {
         voodoo->texture_cache[tmu][c].addr_start[0] = voodoo->params.tex_base[tmu][0];
         voodoo->texture_cache[tmu][c].addr_end[0]   = voodoo->params.tex_end[tmu][0];
@@ -534,34 +662,38 @@ voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
     } else
         voodoo->texture_cache[tmu][c].addr_start[3] = voodoo->texture_cache[tmu][c].addr_end[3] = 0;
 
-    for (uint8_t d = 0; d < 4; d++) {
-        addr     = voodoo->texture_cache[tmu][c].addr_start[d];
-        addr_end = voodoo->texture_cache[tmu][c].addr_end[d];
-
-        if (addr_end != 0) {
-            for (; addr <= addr_end; addr += (1 << TEX_DIRTY_SHIFT))
-                voodoo->texture_present[tmu][(addr & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
-        }
-    }
+    voodoo_texture_update_index(voodoo, tmu, c, 1, -1);
 
     params->tex_entry[tmu] = c;
+    voodoo->texture_cache[tmu][c].last_used = ++voodoo->texture_generation;
     voodoo->texture_cache[tmu][c].refcount++;
 }
 
+/* Drop the cached textures decoded from the texture memory at dirty_addr.
+   Only the textures indexed under its 64 kB block have to be checked. The
+   decoded data of textures still queued for rendering stays valid, so there
+   is no need to wait for the render threads. */
 void
 flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
 {
-    int wait_for_idle = 0;
+    int       region = dirty_addr >> TEX_INDEX_SHIFT;
+    uint64_t *index  = voodoo->texture_index[tmu][region];
+    int       words  = (voodoo->texture_cache_count[tmu] + 63) >> 6;
 
-    memset(voodoo->texture_present[tmu], 0, sizeof(voodoo->texture_present[0]));
 #if 0
-    voodoo_texture_log("Evict %08x %i\n", dirty_addr, sizeof(voodoo->texture_present));
+    voodoo_texture_log("Evict %08x\n", dirty_addr);
 #endif
-    for (uint8_t c = 0; c < TEX_CACHE_MAX; c++) {
-        if (voodoo->texture_cache[tmu][c].base != -1) {
+    for (int w = 0; w < words; w++) {
+        for (int b = 0; index[w] && (b < 64); b++) {
+            int        c   = (w << 6) + b;
+            texture_t *tex = &voodoo->texture_cache[tmu][c];
+
+            if (!(index[w] & (1ULL << b)))
+                continue;
+
             for (uint8_t d = 0; d < 4; d++) {
-                int addr_start = voodoo->texture_cache[tmu][c].addr_start[d];
-                int addr_end   = voodoo->texture_cache[tmu][c].addr_end[d];
+                int addr_start = tex->addr_start[d];
+                int addr_end   = tex->addr_end[d];
 
                 if (addr_end != 0) {
                     int addr_start_masked = addr_start & voodoo->texture_mask & ~0x3ff;
@@ -571,23 +703,61 @@ flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
                         addr_end_masked = voodoo->texture_mask + 1;
                     if (dirty_addr >= addr_start_masked && dirty_addr < addr_end_masked) {
 #if 0
-                        voodoo_texture_log("  Evict texture %i %08x\n", c, voodoo->texture_cache[tmu][c].base);
+                        voodoo_texture_log("  Evict texture %i %08x\n", c, tex->base);
 #endif
-
-                        if (voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[0] || (voodoo->render_threads == 2 && voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[1]))
-                            wait_for_idle = 1;
-
-                        voodoo->texture_cache[tmu][c].base = -1;
-                    } else {
-                        for (; addr_start <= addr_end; addr_start += (1 << TEX_DIRTY_SHIFT))
-                            voodoo->texture_present[tmu][(addr_start & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
+                        voodoo_texture_invalidate(voodoo, tmu, c);
+                        break;
                     }
                 }
             }
         }
     }
-    if (wait_for_idle)
-        voodoo_wait_for_render_thread_idle(voodoo);
+
+    /* Rebuild the present map of this block from the textures left in it. */
+    memset(&voodoo->texture_present[tmu][region << (TEX_INDEX_SHIFT - TEX_DIRTY_SHIFT)], 0, 1 << (TEX_INDEX_SHIFT - TEX_DIRTY_SHIFT));
+    for (int w = 0; w < words; w++) {
+        for (int b = 0; index[w] && (b < 64); b++) {
+            if (index[w] & (1ULL << b))
+                voodoo_texture_update_index(voodoo, tmu, (w << 6) + b, 1, region);
+        }
+    }
+}
+
+void
+voodoo_texture_cache_init(voodoo_t *voodoo)
+{
+    for (uint8_t tmu = 0; tmu < 2; tmu++) {
+        for (int c = 0; c < TEX_CACHE_MAX; c++) {
+            voodoo->texture_cache[tmu][c].data      = NULL;
+            voodoo->texture_cache[tmu][c].base      = -1; /*invalid*/
+            voodoo->texture_cache[tmu][c].refcount  = 0;
+            voodoo->texture_cache[tmu][c].last_used = 0;
+            voodoo->texture_cache[tmu][c].hash_next = -1;
+        }
+        for (int c = 0; c < TEX_HASH_SIZE; c++)
+            voodoo->texture_hash[tmu][c] = -1;
+        voodoo->texture_cache_count[tmu] = 0;
+    }
+    memset(voodoo->texture_index, 0, sizeof(voodoo->texture_index));
+    memset(voodoo->texture_present, 0, sizeof(voodoo->texture_present));
+    voodoo->texture_generation = 0;
+
+    if (voodoo->texture_cache_size <= 0)
+        voodoo->texture_cache_size = TEX_CACHE_DEFAULT;
+    else if (voodoo->texture_cache_size > (TEX_CACHE_MAX - TEX_CACHE_SPARE))
+        voodoo->texture_cache_size = TEX_CACHE_MAX - TEX_CACHE_SPARE;
+}
+
+void
+voodoo_texture_cache_close(voodoo_t *voodoo)
+{
+    for (uint8_t tmu = 0; tmu < 2; tmu++) {
+        for (int c = 0; c < voodoo->texture_cache_count[tmu]; c++) {
+            free(voodoo->texture_cache[tmu][c].data);
+            voodoo->texture_cache[tmu][c].data = NULL;
+        }
+        voodoo->texture_cache_count[tmu] = 0;
+    }
 }
 
 void
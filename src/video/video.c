@@ -201,12 +201,25 @@ const uint32_t shade[5][256] = {
     }
 };
 
+/* The emulation draws the next frame to one buffer while the frontend is
+   handed the other one. */
+#define VIDEO_BUFFERS 2
+
 typedef struct blit_data_struct {
     int x, y, w, h;
     int busy;
-    int buffer_in_use;
     int thread_run;
     int monitor_index;
+    int      full;                     /* The whole area has changed. */
+    uint32_t dirty[VIDEO_DIRTY_WORDS]; /* Lines changed since the last blit. */
+
+    bitmap_t    *buffers[VIDEO_BUFFERS];
+    volatile int buffer_in_use[VIDEO_BUFFERS]; /* Held by the frontend. */
+    uint32_t     stale[VIDEO_BUFFERS][VIDEO_DIRTY_WORDS]; /* Lines older than the last blit. */
+    int          target;                                  /* Buffer being drawn to. */
+    int          latest;                                  /* Last buffer blitted, always complete. */
+    int          blit;                                    /* Buffer handed to the frontend. */
+    int          sync_w;                                  /* Pixels per line to bring up to date. */
 
     thread_t *blit_thread;
     event_t  *wake_blit_thread;
@@ -245,12 +258,50 @@ video_setblit(void (*blit)(int, int, int, int, int))
 void
 video_blit_complete_monitor(int monitor_index)
 {
-    blit_data_t *blit_data_ptr   = monitors[monitor_index].mon_blit_data_ptr;
-    blit_data_ptr->buffer_in_use = 0;
+    blit_data_t *blit_data_ptr                         = monitors[monitor_index].mon_blit_data_ptr;
+    blit_data_ptr->buffer_in_use[blit_data_ptr->blit] = 0;
 
     thread_set_event(blit_data_ptr->buffer_not_in_use);
 }
 
+/* Copy a line of the last blitted frame to the target buffer. */
+static void
+video_sync_line(blit_data_t *blit_data_ptr, int line)
+{
+    blit_data_ptr->stale[blit_data_ptr->target][line >> 5] &= ~(1U << (line & 31));
+
+    memcpy(blit_data_ptr->buffers[blit_data_ptr->target]->line[line],
+           blit_data_ptr->buffers[blit_data_ptr->latest]->line[line], blit_data_ptr->sync_w * sizeof(uint32_t));
+}
+
+static void
+video_sync_all(blit_data_t *blit_data_ptr)
+{
+    const uint32_t *stale = blit_data_ptr->stale[blit_data_ptr->target];
+
+    for (int i = 0; i < VIDEO_DIRTY_WORDS; i++) {
+        if (!stale[i])
+            continue;
+
+        for (int j = 0; j < 32; j++) {
+            if (stale[i] & (1U << j))
+                video_sync_line(blit_data_ptr, (i << 5) | j);
+        }
+    }
+}
+
+/* Renderers that start their frames with video_wait_for_buffer_dirty_monitor()
+   have to call this before writing to a line of the target buffer. */
+void
+video_sync_line_monitor(int line, int monitor_index)
+{
+    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+
+    line &= 2047;
+    if (blit_data_ptr->stale[blit_data_ptr->target][line >> 5] & (1U << (line & 31)))
+        video_sync_line(blit_data_ptr, line);
+}
+
 void
 video_wait_for_blit_monitor(int monitor_index)
 {
@@ -261,12 +312,28 @@ video_wait_for_blit_monitor(int monitor_index)
     thread_reset_event(blit_data_ptr->blit_complete);
 }
 
+/* Wait until the target buffer can be drawn to, called at the start of every
+   frame. The lines that changed in the last frame blitted from the other
+   buffer are brought up to date first. */
 void
 video_wait_for_buffer_monitor(int monitor_index)
 {
     blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
 
-    while (blit_data_ptr->buffer_in_use)
+    video_wait_for_buffer_dirty_monitor(monitor_index);
+    video_sync_all(blit_data_ptr);
+}
+
+/* Same as above, for renderers that mark every line they draw in mon_dirty
+   and call video_sync_line_monitor() before drawing it. The lines they do
+   not draw are only brought up to date when the frame is blitted, so that
+   lines that are drawn anyway are not copied first. */
+void
+video_wait_for_buffer_dirty_monitor(int monitor_index)
+{
+    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+
+    while (blit_data_ptr->buffer_in_use[blit_data_ptr->target])
         thread_wait_event(blit_data_ptr->buffer_not_in_use, -1);
     thread_reset_event(blit_data_ptr->buffer_not_in_use);
 }
@@ -419,6 +486,8 @@ blit_thread(void *param)
 
         if (blit_func)
             blit_func(data->x, data->y, data->w, data->h, data->monitor_index);
+        else /* No frontend to hand the buffer to, e.g. when benchmarking. */
+            video_blit_complete_monitor(data->monitor_index);
 
         data->busy = 0;
 
@@ -427,6 +496,67 @@ blit_thread(void *param)
     }
 }
 
+static void
+video_blit_start(int x, int y, int w, int h, int full, int monitor_index)
+{
+    monitor_t   *monitor       = &monitors[monitor_index];
+    blit_data_t *blit_data_ptr = monitor->mon_blit_data_ptr;
+
+    int          next;
+
+    video_wait_for_blit_monitor(monitor_index);
+
+    /* Whatever was not drawn in this frame is still the same as in the last
+       one, complete the frame before handing it over. */
+    video_sync_all(blit_data_ptr);
+
+    next = blit_data_ptr->target;
+
+    blit_data_ptr->busy                = 1;
+    blit_data_ptr->blit                = next;
+    blit_data_ptr->latest              = next;
+    blit_data_ptr->buffer_in_use[next] = 1;
+    blit_data_ptr->x                   = x;
+    blit_data_ptr->y                   = y;
+    blit_data_ptr->w                   = w;
+    blit_data_ptr->h                   = h;
+    blit_data_ptr->full                = full;
+    blit_data_ptr->sync_w              = MIN(x + w, 2048);
+    if (!full)
+        memcpy(blit_data_ptr->dirty, monitor->mon_dirty, sizeof(blit_data_ptr->dirty));
+    monitor->blit_buffer = blit_data_ptr->buffers[next];
+
+    for (int i = 0; i < VIDEO_BUFFERS; i++) {
+        if (i == next)
+            continue;
+        for (int j = 0; j < VIDEO_DIRTY_WORDS; j++)
+            blit_data_ptr->stale[i][j] |= full ? 0xffffffff : monitor->mon_dirty[j];
+    }
+
+    memset(monitor->mon_dirty, 0x00, sizeof(monitor->mon_dirty));
+    monitor->mon_renderedframes++;
+    monitor->mon_blits++;
+
+    thread_set_event(blit_data_ptr->wake_blit_thread);
+
+    /* Only renderers that track the lines they draw can switch buffers, as
+       the new target has to be brought up to date for the others. */
+    if (!full) {
+        next = (next + 1) % VIDEO_BUFFERS;
+
+        if (blit_data_ptr->buffers[next] == NULL) {
+            blit_data_ptr->buffers[next] = create_bitmap(2048, 2048);
+            memset(blit_data_ptr->stale[next], 0xff, sizeof(blit_data_ptr->stale[next]));
+        }
+
+        if (!blit_data_ptr->buffer_in_use[next]) {
+            blit_data_ptr->target  = next;
+            monitor->target_buffer = blit_data_ptr->buffers[next];
+        }
+    }
+}
+
+/* Blit the area, treating all of it as changed. */
 void
 video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index)
 {
@@ -435,20 +565,46 @@ video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index)
     if ((w <= 0) || (h <= 0))
         return;
 
-    video_wait_for_blit_monitor(monitor_index);
-
-    monitors[monitor_index].mon_blit_data_ptr->busy          = 1;
-    monitors[monitor_index].mon_blit_data_ptr->buffer_in_use = 1;
-    monitors[monitor_index].mon_blit_data_ptr->x             = x;
-    monitors[monitor_index].mon_blit_data_ptr->y             = y;
-    monitors[monitor_index].mon_blit_data_ptr->w             = w;
-    monitors[monitor_index].mon_blit_data_ptr->h             = h;
-    monitors[monitor_index].mon_renderedframes++;
+    video_blit_start(x, y, w, h, 1, monitor_index);
 
-    thread_set_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
     MTR_END("video", "video_blit_memtoscreen");
 }
 
+/* Blit the area, telling the frontend that only the lines marked in the
+   monitor's mon_dirty mask have changed since the last blit. Callers have
+   to mark every line they wrote to. */
+void
+video_blit_memtoscreen_dirty_monitor(int x, int y, int w, int h, int monitor_index)
+{
+    MTR_BEGIN("video", "video_blit_memtoscreen_dirty");
+
+    if ((w <= 0) || (h <= 0))
+        return;
+
+    video_blit_start(x, y, w, h, 0, monitor_index);
+
+    MTR_END("video", "video_blit_memtoscreen_dirty");
+}
+
+/* Called by the blit function, merges the lines changed by the current
+   blit into the given mask. Returns 1 if the whole area has changed, in
+   which case all lines are set. */
+int
+video_blit_add_dirty_monitor(uint32_t *dirty, int monitor_index)
+{
+    const blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+
+    if (blit_data_ptr->full) {
+        memset(dirty, 0xff, VIDEO_DIRTY_WORDS * sizeof(uint32_t));
+        return 1;
+    }
+
+    for (int i = 0; i < VIDEO_DIRTY_WORDS; i++)
+        dirty[i] |= blit_data_ptr->dirty[i];
+
+    return 0;
+}
+
 uint8_t
 pixels8(uint32_t *pixels)
 {
@@ -801,8 +957,10 @@ video_monitor_init(int index)
     monitors[index].mon_unscaled_size_y                  = 480;
     monitors[index].mon_bpp                              = 8;
     monitors[index].mon_changeframecount                 = 2;
-    monitors[index].target_buffer                        = create_bitmap(2048, 2048);
     monitors[index].mon_blit_data_ptr                    = calloc(1, sizeof(blit_data_t));
+    monitors[index].mon_blit_data_ptr->buffers[0]        = create_bitmap(2048, 2048);
+    monitors[index].target_buffer                        = monitors[index].mon_blit_data_ptr->buffers[0];
+    monitors[index].blit_buffer                          = monitors[index].target_buffer;
     monitors[index].mon_blit_data_ptr->wake_blit_thread  = thread_create_event();
     monitors[index].mon_blit_data_ptr->blit_complete     = thread_create_event();
     monitors[index].mon_blit_data_ptr->buffer_not_in_use = thread_create_event();
@@ -836,13 +994,15 @@ video_monitor_close(int monitor_index)
     thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->buffer_not_in_use);
     thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->blit_complete);
     thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
+    for (int i = 0; i < VIDEO_BUFFERS; i++)
+        destroy_bitmap(monitors[monitor_index].mon_blit_data_ptr->buffers[i]);
     free(monitors[monitor_index].mon_blit_data_ptr);
     if (!monitors[monitor_index].mon_pal_lookup_static)
         free(monitors[monitor_index].mon_pal_lookup);
     if (!monitors[monitor_index].mon_cga_palette_static)
         free(monitors[monitor_index].mon_cga_palette);
-    destroy_bitmap(monitors[monitor_index].target_buffer);
     monitors[monitor_index].target_buffer = NULL;
+    monitors[monitor_index].blit_buffer   = NULL;
     memset(&monitors[monitor_index], 0, sizeof(monitor_t));
 }
 
@@ -43,6 +43,11 @@ static int              allowedY;
 static int              ptr_x;
 static int              ptr_y;
 static int              ptr_but;
+static uint32_t         vnc_dirty[VIDEO_DIRTY_WORDS];
+static int              vnc_blit_x;
+static int              vnc_blit_y;
+static int              vnc_blit_w;
+static int              vnc_blit_h;
 
 #ifdef ENABLE_VNC_LOG
 int vnc_do_log = ENABLE_VNC_LOG;
@@ -174,21 +179,54 @@ vnc_display(rfbClientPtr cl)
 static void
 vnc_blit(int x, int y, int w, int h, int monitor_index)
 {
-    if (monitor_index || (x < 0) || (y < 0) || (w < VNC_MIN_X) || (h < VNC_MIN_Y) || (w > VNC_MAX_X) || (h > VNC_MAX_Y) || (buffer32 == NULL)) {
+    if (monitor_index || (x < 0) || (y < 0) || (w < VNC_MIN_X) || (h < VNC_MIN_Y) || (w > VNC_MAX_X) || (h > VNC_MAX_Y) || (monitors[monitor_index].blit_buffer == NULL)) {
+        /* Keep the damage of a skipped frame for the next one drawn. */
+        if (!monitor_index)
+            video_blit_add_dirty_monitor(vnc_dirty, monitor_index);
         video_blit_complete_monitor(monitor_index);
         return;
     }
 
-    for (int row = 0; row < h; ++row)
-        video_copy(&(((uint8_t *) rfb->frameBuffer)[row * 2048 * sizeof(uint32_t)]), &(buffer32->line[y + row][x]), w * sizeof(uint32_t));
+    video_blit_add_dirty_monitor(vnc_dirty, monitor_index);
+    if ((x != vnc_blit_x) || (y != vnc_blit_y) || (w != vnc_blit_w) || (h != vnc_blit_h)) {
+        memset(vnc_dirty, 0xff, sizeof(vnc_dirty));
+        vnc_blit_x = x;
+        vnc_blit_y = y;
+        vnc_blit_w = w;
+        vnc_blit_h = h;
+    }
+
+    /* The frame buffer keeps its contents, only copy the changed lines. */
+    for (int row = 0; row < h; ++row) {
+        if (vnc_dirty[((y + row) & 2047) >> 5] & (1U << ((y + row) & 31)))
+            video_copy(&(((uint8_t *) rfb->frameBuffer)[row * 2048 * sizeof(uint32_t)]), &(monitors[monitor_index].blit_buffer->line[y + row][x]), w * sizeof(uint32_t));
+    }
 
     if (screenshots)
         video_screenshot((uint32_t *) rfb->frameBuffer, 0, 0, VNC_MAX_X);
 
     video_blit_complete_monitor(monitor_index);
 
-    if (!updatingSize)
-        rfbMarkRectAsModified(rfb, 0, 0, allowedX, allowedY);
+    /* While a size change is pending, hold on to the damage. */
+    if (updatingSize)
+        return;
+
+    for (int row = 0; (row < h) && (row < allowedY); ) {
+        int start;
+
+        if (!(vnc_dirty[((y + row) & 2047) >> 5] & (1U << ((y + row) & 31)))) {
+            row++;
+            continue;
+        }
+
+        start = row;
+        while ((row < h) && (row < allowedY) && (vnc_dirty[((y + row) & 2047) >> 5] & (1U << ((y + row) & 31))))
+            row++;
+
+        rfbMarkRectAsModified(rfb, 0, start, allowedX, row);
+    }
+
+    memset(vnc_dirty, 0x00, sizeof(vnc_dirty));
 }
 
 /* Initialize VNC for operation. */
@@ -217,6 +255,7 @@ vnc_init(UNUSED(void *arg))
         updatingSize = 0;
         allowedX     = scrnsz_x;
         allowedY     = scrnsz_y;
+        vnc_blit_w   = 0;
 
         rfb              = rfbGetScreen(0, NULL, VNC_MAX_X, VNC_MAX_Y, 8, 3, 4);
         rfb->desktopName = title;